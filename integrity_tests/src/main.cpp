@@ -1,2 +1,35 @@
 #define CATCH_CONFIG_MAIN
-#include <catch2/catch.hpp>
\ No newline at end of file
+#include <catch2/catch.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Count the heap allocations (through operator new) that are made while countAllocations is set. Used to verify
+// that rendering does not allocate in steady state.
+std::atomic<bool> countAllocations { false };
+std::atomic<size_t> numAllocations { 0 };
+
+void* operator new(std::size_t size)
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+        numAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+// GCC does not see that operator new above uses malloc and warns about the (matching) free.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
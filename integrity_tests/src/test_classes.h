@@ -52,7 +52,9 @@ public:
 
     provide_member_function_access(traceRaySlice)
     provide_member_function_access(traceRayMIP)
+    provide_member_function_access(traceRayMIPOctree)
     provide_member_function_access(traceRayISO)
+    provide_member_function_access(findIsoSurfaceOctree)
     provide_member_function_access(traceRayComposite)
     provide_member_function_access(traceRayTF2D)
 
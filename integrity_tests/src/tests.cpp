@@ -1,9 +1,48 @@
 // Can access the header files from the viewer...
 #include "test_classes.h"
+#include "mesh/bvh.h"
+#include "mesh/marching_cubes.h"
+#include "render/classified_volume.h"
+#include "render/occupancy_grid.h"
+#include "render/shading.h"
+#include "render/transfer_function_1d.h"
+#include "render/transfer_function_2d.h"
+#include "ui/histogram_image.h"
 #include "ui/window.h"
+#include "util/trace.h"
+#include "volume/async_volume_loader.h"
+#include "volume/synthetic_volume.h"
+#include "volume/volume_sequence.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <catch2/catch.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tbb/global_control.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Number of heap allocations (through operator new) made while countAllocations is set; see main.cpp.
+extern std::atomic<bool> countAllocations;
+extern std::atomic<size_t> numAllocations;
 
 /*
 GradientVolume:
@@ -46,3 +85,1412 @@ TEST_CASE("Gradient Volume Tests")
     const TestGradientVolume gradient { volume };
     REQUIRE_NOTHROW(gradient.test_getGradientLinearInterpolate(glm::vec3(100.f)));
 }
+
+TEST_CASE("Volume Statistics Tests")
+{
+    std::vector<uint16_t> data(1000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<uint16_t>(10 + i % 100);
+    const volume::Volume volume { data, glm::ivec3(10) };
+    REQUIRE(volume.minimum() == 10.0f);
+    REQUIRE(volume.maximum() == 109.0f);
+    REQUIRE(volume.histogram().size() == 110);
+    REQUIRE(volume.histogram()[10] == 10);
+    REQUIRE(volume.percentile(0.0f) == 10.0f);
+    REQUIRE(volume.percentile(0.5f) == 59.0f);
+    REQUIRE(volume.percentile(1.0f) == 109.0f);
+
+    const volume::GradientVolume gradient { volume };
+    const auto& histogram2D = gradient.histogram2D();
+    int total = 0;
+    for (const int count : histogram2D.bins)
+        total += count;
+    REQUIRE(total == 1000);
+}
+
+TEST_CASE("Histogram Image Tests")
+{
+    // A wide value range must not grow the image: 1000 voxels at 0, 24 at 60000.
+    std::vector<uint16_t> data(1024, 0);
+    std::fill(std::begin(data), std::begin(data) + 24, uint16_t(60000));
+    const volume::Volume volume { data, glm::ivec3(16, 16, 4) };
+    const glm::ivec2 resolution { 100, 50 };
+    const auto image = ui::createHistogramImage(volume.histogram(), volume.maximum(), resolution, 1.0f);
+    REQUIRE(image.size() == 100 * 50);
+
+    const auto barHeight = [&](int x) {
+        int height = 0;
+        for (int y = 0; y < resolution.y; y++)
+            height += image[static_cast<size_t>(x + y * resolution.x)].a > 0;
+        return height;
+    };
+    // Log-scaled: the small peak is still clearly visible, but lower than the large one.
+    REQUIRE(barHeight(0) > barHeight(99));
+    REQUIRE(barHeight(99) > resolution.y / 3);
+    REQUIRE(barHeight(50) == 0);
+
+    const volume::GradientVolume gradient { volume };
+    const auto image2D = ui::createHistogramImage(gradient.histogram2D(), resolution);
+    REQUIRE(image2D.size() == 100 * 50);
+    const auto maxPixel = std::max_element(std::begin(image2D), std::end(image2D), [](const glm::u8vec4& lhs, const glm::u8vec4& rhs) { return lhs.a < rhs.a; });
+    REQUIRE(maxPixel->a == 255);
+}
+
+TEST_CASE("Transfer Function 1D Table Tests")
+{
+    // One entry per 16-bit value.
+    render::RenderConfig config {};
+    config.tfColorMap.resize(65536);
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i] = glm::vec4(1.0f, 0.5f, 0.0f, i % 2 ? 0.5f : 0.0f);
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 65536.0f;
+
+    render::TransferFunction1DTable table;
+    table.update(config, 1.0f);
+    REQUIRE(table.lookup(1000.0f) == glm::vec4(0.0f));
+    REQUIRE(glm::all(glm::lessThan(glm::abs(table.lookup(1001.0f) - glm::vec4(0.5f, 0.25f, 0.0f, 0.5f)), glm::vec4(1e-6f))));
+    REQUIRE(table.lookup(-5.0f) == table.lookup(0.0f));
+    REQUIRE(table.lookup(1e6f) == table.lookup(65535.0f));
+
+    // Two samples of half the distance must be as opaque as one sample.
+    table.update(config, 2.0f);
+    REQUIRE(table.lookup(1001.0f).a == Approx(0.75f));
+    const glm::vec4 half = table.correctOpacity(table.lookup(1001.0f), 1.0f);
+    REQUIRE(half.a == Approx(0.5f));
+    REQUIRE(half.r == Approx(0.5f));
+}
+
+TEST_CASE("Transfer Function 2D Table Tests")
+{
+    render::RenderConfig config {};
+    config.TF2DIntensity = 100.0f;
+    config.TF2DRadius = 30.0f;
+    config.TF2DColor = glm::vec4(1.0f, 0.5f, 0.0f, 1.0f);
+    config.TF2DPrimitives.push_back(render::TF2DPrimitive { render::TF2DShape::Box, glm::vec2(200.0f, 0.5f), glm::vec2(10.0f, 0.5f), glm::vec4(0.0f, 0.0f, 1.0f, 0.5f) });
+
+    render::TransferFunction2DTable table;
+    table.rasterize(config, glm::vec2(0.0f, 255.0f), glm::vec2(0.0f, 10.0f));
+    const auto approx = [](const glm::vec4& lhs, const glm::vec4& rhs) { return glm::all(glm::lessThan(glm::abs(lhs - rhs), glm::vec4(1e-4f))); };
+    // Triangle: tent that widens with the gradient magnitude.
+    REQUIRE(approx(table.lookup(100.0f, 10.0f), config.TF2DColor));
+    REQUIRE(approx(table.lookup(115.0f, 10.0f), 0.5f * config.TF2DColor));
+    REQUIRE(approx(table.lookup(100.0f, 0.0f), glm::vec4(0.0f)));
+    // Box and empty space.
+    REQUIRE(approx(table.lookup(200.0f, 5.0f), glm::vec4(0.0f, 0.0f, 1.0f, 0.5f)));
+    REQUIRE(approx(table.lookup(50.0f, 5.0f), glm::vec4(0.0f)));
+
+    REQUIRE(table.isVisible(glm::vec2(60.0f, 80.0f), glm::vec2(0.0f, 10.0f)));
+    REQUIRE(table.isVisible(glm::vec2(190.0f, 195.0f), glm::vec2(4.0f, 6.0f)));
+    REQUIRE_FALSE(table.isVisible(glm::vec2(0.0f, 40.0f), glm::vec2(0.0f, 10.0f)));
+    REQUIRE_FALSE(table.isVisible(glm::vec2(60.0f, 65.0f), glm::vec2(0.0f, 10.0f)));
+}
+
+// Write a volume to an FLD file with the given data type ("byte", "short" or "float"); voxels are little endian.
+template <typename T>
+static void writeFLD(const std::filesystem::path& file, const glm::ivec3& dim, const std::vector<T>& data, const std::string& dataType)
+{
+    std::ofstream stream { file, std::ios::binary };
+    stream << "# AVS field file\nndim=3\ndim1=" << dim.x << "\ndim2=" << dim.y << "\ndim3=" << dim.z
+           << "\nnspace=3\nveclen=1\ndata=" << dataType << "\nfield=uniform\n\f\f";
+    stream.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size() * sizeof(T)));
+}
+
+TEST_CASE("Async Volume Loader Tests")
+{
+    using Stage = volume::AsyncVolumeLoader::Stage;
+    {
+        volume::AsyncVolumeLoader loader { "this_file_does_not_exist.fld" };
+        while (loader.stage() == Stage::Reading)
+            std::this_thread::yield();
+        REQUIRE(loader.stage() == Stage::Failed);
+        REQUIRE(loader.volume() == nullptr);
+        REQUIRE(loader.gradientVolume() == nullptr);
+    }
+
+    volume::SyntheticVolumeSettings settings {};
+    settings.field = volume::SyntheticField::Noise;
+    settings.dim = glm::ivec3(23, 17, 12);
+    const volume::Volume synthetic = volume::SyntheticVolume(settings).generate();
+    const auto syntheticVoxels = synthetic.voxels<uint16_t>();
+    const std::filesystem::path file = std::filesystem::temp_directory_path() / "async_volume_loader.fld";
+    writeFLD(file, settings.dim, std::vector<uint16_t>(std::begin(syntheticVoxels), std::end(syntheticVoxels)), "short");
+
+    // The stages only move forward and the volume and gradients only become available in their stages.
+    volume::AsyncVolumeLoader loader { file };
+    Stage previousStage = Stage::Reading;
+    while (true) {
+        const Stage stage = loader.stage();
+        const float progress = loader.progress();
+        REQUIRE(stage != Stage::Failed);
+        REQUIRE(int(stage) >= int(previousStage));
+        REQUIRE((progress >= 0.0f && progress <= 1.0f));
+        if (int(stage) < int(Stage::Gradients))
+            REQUIRE(loader.volume() == nullptr);
+        if (stage != Stage::Done)
+            REQUIRE(loader.gradientVolume() == nullptr);
+        previousStage = stage;
+        if (stage == Stage::Done)
+            break;
+        std::this_thread::yield();
+    }
+    REQUIRE(loader.progress() == 1.0f);
+
+    // Same result as loading synchronously.
+    const volume::Volume reference { file };
+    const volume::GradientVolume referenceGradients { reference };
+    const volume::Volume* pVolume = loader.volume();
+    const volume::GradientVolume* pGradientVolume = loader.gradientVolume();
+    REQUIRE(pVolume != nullptr);
+    REQUIRE(pGradientVolume != nullptr);
+    REQUIRE(pVolume->dims() == reference.dims());
+    REQUIRE(pVolume->voxelType() == volume::VoxelType::UInt16);
+    const auto voxels = pVolume->voxels<uint16_t>(), referenceVoxels = reference.voxels<uint16_t>();
+    REQUIRE(std::equal(std::begin(voxels), std::end(voxels), std::begin(referenceVoxels), std::end(referenceVoxels)));
+    REQUIRE(std::equal(std::begin(voxels), std::end(voxels), std::begin(syntheticVoxels), std::end(syntheticVoxels)));
+    REQUIRE(pVolume->minimum() == reference.minimum());
+    REQUIRE(pVolume->maximum() == reference.maximum());
+    REQUIRE(pVolume->histogram() == reference.histogram());
+    REQUIRE(pGradientVolume->minMagnitude() == referenceGradients.minMagnitude());
+    REQUIRE(pGradientVolume->maxMagnitude() == referenceGradients.maxMagnitude());
+    for (int z = 0; z < settings.dim.z; z++) {
+        for (int y = 0; y < settings.dim.y; y++) {
+            for (int x = 0; x < settings.dim.x; x++) {
+                const volume::GradientVoxel gradient = pGradientVolume->getGradient(x, y, z);
+                const volume::GradientVoxel referenceGradient = referenceGradients.getGradient(x, y, z);
+                REQUIRE(gradient.dir == referenceGradient.dir);
+                REQUIRE(gradient.magnitude == referenceGradient.magnitude);
+            }
+        }
+    }
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("Trace Tests")
+{
+    const std::filesystem::path file = std::filesystem::temp_directory_path() / "volvis_trace.json";
+    const auto readTrace = [&]() {
+        REQUIRE(util::writeChromeTrace(file));
+        std::ifstream stream { file };
+        return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    };
+    const bool wasEnabled = util::isTracingEnabled();
+    util::setTracingEnabled(true);
+
+    // Writing and clearing while other threads record (and wrap around their buffers).
+    std::atomic<bool> stop { false };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2; i++)
+        threads.emplace_back([&]() {
+            while (!stop.load(std::memory_order_relaxed)) {
+                TRACE_SCOPE("Trace Tests::before");
+            }
+        });
+    for (int i = 0; i < 10; i++) {
+        REQUIRE(readTrace().rfind("\n]}\n") != std::string::npos);
+        util::clearTrace();
+    }
+    stop = true;
+    for (std::thread& thread : threads)
+        thread.join();
+
+    util::clearTrace();
+    {
+        TRACE_SCOPE("Trace Tests::after");
+    }
+    const std::string trace = readTrace();
+    REQUIRE(trace.find("Trace Tests::after") != std::string::npos);
+    REQUIRE(trace.find("Trace Tests::before") == std::string::npos);
+    util::setTracingEnabled(wasEnabled);
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("Voxel Layout Tests")
+{
+    const glm::ivec3 dim { 7, 12, 5 };
+    std::vector<uint16_t> data(static_cast<size_t>(dim.x * dim.y * dim.z));
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<uint16_t>((i * 37) % 251);
+
+    volume::Volume linear { data, dim, volume::VoxelLayout::Linear };
+    volume::Volume morton { data, dim, volume::VoxelLayout::Morton };
+    REQUIRE(morton.layout() == volume::VoxelLayout::Morton);
+    REQUIRE(morton.storageSize() >= data.size());
+    bool sameVoxels = true;
+    for (int z = 0; z < dim.z; z++) {
+        for (int y = 0; y < dim.y; y++) {
+            for (int x = 0; x < dim.x; x++)
+                sameVoxels = sameVoxels && linear.getVoxel(x, y, z) == morton.getVoxel(x, y, z);
+        }
+    }
+    REQUIRE(sameVoxels);
+    REQUIRE(linear.histogram() == morton.histogram());
+
+    // Stepping to a neighbour matches indexing it directly.
+    bool sameNeighbours = true;
+    for (const auto* pVolume : { &linear, &morton }) {
+        const volume::VoxelIndexer& indexer = pVolume->indexer();
+        for (int z = 0; z < dim.z; z++) {
+            for (int y = 0; y < dim.y; y++) {
+                for (int x = 0; x < dim.x; x++) {
+                    const glm::ivec3 voxel { x, y, z };
+                    for (int axis = 0; axis < 3; axis++) {
+                        for (const int direction : { -1, 1 }) {
+                            glm::ivec3 neighbour = voxel;
+                            neighbour[axis] += direction;
+                            if (neighbour[axis] >= 0 && neighbour[axis] < dim[axis])
+                                sameNeighbours = sameNeighbours && indexer.step(indexer(x, y, z), axis, direction) == indexer(neighbour.x, neighbour.y, neighbour.z);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    REQUIRE(sameNeighbours);
+
+    linear.interpolationMode = morton.interpolationMode = volume::InterpolationMode::Linear;
+    REQUIRE(linear.getSampleInterpolate(glm::vec3(3.3f, 5.7f, 2.1f)) == morton.getSampleInterpolate(glm::vec3(3.3f, 5.7f, 2.1f)));
+
+    const volume::GradientVolume linearGradient { linear };
+    const volume::GradientVolume mortonGradient { morton };
+    REQUIRE(linearGradient.getGradient(3, 4, 2).magnitude == mortonGradient.getGradient(3, 4, 2).magnitude);
+    REQUIRE(linearGradient.histogram2D().bins == mortonGradient.histogram2D().bins);
+}
+
+TEST_CASE("NUMA Placement Tests")
+{
+    const glm::ivec3 dim { 9, 14, 6 };
+    std::vector<uint16_t> data(static_cast<size_t>(dim.x * dim.y * dim.z));
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<uint16_t>((i * 53) % 199);
+
+    // Placement only decides which threads first write the pages; the contents do not depend on it.
+    for (const auto placement : { util::NumaPlacement::Default, util::NumaPlacement::Interleaved, util::NumaPlacement::Partitioned }) {
+        for (const auto layout : { volume::VoxelLayout::Linear, volume::VoxelLayout::Morton }) {
+            const volume::Volume volume { data, dim, layout, placement };
+            REQUIRE(volume.placement() == placement);
+            REQUIRE(volume.getVoxel(5, 11, 3) == float(data[static_cast<size_t>(5 + dim.x * (11 + dim.y * 3))]));
+            const volume::GradientVolume gradient { volume };
+            REQUIRE(gradient.getGradient(0, 0, 0).magnitude == 0.0f);
+            REQUIRE(gradient.getGradient(4, 7, 2).magnitude > 0.0f);
+        }
+    }
+
+    // Partitions are contiguous and cover all nodes.
+    const util::NumaTopology& topology = util::NumaTopology::instance();
+    REQUIRE(topology.partitionNode(0, 1000) == 0);
+    REQUIRE(topology.partitionNode(999, 1000) == topology.numNodes() - 1);
+}
+
+// Camera orbiting around the center of a volume, used to render random views in the benchmarks.
+class OrbitCamera : public render::RayTraceCamera {
+public:
+    OrbitCamera(const glm::vec3& lookAt, float distance, float yaw, float pitch)
+        : m_lookAt(lookAt)
+        , m_position(lookAt + distance * glm::vec3(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw)))
+        , m_forward(glm::normalize(lookAt - m_position))
+        , m_right(glm::normalize(glm::cross(m_forward, glm::vec3(0, 1, 0))))
+        , m_up(glm::cross(m_right, m_forward))
+    {
+    }
+
+    glm::vec3 position() const override { return m_position; }
+    glm::vec3 forward() const override { return m_forward; }
+    render::Ray generateRay(const glm::vec2& pixel) const override
+    {
+        // 60 degree field of view.
+        const float tanHalfFov = 0.57735f;
+        return render::Ray { m_position, glm::normalize(m_forward + tanHalfFov * (pixel.x * m_right + pixel.y * m_up)), 0.0f, 0.0f };
+    }
+
+private:
+    glm::vec3 m_lookAt, m_position, m_forward, m_right, m_up;
+};
+
+TEST_CASE("Voxel Type Tests")
+{
+    const glm::ivec3 dim { 11, 9, 13 };
+    std::vector<uint8_t> bytes(static_cast<size_t>(dim.x * dim.y * dim.z));
+    for (size_t i = 0; i < bytes.size(); i++)
+        bytes[i] = static_cast<uint8_t>((i * 97) % 241);
+    const std::vector<uint16_t> shorts(std::begin(bytes), std::end(bytes));
+    const std::vector<float> floats(std::begin(bytes), std::end(bytes));
+    std::vector<volume::Half> halfs(bytes.size());
+    std::transform(std::begin(bytes), std::end(bytes), std::begin(halfs), [](uint8_t value) { return volume::Half { glm::packHalf1x16(float(value)) }; });
+
+    // Files keep their on-disk width.
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    writeFLD(directory / "voxel_type_byte.fld", dim, bytes, "byte");
+    writeFLD(directory / "voxel_type_float.fld", dim, floats, "float");
+    const volume::Volume byteFile { directory / "voxel_type_byte.fld" };
+    const volume::Volume floatFile { directory / "voxel_type_float.fld" };
+    REQUIRE(byteFile.voxelType() == volume::VoxelType::UInt8);
+    REQUIRE(floatFile.voxelType() == volume::VoxelType::Float);
+    REQUIRE(byteFile.voxels<uint8_t>().size() == bytes.size());
+    REQUIRE(std::equal(std::begin(bytes), std::end(bytes), std::begin(byteFile.voxels<uint8_t>())));
+    REQUIRE(std::equal(std::begin(floats), std::end(floats), std::begin(floatFile.voxels<float>())));
+
+    // All voxel types holding the same (exactly representable) values give the same statistics and images.
+    std::vector<volume::Volume> volumes;
+    volumes.emplace_back(bytes, dim, volume::VoxelLayout::Morton);
+    volumes.emplace_back(shorts, dim, volume::VoxelLayout::Morton);
+    volumes.emplace_back(halfs, dim, volume::VoxelLayout::Morton);
+    volumes.emplace_back(floats, dim, volume::VoxelLayout::Morton);
+    const volume::Volume& reference = volumes[1];
+    REQUIRE(reference.voxelType() == volume::VoxelType::UInt16);
+    REQUIRE(volumes[2].voxelType() == volume::VoxelType::Half);
+
+    render::RenderConfig config {};
+    config.renderResolution = glm::ivec2(24);
+    config.isoValue = 150.0f;
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 240.0f;
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i] = glm::vec4(1.0f, 0.5f, 0.2f, float(i) / float(config.tfColorMap.size()) * 0.2f);
+    const OrbitCamera camera { glm::vec3(dim) / 2.0f, 30.0f, 0.7f, 0.4f };
+    const auto renderImage = [&](volume::Volume& volume, render::RenderMode renderMode, volume::InterpolationMode interpolationMode) {
+        volume.interpolationMode = interpolationMode;
+        const volume::GradientVolume gradient { volume };
+        config.renderMode = renderMode;
+        render::Renderer renderer { &volume, &gradient, &camera, config };
+        renderer.render();
+        return renderer.frameBuffer();
+    };
+
+    for (volume::Volume& volume : volumes) {
+        REQUIRE(volume.minimum() == reference.minimum());
+        REQUIRE(volume.maximum() == reference.maximum());
+        REQUIRE(volume.histogram() == reference.histogram());
+        REQUIRE(volume.getVoxel(3, 7, 5) == reference.getVoxel(3, 7, 5));
+        for (const auto renderMode : { render::RenderMode::RenderMIP, render::RenderMode::RenderIso, render::RenderMode::RenderComposite }) {
+            for (const auto interpolationMode : { volume::InterpolationMode::NearestNeighbour, volume::InterpolationMode::Linear })
+                REQUIRE(renderImage(volume, renderMode, interpolationMode) == renderImage(volumes[1], renderMode, interpolationMode));
+        }
+    }
+
+    // Floating point voxels keep their exact range.
+    const volume::Volume fractional { std::vector<float> { -0.5f, 0.25f, 2.75f, 1.0f, 0.0f, 0.5f, 0.5f, 1.5f }, glm::ivec3(2) };
+    REQUIRE(fractional.minimum() == -0.5f);
+    REQUIRE(fractional.maximum() == 2.75f);
+    REQUIRE(fractional.histogram() == std::vector<int> { 5, 2, 1 });
+}
+
+TEST_CASE("Volume Sequence Tests")
+{
+    // Time steps that differ from the previous one in a few voxels.
+    const glm::ivec3 dim { 20, 16, 12 };
+    constexpr size_t numFrames = 6;
+    std::mt19937 rng { 7 };
+    std::vector<std::vector<uint16_t>> frames(numFrames, std::vector<uint16_t>(static_cast<size_t>(dim.x * dim.y * dim.z)));
+    for (uint16_t& voxel : frames[0])
+        voxel = static_cast<uint16_t>(rng() % 1000);
+    for (size_t frame = 1; frame < numFrames; frame++) {
+        frames[frame] = frames[frame - 1];
+        for (int i = 0; i < 10; i++)
+            frames[frame][rng() % frames[frame].size()] = static_cast<uint16_t>(rng() % 1000);
+    }
+
+    // Key frame (no reference) and delta round trips. Runs of more than 65535 zeros or literals are split.
+    for (size_t frame = 0; frame < numFrames; frame++) {
+        const std::vector<uint16_t> reference = frame > 0 ? frames[frame - 1] : std::vector<uint16_t> {};
+        const std::vector<uint16_t> runs = volume::encodeDelta(frames[frame], reference);
+        std::vector<uint16_t> decoded = frame > 0 ? reference : std::vector<uint16_t>(frames[frame].size(), 0);
+        volume::applyDelta(runs, decoded);
+        REQUIRE(decoded == frames[frame]);
+        if (frame > 0)
+            REQUIRE(runs.size() <= 2 * 10 + 10 + 2);
+    }
+    std::vector<uint16_t> longRuns(200000, 0);
+    std::fill(std::begin(longRuns) + 70000, std::begin(longRuns) + 140000, uint16_t(3));
+    std::vector<uint16_t> decoded(longRuns.size(), 0);
+    volume::applyDelta(volume::encodeDelta(longRuns, {}), decoded);
+    REQUIRE(decoded == longRuns);
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "volvis_sequence";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    for (size_t frame = 0; frame < numFrames; frame++)
+        writeFLD(directory / fmt::format("frame{:02}.fld", frame), dim, frames[frame], "short");
+    const auto frameFiles = volume::VolumeSequence::findFrameFiles(directory);
+    REQUIRE(frameFiles.size() == numFrames);
+    REQUIRE_THROWS_AS(volume::VolumeSequence(std::vector<std::filesystem::path> {}), std::runtime_error);
+    const auto matches = [&](const std::shared_ptr<volume::Volume>& pVolume, size_t frame) {
+        const auto voxels = pVolume->voxels<uint16_t>();
+        return pVolume->dims() == dim && std::equal(std::begin(voxels), std::end(voxels), std::begin(frames[frame]), std::end(frames[frame]));
+    };
+    const auto waitFor = [](const auto& condition) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (!condition() && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return condition();
+    };
+
+    {
+        // Frames are decoded from the compressed copies once they have been read (playback loops).
+        volume::VolumeSequenceSettings settings {};
+        settings.cacheCapacity = 2;
+        settings.prefetchCount = 0;
+        settings.deltaCompression = true;
+        settings.keyFrameInterval = 4;
+        volume::VolumeSequence sequence { frameFiles, settings };
+        for (size_t loop = 0; loop < 2; loop++) {
+            for (size_t frame = 0; frame < numFrames; frame++) {
+                sequence.setPlayhead(frame);
+                REQUIRE(matches(sequence.frame(frame), frame));
+            }
+            if (loop == 0)
+                std::filesystem::remove_all(directory / "frame03.fld");
+        }
+        REQUIRE(sequence.compressedBytes() > 0);
+        // Two key frames (frames 0 and 4) and four small deltas.
+        REQUIRE(sequence.compressedBytes() < 3 * frames[0].size() * sizeof(uint16_t));
+    }
+    for (size_t frame = 0; frame < numFrames; frame++)
+        writeFLD(directory / fmt::format("frame{:02}.fld", frame), dim, frames[frame], "short");
+
+    {
+        // The least recently used frame outside of the prefetch window (the playhead) is evicted.
+        volume::VolumeSequenceSettings settings {};
+        settings.cacheCapacity = 3;
+        settings.prefetchCount = 0;
+        volume::VolumeSequence sequence { frameFiles, settings };
+        for (size_t frame = 0; frame < 4; frame++)
+            REQUIRE(matches(sequence.frame(frame), frame));
+        REQUIRE(sequence.tryFrame(1) == nullptr);
+        REQUIRE(sequence.tryFrame(0) != nullptr);
+        REQUIRE(sequence.tryFrame(2) != nullptr);
+        REQUIRE(sequence.tryFrame(3) != nullptr);
+        // Frames that are in use stay valid after they are evicted.
+        const auto pFrame = sequence.frame(2);
+        REQUIRE(matches(sequence.frame(4), 4));
+        REQUIRE(matches(sequence.frame(5), 5));
+        REQUIRE(sequence.tryFrame(2) == nullptr);
+        REQUIRE(matches(pFrame, 2));
+    }
+
+    {
+        // The frames following the playhead are loaded in the background (wrapping around), gradients only when
+        // requested.
+        volume::VolumeSequenceSettings settings {};
+        settings.prefetchCount = 2;
+        volume::VolumeSequence sequence { frameFiles, settings };
+        sequence.setPlayhead(4);
+        REQUIRE(waitFor([&]() { return sequence.tryFrame(4) && sequence.tryFrame(5) && sequence.tryFrame(0); }));
+        REQUIRE(matches(sequence.tryFrame(4), 4));
+        REQUIRE(matches(sequence.tryFrame(5), 5));
+        REQUIRE(matches(sequence.tryFrame(6), 0));
+        REQUIRE(sequence.tryGradientVolume(4) == nullptr);
+        sequence.setPrefetchGradients(true);
+        REQUIRE(waitFor([&]() { return sequence.tryGradientVolume(4) && sequence.tryGradientVolume(5) && sequence.tryGradientVolume(0); }));
+        const volume::GradientVolume reference { *sequence.tryFrame(5) };
+        const auto pGradientVolume = sequence.tryGradientVolume(5);
+        REQUIRE(pGradientVolume->maxMagnitude() == reference.maxMagnitude());
+        REQUIRE(pGradientVolume->getGradient(3, 4, 5).dir == reference.getGradient(3, 4, 5).dir);
+    }
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Frame Buffer Format Tests")
+{
+    volume::SyntheticVolumeSettings settings {};
+    settings.field = volume::SyntheticField::Noise;
+    settings.dim = glm::ivec3(32);
+    const volume::Volume volume = volume::SyntheticVolume(settings).generate();
+    const volume::GradientVolume gradient { volume };
+    const OrbitCamera camera { glm::vec3(volume.dims()) / 2.0f, 60.0f, 0.3f, 0.2f };
+
+    render::RenderConfig config {};
+    config.renderMode = render::RenderMode::RenderComposite;
+    config.renderResolution = glm::ivec2(40, 30);
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = volume.maximum();
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i] = glm::vec4(1.0f, 0.5f, 0.2f, float(i) / float(config.tfColorMap.size()) * 0.1f);
+    const auto renderImage = [&](render::FrameBufferFormat format) {
+        config.frameBufferFormat = format;
+        render::Renderer renderer { &volume, &gradient, &camera, config };
+        renderer.render();
+        REQUIRE(renderer.frameBufferFormat() == format);
+        return renderer.frameBuffer();
+    };
+
+    const std::vector<glm::vec4> reference = renderImage(render::FrameBufferFormat::RGBA32F);
+    REQUIRE(reference.size() == 40 * 30);
+    REQUIRE(std::any_of(std::begin(reference), std::end(reference), [](const glm::vec4& color) { return color.a > 0.0f; }));
+    // RGBA8 rounds to the nearest of 256 levels; half floats keep 11 significant bits above the smallest normal
+    // half float (6.1e-5).
+    const std::vector<glm::vec4> rgba8 = renderImage(render::FrameBufferFormat::RGBA8);
+    const std::vector<glm::vec4> rgba16F = renderImage(render::FrameBufferFormat::RGBA16F);
+    REQUIRE(rgba8.size() == reference.size());
+    REQUIRE(rgba16F.size() == reference.size());
+    for (size_t i = 0; i < reference.size(); i++) {
+        const glm::vec4 expected = glm::clamp(reference[i], 0.0f, 1.0f);
+        for (int channel = 0; channel < 4; channel++) {
+            REQUIRE(std::abs(rgba8[i][channel] - expected[channel]) <= 0.5f / 255.0f + 1e-6f);
+            REQUIRE(std::abs(rgba16F[i][channel] - reference[i][channel]) <= std::abs(reference[i][channel]) / 1024.0f + 6.2e-5f);
+        }
+    }
+}
+
+TEST_CASE("Steady State Allocation Tests")
+{
+    volume::SyntheticVolumeSettings settings {};
+    settings.field = volume::SyntheticField::Noise;
+    settings.dim = glm::ivec3(32);
+    volume::Volume volume = volume::SyntheticVolume(settings).generate();
+    volume.interpolationMode = volume::InterpolationMode::Linear;
+    const volume::GradientVolume gradient { volume };
+    const OrbitCamera camera { glm::vec3(volume.dims()) / 2.0f, 60.0f, 0.3f, 0.2f };
+
+    render::RenderConfig config {};
+    config.renderResolution = glm::ivec2(64);
+    config.isoValue = 128.0f;
+    render::Renderer renderer { &volume, &gradient, &camera, config };
+
+    // Interaction: the dynamic resolution scaling switches between a few resolutions while the render mode changes.
+    const auto interact = [&](const std::vector<render::RenderMode>& renderModes) {
+        for (const auto renderMode : renderModes) {
+            config.renderMode = renderMode;
+            for (const int resolution : { 64, 32, 21, 64 }) {
+                config.renderResolution = glm::ivec2(resolution, resolution - 5);
+                renderer.setConfig(config);
+                renderer.render();
+            }
+        }
+    };
+    // The shear-warp and multi-planar reformat modes release their caches when they are left, so they are only
+    // measured on their own.
+    const std::vector<std::vector<render::RenderMode>> renderModeGroups {
+        { render::RenderMode::RenderMIP, render::RenderMode::RenderIso, render::RenderMode::RenderComposite, render::RenderMode::RenderTF2D, render::RenderMode::RenderIsoMesh },
+        { render::RenderMode::RenderShearWarp },
+        { render::RenderMode::RenderMPR }
+    };
+    for (const auto& renderModes : renderModeGroups) {
+        interact(renderModes); // Builds the caches and fills the framebuffer pool.
+        numAllocations = 0;
+        countAllocations = true;
+        interact(renderModes);
+        interact(renderModes);
+        countAllocations = false;
+        INFO("Render mode " << int(renderModes[0]));
+        REQUIRE(numAllocations == 0);
+    }
+}
+
+TEST_CASE("Occupancy Distance Tests")
+{
+    // A few visible voxels (values of at least 128) in an otherwise transparent volume.
+    const glm::ivec3 dim { 70, 45, 33 };
+    std::vector<uint16_t> data(static_cast<size_t>(dim.x * dim.y * dim.z), 0);
+    std::mt19937 rng { 11 };
+    for (int i = 0; i < 4; i++)
+        data[std::uniform_int_distribution<size_t> { 0, data.size() - 1 }(rng)] = 200;
+    const TestVolume volume { data, dim };
+    const volume::BrickMinMax bricks { volume };
+    render::RenderConfig config {};
+    config.tfColorMap.assign(256, glm::vec4(0.0f));
+    std::fill(std::begin(config.tfColorMap) + 128, std::end(config.tfColorMap), glm::vec4(1.0f));
+    config.tfColorMapIndexRange = 256.0f;
+
+    render::OccupancyGrid occupancy { &bricks };
+    render::TransferFunction1DTable table;
+    for (const float tfColorMapIndexStart : { 0.0f, -200.0f, 0.0f }) {
+        // Shifting the transfer function by -200 makes every brick visible.
+        config.tfColorMapIndexStart = tfColorMapIndexStart;
+        table.update(config, 1.0f);
+        occupancy.update(table);
+        const glm::ivec3 brickDims = bricks.dims();
+        bool matches = true;
+        for (int z = 0; z < brickDims.z; z++) {
+            for (int y = 0; y < brickDims.y; y++) {
+                for (int x = 0; x < brickDims.x; x++) {
+                    int distance = render::OccupancyGrid::maxDistance;
+                    for (int oz = 0; oz < brickDims.z; oz++) {
+                        for (int oy = 0; oy < brickDims.y; oy++) {
+                            for (int ox = 0; ox < brickDims.x; ox++) {
+                                if (occupancy.isOccupied(glm::ivec3(ox, oy, oz)))
+                                    distance = std::min(distance, std::max({ std::abs(x - ox), std::abs(y - oy), std::abs(z - oz) }));
+                            }
+                        }
+                    }
+                    matches = matches && occupancy.distance(glm::ivec3(x, y, z)) == distance;
+                }
+            }
+        }
+        REQUIRE(matches);
+    }
+}
+
+TEST_CASE("Occupancy Transfer Function Tests")
+{
+    // Values 0 to 4094 such that the brick with the largest values ends exactly at 4094.
+    const glm::ivec3 dim { 64, 64, 2 };
+    std::vector<uint16_t> data(static_cast<size_t>(dim.x * dim.y * dim.z));
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<uint16_t>(std::min(i % 4096, size_t(4094)));
+    const TestVolume volume { data, dim };
+    const volume::BrickMinMax bricks { volume };
+
+    // Index ranges that are not a power of two, where the value to entry mapping rounds differently depending on
+    // how it is evaluated. Only a few entries are visible, among them the last one to which 4094 maps.
+    render::RenderConfig config {};
+    config.tfColorMap.assign(4096, glm::vec4(0.0f));
+    config.tfColorMap[1500] = config.tfColorMap.back() = glm::vec4(1.0f, 1.0f, 1.0f, 0.5f);
+    render::OccupancyGrid occupancy { &bricks };
+    render::TransferFunction1DTable table;
+    for (const auto& [tfColorMapIndexStart, tfColorMapIndexRange] : { std::pair { 0.0f, 4095.0f }, std::pair { -0.5f, 4093.7f }, std::pair { 3.0f, 4097.0f } }) {
+        config.tfColorMapIndexStart = tfColorMapIndexStart;
+        config.tfColorMapIndexRange = tfColorMapIndexRange;
+        table.update(config, 1.0f);
+        occupancy.update(table);
+
+        // Every sample (nearest neighbour or interpolated) in a skipped brick lies within the value range of that brick.
+        size_t numEmpty = 0;
+        bool skipsVisible = false;
+        const glm::ivec3 brickDims = bricks.dims();
+        for (int z = 0; z < brickDims.z; z++) {
+            for (int y = 0; y < brickDims.y; y++) {
+                for (int x = 0; x < brickDims.x; x++) {
+                    const glm::ivec3 brick { x, y, z };
+                    if (occupancy.isOccupied(brick))
+                        continue;
+                    numEmpty++;
+                    const glm::vec2 range = bricks.range(bricks.brickIndex(brick));
+                    skipsVisible = skipsVisible || table.lookup(range.x).a > 0.0f || table.lookup(range.y).a > 0.0f;
+                    for (float value = std::ceil(range.x); value <= range.y; value++)
+                        skipsVisible = skipsVisible || table.lookup(value).a > 0.0f;
+                }
+            }
+        }
+        REQUIRE(numEmpty > 0);
+        REQUIRE(!skipsVisible);
+    }
+}
+
+TEST_CASE("MIP Octree Tests")
+{
+    // A few bright voxels in an empty volume, such that most of the octree is pruned.
+    const glm::ivec3 dim { 40, 33, 21 };
+    std::vector<uint16_t> data(static_cast<size_t>(dim.x * dim.y * dim.z), 0);
+    std::mt19937 rng { 7 };
+    for (int i = 0; i < 50; i++)
+        data[std::uniform_int_distribution<size_t> { 0, data.size() - 1 }(rng)] = static_cast<uint16_t>(100 + i);
+
+    const OrbitCamera camera { glm::vec3(dim) / 2.0f, 60.0f, 0.3f, 0.2f };
+    std::uniform_real_distribution<float> position { 0.0f, 1.0f };
+    for (const auto interpolationMode : { volume::InterpolationMode::NearestNeighbour, volume::InterpolationMode::Linear }) {
+        TestVolume volume { data, dim };
+        volume.interpolationMode = interpolationMode;
+        const volume::GradientVolume gradient { volume };
+        TestRenderer renderer { &volume, &gradient, &camera, render::RenderConfig {} };
+
+        // Rays between two random points inside the volume. The octree samples at t = tmin + k * sampleStep,
+        // so compare against samples taken at exactly those positions.
+        for (int i = 0; i < 200; i++) {
+            const glm::vec3 begin = glm::vec3(position(rng), position(rng), position(rng)) * glm::vec3(dim - 1);
+            const glm::vec3 end = glm::vec3(position(rng), position(rng), position(rng)) * glm::vec3(dim - 1);
+            const render::Ray ray { begin, glm::normalize(end - begin), 0.0f, glm::length(end - begin) };
+            const float sampleStep = 0.5f;
+
+            float maxVal = 0.0f;
+            for (float k = 0.0f; k * sampleStep <= ray.tmax; k++)
+                maxVal = std::max(maxVal, volume.getSampleInterpolate(ray.origin + (k * sampleStep) * ray.direction));
+            REQUIRE(renderer.test_traceRayMIPOctree(ray, sampleStep).x == Approx(maxVal / volume.maximum()));
+        }
+    }
+}
+
+TEST_CASE("Iso Surface Octree Tests")
+{
+    // Values increase by 10 per voxel along x (up to 200), except for a one voxel thick shell at x = 25.
+    const glm::ivec3 dim { 40, 20, 18 };
+    std::vector<uint16_t> data(static_cast<size_t>(dim.x * dim.y * dim.z));
+    for (size_t i = 0; i < data.size(); i++) {
+        const int x = static_cast<int>(i % static_cast<size_t>(dim.x));
+        data[i] = static_cast<uint16_t>(x == 25 ? 1000 : std::min(10 * x, 200));
+    }
+
+    const OrbitCamera camera { glm::vec3(dim) / 2.0f, 60.0f, 0.3f, 0.2f };
+    render::RenderConfig config {};
+    for (const auto interpolationMode : { volume::InterpolationMode::NearestNeighbour, volume::InterpolationMode::Linear }) {
+        TestVolume volume { data, dim };
+        volume.interpolationMode = interpolationMode;
+        const volume::GradientVolume gradient { volume };
+
+        // The ramp reaches 55 at x = 5.5 both with trilinear interpolation and with nearest neighbour (where the
+        // region of voxel 6 starts).
+        config.isoValue = 55.0f;
+        TestRenderer renderer { &volume, &gradient, &camera, config };
+        const glm::vec3 direction = glm::normalize(glm::vec3(1.0f, 0.3f, -0.2f));
+        const render::Ray ray { glm::vec3(0.5f, 5.0f, 10.0f), direction, 0.0f, 30.0f };
+        const auto t = renderer.test_findIsoSurfaceOctree(ray);
+        REQUIRE(t.has_value());
+        REQUIRE(ray.origin.x + *t * direction.x == Approx(5.5f).margin(1e-3f));
+
+        // Only the thin shell is above 500. Rays that cross it between two samples must still hit it.
+        config.isoValue = 500.0f;
+        renderer.setConfig(config);
+        const render::Ray crossing { glm::vec3(20.0f, 2.0f, 3.0f), glm::normalize(glm::vec3(1.0f, 0.8f, 0.7f)), 0.0f, 14.0f };
+        REQUIRE(renderer.test_findIsoSurfaceOctree(crossing).has_value());
+        const render::Ray parallel { glm::vec3(20.0f, 2.0f, 3.0f), glm::normalize(glm::vec3(0.0f, 0.8f, 0.7f)), 0.0f, 14.0f };
+        REQUIRE_FALSE(renderer.test_findIsoSurfaceOctree(parallel).has_value());
+    }
+}
+
+TEST_CASE("Marching Cubes Tests")
+{
+    // A ball of values that decrease away from the center; the iso surface is a closed sphere.
+    const glm::ivec3 dim { 30, 27, 25 };
+    const glm::vec3 center = glm::vec3(dim - 1) / 2.0f;
+    std::vector<uint16_t> data(static_cast<size_t>(dim.x * dim.y * dim.z));
+    for (int z = 0, i = 0; z < dim.z; z++) {
+        for (int y = 0; y < dim.y; y++) {
+            for (int x = 0; x < dim.x; x++, i++)
+                data[static_cast<size_t>(i)] = static_cast<uint16_t>(std::max(0.0f, 200.0f - 20.0f * glm::length(glm::vec3(x, y, z) - center)));
+        }
+    }
+    TestVolume volume { data, dim };
+    volume.interpolationMode = volume::InterpolationMode::Linear;
+    const volume::GradientVolume gradient { volume };
+    const float isoValue = 100.5f;
+    const mesh::TriangleMesh isoSurface = mesh::extractIsoSurface(volume, gradient, isoValue);
+
+    // Shared vertices: a closed surface of genus 0 has Euler characteristic V - E + F = 2 where E = 3F / 2.
+    REQUIRE(!isoSurface.triangles.empty());
+    REQUIRE(isoSurface.positions.size() == isoSurface.normals.size());
+    REQUIRE(int64_t(isoSurface.positions.size()) - int64_t(isoSurface.triangles.size()) / 2 == 2);
+
+    // The mesh and the exact iso surface of the volume agree up to the marching cubes approximation, and the
+    // normals face the ray.
+    const mesh::TriangleBVH bvh { isoSurface };
+    const OrbitCamera camera { center, 60.0f, 0.3f, 0.2f };
+    render::RenderConfig config {};
+    config.isoValue = isoValue;
+    TestRenderer renderer { &volume, &gradient, &camera, config };
+    for (const glm::vec3 direction : { glm::vec3(1, 0, 0), glm::vec3(0, -1, 0), glm::normalize(glm::vec3(1, 2, 3)) }) {
+        const render::Ray ray { center - 14.0f * direction, direction, 0.0f, 14.0f };
+        const auto meshHit = bvh.intersect(ray);
+        const auto volumeHit = renderer.test_findIsoSurfaceOctree(ray);
+        REQUIRE(meshHit.has_value());
+        REQUIRE(volumeHit.has_value());
+        REQUIRE(meshHit->t == Approx(*volumeHit).margin(0.1f));
+        REQUIRE(glm::dot(meshHit->normal, direction) < 0.0f);
+    }
+}
+
+TEST_CASE("Synthetic Volume Tests")
+{
+    volume::SyntheticVolumeSettings settings {};
+    settings.dim = glm::ivec3(48, 40, 36);
+    for (const auto field : { volume::SyntheticField::Sphere, volume::SyntheticField::Gradient, volume::SyntheticField::Noise,
+             volume::SyntheticField::SparseBlobs, volume::SyntheticField::MarschnerLobb }) {
+        settings.field = field;
+        const volume::SyntheticVolume synthetic { settings };
+        const volume::Volume volume = synthetic.generate();
+        REQUIRE(volume.dims() == settings.dim);
+        REQUIRE(volume.maximum() <= float(settings.maxValue));
+        REQUIRE(volume.maximum() > volume.minimum());
+        // Lazily evaluated voxels match the generated volume.
+        REQUIRE(synthetic.voxel(17, 3, 29) == static_cast<uint16_t>(volume.getVoxel(17, 3, 29)));
+    }
+
+    // The fraction of empty voxels follows the requested empty fraction, also near the faces of the volume.
+    settings.field = volume::SyntheticField::SparseBlobs;
+    settings.dim = glm::ivec3(64);
+    settings.blobRadius = 3.0f;
+    for (const float emptyFraction : { 0.5f, 0.9f, 0.99f }) {
+        settings.emptyFraction = emptyFraction;
+        const volume::Volume volume = volume::SyntheticVolume(settings).generate();
+        const float numVoxels = float(settings.dim.x * settings.dim.y * settings.dim.z);
+        REQUIRE(float(volume.histogram()[0]) / numVoxels == Approx(emptyFraction).margin(0.03f));
+    }
+}
+
+// Golden image regression tests: canonical synthetic volumes are rendered in every render mode and interpolation
+// mode from fixed camera poses and compared against reference images in integrity_tests/golden/. The images of a
+// volume are stored as one atlas (a column per pose, a row per render mode and interpolation mode) in the PAM
+// format. Set VOLVIS_UPDATE_GOLDEN=1 to (re)write the references after an intended change of the output.
+struct GoldenImage {
+    glm::ivec2 size { 0 };
+    std::vector<glm::u8vec4> pixels; // Top row first.
+};
+
+static const std::array<const char*, 3> goldenVolumeNames { "sphere", "gradient", "noise" };
+static const std::array<std::pair<render::RenderMode, const char*>, 8> goldenRenderModes { {
+    { render::RenderMode::RenderSlicer, "Slicer" },
+    { render::RenderMode::RenderMIP, "MIP" },
+    { render::RenderMode::RenderIso, "Iso" },
+    { render::RenderMode::RenderComposite, "Composite" },
+    { render::RenderMode::RenderTF2D, "TF2D" },
+    { render::RenderMode::RenderIsoMesh, "IsoMesh" },
+    { render::RenderMode::RenderShearWarp, "ShearWarp" },
+    { render::RenderMode::RenderMPR, "MPR" },
+} };
+static const std::array<std::pair<volume::InterpolationMode, const char*>, 3> goldenInterpolationModes { {
+    { volume::InterpolationMode::NearestNeighbour, "NearestNeighbour" },
+    { volume::InterpolationMode::Linear, "Linear" },
+    { volume::InterpolationMode::Cubic, "Cubic" },
+} };
+// Camera (yaw, pitch) around the center of the volume.
+static const std::array<glm::vec2, 2> goldenPoses { glm::vec2(0.4f, 0.3f), glm::vec2(2.5f, -0.6f) };
+
+static bool environmentFlag(const char* name)
+{
+    const char* value = std::getenv(name);
+    return value != nullptr && std::string(value) != "0";
+}
+
+// Only uses the raw output of std::mt19937 (the distributions are implementation defined) such that the volumes
+// are identical on every platform.
+static volume::Volume goldenVolume(const std::string& name, int size)
+{
+    const glm::ivec3 dim { size };
+    const glm::vec3 center = glm::vec3(dim - 1) / 2.0f;
+
+    // Value noise: random values on a coarse lattice that are interpolated trilinearly.
+    constexpr int latticeSize = 5;
+    std::mt19937 rng { 2024 };
+    std::vector<float> lattice(latticeSize * latticeSize * latticeSize);
+    for (float& value : lattice)
+        value = float(rng() % 1024) / 1023.0f;
+    const auto noise = [&](const glm::vec3& position) {
+        const glm::vec3 latticePosition = position / glm::vec3(dim - 1) * float(latticeSize - 1);
+        const glm::ivec3 base = glm::min(glm::ivec3(latticePosition), glm::ivec3(latticeSize - 2));
+        const glm::vec3 fraction = latticePosition - glm::vec3(base);
+        float value = 0.0f;
+        for (int corner = 0; corner < 8; corner++) {
+            const glm::ivec3 offset { corner & 1, (corner >> 1) & 1, (corner >> 2) & 1 };
+            const glm::ivec3 node = base + offset;
+            float weight = 1.0f;
+            for (int axis = 0; axis < 3; axis++)
+                weight *= offset[axis] ? fraction[axis] : 1.0f - fraction[axis];
+            value += weight * lattice[static_cast<size_t>(node.x + latticeSize * (node.y + latticeSize * node.z))];
+        }
+        return value;
+    };
+
+    std::vector<uint16_t> data(static_cast<size_t>(dim.x * dim.y * dim.z));
+    for (int z = 0, i = 0; z < dim.z; z++) {
+        for (int y = 0; y < dim.y; y++) {
+            for (int x = 0; x < dim.x; x++, i++) {
+                const glm::vec3 position { x, y, z };
+                float value = 0.0f;
+                if (name == "sphere")
+                    value = 220.0f * (1.0f - glm::length(position - center) / (0.45f * float(size)));
+                else if (name == "gradient")
+                    value = 200.0f * (position.x + position.y + position.z) / (3.0f * float(size - 1));
+                else
+                    value = 200.0f * noise(position);
+                data[static_cast<size_t>(i)] = static_cast<uint16_t>(std::clamp(value, 0.0f, 255.0f));
+            }
+        }
+    }
+    return volume::Volume { std::move(data), dim };
+}
+
+static render::RenderConfig goldenConfig(render::RenderMode renderMode, int resolution)
+{
+    render::RenderConfig config {};
+    config.renderMode = renderMode;
+    config.renderResolution = glm::ivec2(resolution);
+    config.volumeShading = true;
+    config.isoValue = 100.0f;
+    for (size_t i = 0; i < config.tfColorMap.size(); i++) {
+        const float t = float(i) / float(config.tfColorMap.size() - 1);
+        config.tfColorMap[i] = glm::vec4(t, 0.5f, 1.0f - t, 0.1f * t);
+    }
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 200.0f;
+    config.tfColorMapVersion = 1;
+    config.TF2DIntensity = 100.0f;
+    config.TF2DRadius = 30.0f;
+    config.TF2DColor = glm::vec4(1.0f, 0.6f, 0.2f, 0.1f);
+    return config;
+}
+
+static std::unique_ptr<OrbitCamera> goldenCamera(const volume::Volume& volume, const glm::vec2& pose)
+{
+    const glm::vec3 dim = glm::vec3(volume.dims());
+    return std::make_unique<OrbitCamera>(dim / 2.0f, 1.3f * dim.x, pose.x, pose.y);
+}
+
+static GoldenImage renderGoldenAtlas(volume::Volume& volume, const volume::GradientVolume& gradient, int resolution)
+{
+    GoldenImage atlas;
+    atlas.size = resolution * glm::ivec2(int(goldenPoses.size()), int(goldenRenderModes.size() * goldenInterpolationModes.size()));
+    atlas.pixels.resize(static_cast<size_t>(atlas.size.x * atlas.size.y));
+    for (size_t mode = 0; mode < goldenRenderModes.size(); mode++) {
+        for (size_t interpolation = 0; interpolation < goldenInterpolationModes.size(); interpolation++) {
+            volume.interpolationMode = goldenInterpolationModes[interpolation].first;
+            for (size_t pose = 0; pose < goldenPoses.size(); pose++) {
+                const auto camera = goldenCamera(volume, goldenPoses[pose]);
+                render::Renderer renderer { &volume, &gradient, camera.get(), goldenConfig(goldenRenderModes[mode].first, resolution) };
+                renderer.render();
+                const auto bytes = renderer.frameBufferBytes();
+
+                // The frame buffer starts at the bottom row.
+                const glm::ivec2 tileOrigin = resolution * glm::ivec2(int(pose), int(mode * goldenInterpolationModes.size() + interpolation));
+                for (int y = 0; y < resolution; y++) {
+                    for (int x = 0; x < resolution; x++) {
+                        const size_t source = static_cast<size_t>((resolution - 1 - y) * resolution + x) * 4;
+                        atlas.pixels[static_cast<size_t>((tileOrigin.y + y) * atlas.size.x + tileOrigin.x + x)] = glm::u8vec4(
+                            uint8_t(bytes[source]), uint8_t(bytes[source + 1]), uint8_t(bytes[source + 2]), uint8_t(bytes[source + 3]));
+                    }
+                }
+            }
+        }
+    }
+    return atlas;
+}
+
+static bool writePAM(const std::filesystem::path& filePath, const GoldenImage& image)
+{
+    std::ofstream file { filePath, std::ios::binary };
+    if (!file.is_open())
+        return false;
+    file << "P7\nWIDTH " << image.size.x << "\nHEIGHT " << image.size.y << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+    file.write(reinterpret_cast<const char*>(image.pixels.data()), std::streamsize(image.pixels.size() * sizeof(glm::u8vec4)));
+    return file.good();
+}
+
+static std::optional<GoldenImage> readPAM(const std::filesystem::path& filePath)
+{
+    std::ifstream file { filePath, std::ios::binary };
+    std::string token;
+    if (!(file >> token) || token != "P7")
+        return {};
+    GoldenImage image;
+    int depth = 0, maxValue = 0;
+    while (file >> token && token != "ENDHDR") {
+        if (token == "WIDTH")
+            file >> image.size.x;
+        else if (token == "HEIGHT")
+            file >> image.size.y;
+        else if (token == "DEPTH")
+            file >> depth;
+        else if (token == "MAXVAL")
+            file >> maxValue;
+        else if (token == "TUPLTYPE")
+            file >> token;
+    }
+    if (depth != 4 || maxValue != 255 || image.size.x <= 0 || image.size.y <= 0)
+        return {};
+    file.get(); // Line break after ENDHDR.
+    image.pixels.resize(static_cast<size_t>(image.size.x * image.size.y));
+    file.read(reinterpret_cast<char*>(image.pixels.data()), std::streamsize(image.pixels.size() * sizeof(glm::u8vec4)));
+    if (!file)
+        return {};
+    return image;
+}
+
+TEST_CASE("Shading Tests")
+{
+    const glm::vec3 normal = glm::normalize(glm::vec3(0.3f, -0.8f, 0.1f));
+    REQUIRE(glm::length(render::unpackNormal(render::packNormal(normal)) - normal) < 0.005f);
+    REQUIRE(render::unpackNormal(render::packNormal(glm::vec3(0.0f))) == glm::vec3(0.0f));
+
+    // The table based shading matches computePhongShading with the light at the camera.
+    const volume::Volume volume { std::vector<uint16_t>(125, 0), glm::ivec3(5) };
+    const volume::GradientVolume gradientVolume { volume };
+    const OrbitCamera camera { glm::vec3(2.5f), 10.0f, 0.0f, 0.0f };
+    TestRenderer renderer { &volume, &gradientVolume, &camera, render::RenderConfig {} };
+    const render::HeadlightShading shading {};
+    const glm::vec3 color { 0.9f, 0.5f, 0.2f };
+    std::mt19937 rng { 7 };
+    const auto randomDirection = [&]() {
+        const auto coordinate = [&]() { return float(rng() % 2001) / 1000.0f - 1.0f; };
+        return render::normalizeOrZero(glm::vec3(coordinate(), coordinate(), coordinate()));
+    };
+    for (int i = 0; i < 1000; i++) {
+        const glm::vec3 gradient = randomDirection();
+        const glm::vec3 viewDirection = randomDirection();
+        const glm::vec3 reference = renderer.test_computePhongShading(color, volume::GradientVoxel { gradient, 1.0f }, viewDirection, viewDirection);
+        REQUIRE(glm::length(shading.shade(color, gradient, viewDirection) - reference) < 0.005f);
+    }
+    REQUIRE(shading.shade(color, glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f)) == 0.1f * color);
+}
+
+TEST_CASE("Pre-classification Tests")
+{
+    // Compositing from the classified volume only differs by the quantization (and, when interpolating, by
+    // classifying before instead of after interpolation).
+    volume::Volume volume = goldenVolume("noise", 32);
+    volume::GradientVolume gradient { volume };
+    const auto camera = goldenCamera(volume, goldenPoses[0]);
+    for (const auto interpolationMode : { volume::InterpolationMode::NearestNeighbour, volume::InterpolationMode::Linear }) {
+        volume.interpolationMode = interpolationMode;
+        gradient.interpolationMode = interpolationMode;
+        const auto renderImage = [&](render::PreClassification preClassification) {
+            render::RenderConfig config = goldenConfig(render::RenderMode::RenderComposite, 64);
+            config.preClassification = preClassification;
+            render::Renderer renderer { &volume, &gradient, camera.get(), config };
+            renderer.render();
+            const auto bytes = renderer.frameBufferBytes();
+            return std::vector<std::byte>(std::begin(bytes), std::end(bytes));
+        };
+        const auto reference = renderImage(render::PreClassification::Off);
+        const auto classified = renderImage(render::PreClassification::On);
+        REQUIRE(reference.size() == classified.size());
+        int maxDifference = 0;
+        for (size_t i = 0; i < reference.size(); i++)
+            maxDifference = std::max(maxDifference, std::abs(int(reference[i]) - int(classified[i])));
+        INFO("Maximum channel difference " << maxDifference);
+        REQUIRE(maxDifference <= 8);
+    }
+}
+
+TEST_CASE("Shear-warp Tests")
+{
+    volume::Volume volume = goldenVolume("noise", 32);
+    volume::GradientVolume gradient { volume };
+    volume.interpolationMode = volume::InterpolationMode::Linear;
+    gradient.interpolationMode = volume::InterpolationMode::Linear;
+    const auto renderImage = [&](render::RenderMode renderMode, const render::RayTraceCamera& camera) {
+        render::Renderer renderer { &volume, &gradient, &camera, goldenConfig(renderMode, 64) };
+        renderer.render();
+        const auto bytes = renderer.frameBufferBytes();
+        return std::vector<std::byte>(std::begin(bytes), std::end(bytes));
+    };
+
+    // Shear-warp samples on the slices instead of at equal distances along the rays, and classifies before
+    // interpolating; only a few colors differ noticeably. The opacity is not compared: the intermediate image has
+    // the resolution of the volume, so the (transparent) silhouette is blurred by the warp.
+    for (const glm::vec2& pose : goldenPoses) {
+        const auto camera = goldenCamera(volume, pose);
+        const auto reference = renderImage(render::RenderMode::RenderComposite, *camera);
+        const auto shearWarp = renderImage(render::RenderMode::RenderShearWarp, *camera);
+        REQUIRE(reference.size() == shearWarp.size());
+        int numDifferent = 0;
+        for (size_t i = 0; i < reference.size(); i++) {
+            if (i % 4 != 3 && std::abs(int(reference[i]) - int(shearWarp[i])) > 16)
+                numDifferent++;
+        }
+        INFO("Color channels that differ " << numDifferent);
+        REQUIRE(float(numDifferent) <= 0.02f * float(reference.size()));
+    }
+
+    // With the camera in between the slices it falls back to ray casting.
+    const OrbitCamera insideCamera { glm::vec3(16.0f), 8.0f, 0.4f, 0.3f };
+    REQUIRE(renderImage(render::RenderMode::RenderShearWarp, insideCamera) == renderImage(render::RenderMode::RenderComposite, insideCamera));
+}
+
+TEST_CASE("Multi-planar Reformat Tests")
+{
+    volume::Volume volume = goldenVolume("noise", 32);
+    const auto renderImage = [](const volume::Volume& slicedVolume, const render::RenderConfig& config, const render::RayTraceCamera& camera) {
+        render::Renderer renderer { &slicedVolume, nullptr, &camera, config };
+        renderer.render();
+        const auto bytes = renderer.frameBufferBytes();
+        return std::vector<std::byte>(std::begin(bytes), std::end(bytes));
+    };
+    const auto camera = goldenCamera(volume, goldenPoses[0]);
+
+    // With a pixel per voxel the axial slices sample the voxels (nearest neighbour).
+    render::RenderConfig config = goldenConfig(render::RenderMode::RenderMPR, 32);
+    config.slicePosition = 10.0f / 31.0f;
+    volume.interpolationMode = volume::InterpolationMode::NearestNeighbour;
+    const auto axial = renderImage(volume, config, *camera);
+    for (int y = 0; y < 32; y += 5) {
+        for (int x = 0; x < 32; x += 3) {
+            const float expected = volume.getVoxel(x, y, 10) / volume.maximum();
+            REQUIRE(int(axial[size_t(y * 32 + x) * 4]) == int(std::round(expected * 255.0f)));
+        }
+    }
+
+    // A slab MIP is at least as bright as its center slice; the average of a slab through a linear field is the
+    // center slice.
+    config.slabThickness = 6.0f;
+    config.slabMode = render::SlabMode::MIP;
+    const auto slabMIP = renderImage(volume, config, *camera);
+    for (size_t i = 0; i < axial.size(); i++)
+        REQUIRE(slabMIP[i] >= axial[i]);
+    const volume::Volume gradientField = goldenVolume("gradient", 32);
+    config.slicePosition = 0.5f;
+    config.slabMode = render::SlabMode::Average;
+    const auto slabAverage = renderImage(gradientField, config, *camera);
+    config.slabThickness = 0.0f;
+    const auto centerSlice = renderImage(gradientField, config, *camera);
+    for (size_t i = 0; i < centerSlice.size(); i++)
+        REQUIRE(std::abs(int(slabAverage[i]) - int(centerSlice[i])) <= 2);
+
+    // The camera plane through the center samples the same positions as the slicer.
+    volume.interpolationMode = volume::InterpolationMode::Linear;
+    config = goldenConfig(render::RenderMode::RenderMPR, 64);
+    config.sliceOrientation = render::SliceOrientation::Camera;
+    const auto mpr = renderImage(volume, config, *camera);
+    const auto slicer = renderImage(volume, goldenConfig(render::RenderMode::RenderSlicer, 64), *camera);
+    for (size_t i = 0; i < mpr.size(); i += 4) {
+        if (mpr[i + 3] != std::byte { 0 })
+            REQUIRE(std::abs(int(mpr[i]) - int(slicer[i])) <= 1);
+    }
+}
+
+TEST_CASE("Golden Image Tests")
+{
+    // A pixel differs if any channel differs by more than channelTolerance; a tile fails if more than
+    // pixelTolerance of its pixels differ. This absorbs small floating point differences between compilers.
+    constexpr int resolution = 32;
+    constexpr int channelTolerance = 8;
+    constexpr float pixelTolerance = 0.02f;
+    const std::filesystem::path goldenDir = GOLDEN_DIR;
+    const bool update = environmentFlag("VOLVIS_UPDATE_GOLDEN");
+
+    for (const char* volumeName : goldenVolumeNames) {
+        volume::Volume volume = goldenVolume(volumeName, 32);
+        const volume::GradientVolume gradient { volume };
+        const GoldenImage atlas = renderGoldenAtlas(volume, gradient, resolution);
+
+        const std::filesystem::path referencePath = goldenDir / (std::string(volumeName) + ".pam");
+        INFO("Reference image " << referencePath.string());
+        if (update) {
+            REQUIRE(writePAM(referencePath, atlas));
+            continue;
+        }
+        const auto reference = readPAM(referencePath);
+        REQUIRE(reference.has_value());
+        REQUIRE(reference->size == atlas.size);
+
+        bool matches = true;
+        for (int row = 0; row < atlas.size.y / resolution; row++) {
+            for (int column = 0; column < atlas.size.x / resolution; column++) {
+                int numDifferent = 0;
+                for (int y = row * resolution; y < (row + 1) * resolution; y++) {
+                    for (int x = column * resolution; x < (column + 1) * resolution; x++) {
+                        const size_t i = static_cast<size_t>(y * atlas.size.x + x);
+                        const glm::ivec4 difference = glm::abs(glm::ivec4(atlas.pixels[i]) - glm::ivec4(reference->pixels[i]));
+                        if (std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)) > channelTolerance)
+                            numDifferent++;
+                    }
+                }
+                const size_t mode = static_cast<size_t>(row) / goldenInterpolationModes.size();
+                const size_t interpolation = static_cast<size_t>(row) % goldenInterpolationModes.size();
+                INFO(volumeName << ", " << goldenRenderModes[mode].second << ", " << goldenInterpolationModes[interpolation].second << ", pose " << column);
+                CHECK(float(numDifferent) <= pixelTolerance * float(resolution * resolution));
+                matches = matches && float(numDifferent) <= pixelTolerance * float(resolution * resolution);
+            }
+        }
+        // Keep the rendered atlas (in the working directory) so it can be compared with the reference.
+        if (!matches)
+            writePAM(std::string(volumeName) + "_actual.pam", atlas);
+    }
+}
+
+// Render time budgets of the golden image scenes, stored in integrity_tests/golden/budgets.txt as milliseconds per
+// frame. The test fails if a scene renders more than budgetTolerance times slower than its budget. Hidden since the
+// budgets only hold on the machine on which they were recorded (run with: IntegrityTests [performance], or ctest -L
+// performance when configured with VOLVIS_PERFORMANCE_TESTS=ON). Re-record the budgets on that machine with
+// VOLVIS_UPDATE_BUDGETS=1 after an intended change of the render times.
+TEST_CASE("Golden Image Performance Budgets", "[.][performance]")
+{
+    constexpr int resolution = 128;
+    constexpr double budgetTolerance = 1.5;
+    // Small absolute slack (in milliseconds) such that the fastest scenes do not fail on timer noise.
+    constexpr double budgetSlack = 1.0;
+    const std::filesystem::path budgetsPath = std::filesystem::path(GOLDEN_DIR) / "budgets.txt";
+    const bool update = environmentFlag("VOLVIS_UPDATE_BUDGETS");
+    // Render on a fixed number of threads such that the budgets do not depend on the number of cores.
+    const tbb::global_control threads { tbb::global_control::max_allowed_parallelism, 1 };
+
+    std::map<std::string, double> budgets;
+    std::ifstream budgetsFile { budgetsPath };
+    std::string scene;
+    double budget = 0.0;
+    while (budgetsFile >> scene >> budget)
+        budgets[scene] = budget;
+    INFO("Budgets " << budgetsPath.string());
+    REQUIRE((update || !budgets.empty()));
+
+    std::map<std::string, double> renderTimes;
+    for (const char* volumeName : goldenVolumeNames) {
+        volume::Volume volume = goldenVolume(volumeName, 64);
+        const volume::GradientVolume gradient { volume };
+        const auto camera = goldenCamera(volume, goldenPoses[0]);
+        for (const auto& [renderMode, renderModeName] : goldenRenderModes) {
+            for (const auto& [interpolationMode, interpolationModeName] : goldenInterpolationModes) {
+                volume.interpolationMode = interpolationMode;
+                render::Renderer renderer { &volume, &gradient, camera.get(), goldenConfig(renderMode, resolution) };
+                // The first frame also builds the caches (occupancy grids, iso surface mesh); take the best of the
+                // following frames.
+                renderer.render();
+                std::chrono::duration<double, std::milli> renderTime { std::numeric_limits<double>::max() };
+                for (int frame = 0; frame < 3; frame++) {
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    renderer.render();
+                    renderTime = std::min<std::chrono::duration<double, std::milli>>(renderTime, std::chrono::high_resolution_clock::now() - start);
+                }
+                renderTimes[fmt::format("{}/{}/{}", volumeName, renderModeName, interpolationModeName)] = renderTime.count();
+            }
+        }
+    }
+
+    if (update) {
+        std::ofstream file { budgetsPath };
+        for (const auto& [name, renderTime] : renderTimes)
+            file << name << ' ' << fmt::format("{:.2f}", renderTime) << '\n';
+        REQUIRE(file.good());
+        return;
+    }
+    for (const auto& [name, renderTime] : renderTimes) {
+        INFO(name << ": " << renderTime << "ms");
+        REQUIRE(budgets.find(name) != std::end(budgets));
+        INFO("Budget: " << budgets[name] << "ms");
+        CHECK(renderTime <= budgetTolerance * budgets[name] + budgetSlack);
+    }
+}
+
+// Hidden benchmark (run with: IntegrityTests [benchmark]) that renders random views of the same volume stored
+// in the linear and Morton voxel layouts. Used to decide which layout to use by default.
+TEST_CASE("Voxel Layout Benchmark", "[.][benchmark]")
+{
+    const glm::ivec3 dim { 192 };
+    std::vector<uint16_t> data(static_cast<size_t>(dim.x * dim.y * dim.z));
+    std::mt19937 rng { 1234 };
+    std::uniform_int_distribution<int> noise { 0, 20 };
+    for (int z = 0, i = 0; z < dim.z; z++) {
+        for (int y = 0; y < dim.y; y++) {
+            for (int x = 0; x < dim.x; x++, i++) {
+                const float distance = glm::length(glm::vec3(x, y, z) - glm::vec3(dim) / 2.0f);
+                data[static_cast<size_t>(i)] = static_cast<uint16_t>(std::max(0.0f, 200.0f - distance * 2.0f) + float(noise(rng)));
+            }
+        }
+    }
+
+    render::RenderConfig config {};
+    config.renderResolution = glm::ivec2(256);
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i] = glm::vec4(1.0f, 1.0f, 1.0f, float(i) / float(config.tfColorMap.size()) * 0.05f);
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 255.0f;
+
+    for (const auto layout : { volume::VoxelLayout::Linear, volume::VoxelLayout::Morton }) {
+        volume::Volume volume { data, dim, layout };
+        volume.interpolationMode = volume::InterpolationMode::Linear;
+        const volume::GradientVolume gradient { volume };
+
+        for (const auto renderMode : { render::RenderMode::RenderMIP, render::RenderMode::RenderComposite }) {
+            config.renderMode = renderMode;
+            std::mt19937 viewRng { 42 };
+            std::uniform_real_distribution<float> angle { -3.14159f, 3.14159f };
+            std::chrono::duration<double, std::milli> renderTime { 0 };
+            constexpr int numViews = 16;
+            for (int view = 0; view < numViews; view++) {
+                const OrbitCamera camera { glm::vec3(dim) / 2.0f, 2.0f * float(dim.x), angle(viewRng), angle(viewRng) / 2.0f };
+                render::Renderer renderer { &volume, &gradient, &camera, config };
+                const auto start = std::chrono::high_resolution_clock::now();
+                renderer.render();
+                renderTime += std::chrono::high_resolution_clock::now() - start;
+            }
+            std::cout << (layout == volume::VoxelLayout::Linear ? "Linear" : "Morton") << " layout, "
+                      << (renderMode == render::RenderMode::RenderMIP ? "MIP" : "compositing") << ": "
+                      << renderTime.count() / numViews << "ms per view" << std::endl;
+        }
+    }
+}
+
+// Hidden benchmark (run with: IntegrityTests [benchmark]) that compares the render time of the voxel types on a
+// volume that does not fit in the caches.
+TEST_CASE("Voxel Type Benchmark", "[.][benchmark]")
+{
+    volume::SyntheticVolumeSettings settings {};
+    settings.field = volume::SyntheticField::Noise;
+    settings.dim = glm::ivec3(256);
+    render::RenderConfig config {};
+    config.renderResolution = glm::ivec2(256);
+    config.renderMode = render::RenderMode::RenderMIP;
+
+    for (const auto& [voxelType, name] : { std::pair { volume::VoxelType::UInt8, "8-bit" }, std::pair { volume::VoxelType::UInt16, "16-bit" },
+             std::pair { volume::VoxelType::Half, "half" }, std::pair { volume::VoxelType::Float, "float" } }) {
+        settings.voxelType = voxelType;
+        volume::Volume volume = volume::SyntheticVolume(settings).generate();
+        for (const auto interpolationMode : { volume::InterpolationMode::NearestNeighbour, volume::InterpolationMode::Linear }) {
+            volume.interpolationMode = interpolationMode;
+            std::mt19937 viewRng { 42 };
+            std::chrono::duration<double, std::milli> renderTime { 0 };
+            constexpr int numViews = 8;
+            for (int view = 0; view < numViews; view++) {
+                const float yaw = 6.28318f * float(viewRng() % 1000) / 1000.0f;
+                const OrbitCamera camera { glm::vec3(volume.dims()) / 2.0f, 2.0f * float(settings.dim.x), yaw, 0.3f };
+                render::Renderer renderer { &volume, nullptr, &camera, config };
+                const auto start = std::chrono::high_resolution_clock::now();
+                renderer.render();
+                renderTime += std::chrono::high_resolution_clock::now() - start;
+            }
+            std::cout << name << ", " << (interpolationMode == volume::InterpolationMode::Linear ? "linear" : "nearest neighbour")
+                      << " MIP: " << renderTime.count() / numViews << "ms per view" << std::endl;
+        }
+    }
+}
+
+TEST_CASE("Pre-classification Benchmark", "[.][benchmark]")
+{
+    volume::SyntheticVolumeSettings settings {};
+    settings.field = volume::SyntheticField::Noise;
+    settings.dim = glm::ivec3(192);
+    volume::Volume volume = volume::SyntheticVolume(settings).generate();
+    volume::GradientVolume gradient { volume };
+    render::RenderConfig config = goldenConfig(render::RenderMode::RenderComposite, 256);
+    config.tfColorMapIndexRange = volume.maximum();
+
+    for (const auto interpolationMode : { volume::InterpolationMode::NearestNeighbour, volume::InterpolationMode::Linear }) {
+        volume.interpolationMode = interpolationMode;
+        gradient.interpolationMode = interpolationMode;
+        for (const auto preClassification : { render::PreClassification::Off, render::PreClassification::On }) {
+            config.preClassification = preClassification;
+            OrbitCamera camera { glm::vec3(volume.dims()) / 2.0f, 2.0f * float(settings.dim.x), 0.0f, 0.3f };
+            render::Renderer renderer { &volume, &gradient, &camera, config };
+            renderer.render(); // Builds the caches (including the classified volume).
+
+            std::mt19937 viewRng { 42 };
+            std::chrono::duration<double, std::milli> renderTime { 0 };
+            constexpr int numViews = 8;
+            for (int view = 0; view < numViews; view++) {
+                const float yaw = 6.28318f * float(viewRng() % 1000) / 1000.0f;
+                camera = OrbitCamera { glm::vec3(volume.dims()) / 2.0f, 2.0f * float(settings.dim.x), yaw, 0.3f };
+                const auto start = std::chrono::high_resolution_clock::now();
+                renderer.render();
+                renderTime += std::chrono::high_resolution_clock::now() - start;
+            }
+            std::cout << (interpolationMode == volume::InterpolationMode::Linear ? "linear" : "nearest neighbour")
+                      << (preClassification == render::PreClassification::On ? ", pre-classified" : "")
+                      << " compositing: " << renderTime.count() / numViews << "ms per view" << std::endl;
+        }
+    }
+}
+
+// Hidden benchmark (run with: IntegrityTests [benchmark]) that sweeps the size and sparsity of a synthetic volume to
+// measure how the render modes scale.
+TEST_CASE("Renderer Scaling Benchmark", "[.][benchmark]")
+{
+    render::RenderConfig config {};
+    config.renderResolution = glm::ivec2(256);
+    config.isoValue = 128.0f;
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i] = glm::vec4(1.0f, 1.0f, 1.0f, float(i) / float(config.tfColorMap.size()) * 0.05f);
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 255.0f;
+
+    volume::SyntheticVolumeSettings settings {};
+    settings.field = volume::SyntheticField::SparseBlobs;
+    for (const int size : { 32, 64, 128, 256 }) {
+        for (const float emptyFraction : { 0.5f, 0.9f, 0.99f }) {
+            settings.dim = glm::ivec3(size);
+            settings.blobRadius = float(size) / 32.0f;
+            settings.emptyFraction = emptyFraction;
+            volume::Volume volume = volume::SyntheticVolume(settings).generate();
+            volume.interpolationMode = volume::InterpolationMode::Linear;
+            const volume::GradientVolume gradient { volume };
+            const OrbitCamera camera { glm::vec3(volume.dims()) / 2.0f, 2.0f * float(size), 0.5f, 0.3f };
+
+            for (const auto& [renderMode, name] : { std::pair { render::RenderMode::RenderMIP, "MIP" }, std::pair { render::RenderMode::RenderIso, "Iso" },
+                     std::pair { render::RenderMode::RenderComposite, "compositing" } }) {
+                config.renderMode = renderMode;
+                render::Renderer renderer { &volume, &gradient, &camera, config };
+                renderer.render(); // Builds the caches.
+                const auto start = std::chrono::high_resolution_clock::now();
+                renderer.render();
+                const std::chrono::duration<double, std::milli> renderTime = std::chrono::high_resolution_clock::now() - start;
+                std::cout << size << "^3, " << emptyFraction * 100.0f << "% empty, " << name << ": " << renderTime.count() << "ms" << std::endl;
+            }
+        }
+    }
+}
@@ -5,6 +5,7 @@
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
 
+#include "mesh/marching_cubes.h"
 #include "render/renderer.h"
 #include "ui/full_screen_texture_gl.h"
 #include "ui/menu.h"
@@ -12,8 +13,11 @@
 #include "ui/trackball.h"
 #include "ui/window.h"
 #include "ui/wireframe_cube.h"
+#include "util/trace.h"
+#include "volume/async_volume_loader.h"
 #include "volume/gradient_volume.h"
 #include "volume/volume.h"
+#include "volume/volume_sequence.h"
 #include <chrono>
 #include <cmath> // log2
 #include <glm/geometric.hpp>
@@ -21,6 +25,7 @@
 #include <glm/vec3.hpp>
 #include <imgui.h>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <ratio>
 #include <vector>
@@ -44,11 +49,21 @@ int main(int argc, char** argv)
     const float aspectRatio = static_cast<float>(viewportSize.x) / static_cast<float>(viewportSize.y);
     ui::Trackball trackballCamera { &myWindow, glm::radians(60.0f), aspectRatio };
 
-    // Render instance contains everything you need to render (volume + renderer). Initially there is
-    // nothing to render hence the optional (initially it is empty). The optional is passed to the menu
-    // class which is responsible for creating the volume + renderer when the user loads a volume.
-    std::optional<volume::Volume> optVolume;
-    std::optional<volume::GradientVolume> optGradientVolume;
+    // Volumes are loaded in the background by the volume loader (which owns the volume and gradient volume).
+    // The renderer is created as soon as the volume is available; the gradient volume is handed to it (and to
+    // the menu) when it has been computed. Initially there is nothing to render hence the empty optional.
+    std::unique_ptr<volume::AsyncVolumeLoader> pVolumeLoader;
+    // Selecting a directory loads all FLD files in it as a time series which is played back frame by frame.
+    std::unique_ptr<volume::VolumeSequence> pVolumeSequence;
+    std::shared_ptr<volume::Volume> pSequenceFrame;
+    std::shared_ptr<volume::GradientVolume> pSequenceGradientVolume;
+    size_t sequenceFrameIndex = 0;
+    std::chrono::steady_clock::time_point sequenceFrameTime;
+    // Whether the menu received the gradients of the sequence (for the 2D transfer function widget).
+    bool sequenceGradientsShown = false;
+    // The volume and gradient volume that are currently rendered (owned by the loader or the sequence).
+    volume::Volume* pVolume = nullptr;
+    volume::GradientVolume* pGradientVolume = nullptr;
     std::optional<render::Renderer> optRenderer;
     ui::Menu volVisMenu { viewportSize };
 
@@ -58,20 +73,142 @@ int main(int argc, char** argv)
     bool redrawUserInteraction = false;
     bool redrawFullResolution = true;
     auto loadVolume = [&](const std::filesystem::path& filePath) {
-        optVolume.emplace(filePath.string());
-        optVolume->interpolationMode = volVisMenu.interpolationMode();
-        optGradientVolume.emplace(optVolume.value());
-        optRenderer.emplace(&optVolume.value(), &optGradientVolume.value(), &trackballCamera, volVisMenu.renderConfig());
-
-        const float maxDimension = float(glm::compMax(optVolume->dims()));
-        trackballCamera.setDistance(maxDimension);
-        trackballCamera.setWorldScale(maxDimension);
-        trackballCamera.setLookAt(glm::vec3(optVolume->dims()) / 2.0f);
+        TRACE_SCOPE("loadVolume");
+        // The renderer refers to the volume owned by the previous loader/sequence so it must be destroyed first.
+        optRenderer.reset();
+        pVolume = nullptr;
+        pGradientVolume = nullptr;
+        pVolumeLoader.reset();
+        pSequenceFrame.reset();
+        pSequenceGradientVolume.reset();
+        pVolumeSequence.reset();
+        volVisMenu.setSequenceLength(0);
+
+        if (!std::filesystem::is_directory(filePath)) {
+            pVolumeLoader = std::make_unique<volume::AsyncVolumeLoader>(filePath, volVisMenu.voxelLayout(), volVisMenu.numaPlacement());
+            return;
+        }
 
-        volVisMenu.setLoadedVolume(optVolume.value(), optGradientVolume.value());
+        auto frameFiles = volume::VolumeSequence::findFrameFiles(filePath);
+        if (frameFiles.empty()) {
+            std::cerr << "No FLD files found in " << filePath << std::endl;
+            return;
+        }
+        volume::VolumeSequenceSettings sequenceSettings {};
+        sequenceSettings.deltaCompression = true;
+        pVolumeSequence = std::make_unique<volume::VolumeSequence>(std::move(frameFiles), sequenceSettings);
+        // The prefetcher starts with the first frame; updateSequencePlayback() picks it up once it is loaded.
+        sequenceFrameIndex = 0;
+        sequenceGradientsShown = false;
+    };
+    // Called every frame during sequence playback. Switches to the next time step (or the one selected in the
+    // menu) once it has been prefetched; if it is not ready yet the current frame stays on screen.
+    auto updateSequencePlayback = [&]() {
+        if (!pVolumeSequence)
+            return;
+
+        // Gradients are computed lazily: only prefetch them when the current render mode needs them (or the menu
+        // does not have any gradients yet).
+        const bool needGradients = render::requiresGradients(volVisMenu.renderConfig());
+        pVolumeSequence->setPrefetchGradients(needGradients || !sequenceGradientsShown);
+
+        // Like the asynchronous loader, show the first frame as soon as it has been loaded; the renderer shows a MIP
+        // preview until its gradients are available.
+        if (!optRenderer) {
+            pSequenceFrame = pVolumeSequence->tryFrame(0);
+            if (!pSequenceFrame)
+                return;
+            pVolume = pSequenceFrame.get();
+            pVolume->interpolationMode = volVisMenu.interpolationMode();
+            optRenderer.emplace(pVolume, nullptr, &trackballCamera, volVisMenu.renderConfig());
+
+            const float maxDimension = float(glm::compMax(pVolume->dims()));
+            trackballCamera.setDistance(maxDimension);
+            trackballCamera.setWorldScale(maxDimension);
+            trackballCamera.setLookAt(glm::vec3(pVolume->dims()) / 2.0f);
+
+            volVisMenu.setLoadedVolume(*pVolume);
+            volVisMenu.setSequenceLength(pVolumeSequence->numFrames());
+            sequenceFrameTime = std::chrono::steady_clock::now();
+            redrawUserInteraction = true;
+        }
+        if (!sequenceGradientsShown) {
+            if (auto pFrameGradientVolume = pVolumeSequence->tryGradientVolume(sequenceFrameIndex)) {
+                pFrameGradientVolume->interpolationMode = volVisMenu.interpolationMode();
+                optRenderer->setGradientVolume(pFrameGradientVolume.get());
+                pSequenceGradientVolume = std::move(pFrameGradientVolume);
+                pGradientVolume = pSequenceGradientVolume.get();
+                volVisMenu.setLoadedGradientVolume(*pVolume, *pGradientVolume);
+                sequenceGradientsShown = true;
+                redrawUserInteraction = true;
+            }
+        }
 
+        const auto now = std::chrono::steady_clock::now();
+        size_t targetFrameIndex = size_t(volVisMenu.sequenceFrame());
+        if (volVisMenu.isPlaying() && std::chrono::duration<float>(now - sequenceFrameTime).count() >= 1.0f / volVisMenu.playbackFps())
+            targetFrameIndex = (sequenceFrameIndex + 1) % pVolumeSequence->numFrames();
+        if (targetFrameIndex == sequenceFrameIndex && (!needGradients || pSequenceGradientVolume))
+            return;
+
+        pVolumeSequence->setPlayhead(targetFrameIndex);
+        auto pFrame = pVolumeSequence->tryFrame(targetFrameIndex);
+        auto pFrameGradientVolume = needGradients ? pVolumeSequence->tryGradientVolume(targetFrameIndex) : nullptr;
+        if (!pFrame || (needGradients && !pFrameGradientVolume))
+            return;
+
+        pFrame->interpolationMode = volVisMenu.interpolationMode();
+        if (pFrameGradientVolume)
+            pFrameGradientVolume->interpolationMode = volVisMenu.interpolationMode();
+        optRenderer->setVolume(pFrame.get(), pFrameGradientVolume.get());
+        pSequenceFrame = std::move(pFrame);
+        pSequenceGradientVolume = std::move(pFrameGradientVolume);
+        pVolume = pSequenceFrame.get();
+        pGradientVolume = pSequenceGradientVolume.get();
+
+        sequenceFrameIndex = targetFrameIndex;
+        sequenceFrameTime = now;
+        volVisMenu.setSequenceFrame(int(targetFrameIndex));
         redrawUserInteraction = true;
     };
+    // Called every frame while loading; picks up the volume and gradient volume once they become available.
+    auto pollVolumeLoader = [&]() {
+        if (!pVolumeLoader)
+            return;
+
+        const auto stage = pVolumeLoader->stage();
+        if (stage == volume::AsyncVolumeLoader::Stage::Failed) {
+            std::cerr << "Failed to load volume: " << pVolumeLoader->errorMessage() << std::endl;
+            pVolumeLoader.reset();
+            volVisMenu.clearLoadProgress();
+            return;
+        }
+        if (stage == volume::AsyncVolumeLoader::Stage::Done)
+            volVisMenu.clearLoadProgress();
+        else
+            volVisMenu.setLoadProgress(volume::stageName(stage), pVolumeLoader->progress());
+
+        if (!pVolume && pVolumeLoader->volume()) {
+            pVolume = pVolumeLoader->volume();
+            pVolume->interpolationMode = volVisMenu.interpolationMode();
+            optRenderer.emplace(pVolume, nullptr, &trackballCamera, volVisMenu.renderConfig());
+
+            const float maxDimension = float(glm::compMax(pVolume->dims()));
+            trackballCamera.setDistance(maxDimension);
+            trackballCamera.setWorldScale(maxDimension);
+            trackballCamera.setLookAt(glm::vec3(pVolume->dims()) / 2.0f);
+
+            volVisMenu.setLoadedVolume(*pVolume);
+            redrawUserInteraction = true;
+        }
+        if (!pGradientVolume && pVolumeLoader->gradientVolume()) {
+            pGradientVolume = pVolumeLoader->gradientVolume();
+            pGradientVolume->interpolationMode = volVisMenu.interpolationMode();
+            optRenderer->setGradientVolume(pGradientVolume);
+            volVisMenu.setLoadedGradientVolume(*pVolume, *pGradientVolume);
+            redrawUserInteraction = true;
+        }
+    };
 
     // Callbacks.
     volVisMenu.setLoadVolumeCallback(loadVolume);
@@ -83,12 +220,19 @@ int main(int argc, char** argv)
         });
     volVisMenu.setInterpolationModeChangedCallback(
         [&](volume::InterpolationMode interpolationMode) {
-            if (optVolume) {
-                optVolume->interpolationMode = interpolationMode;
-                optGradientVolume->interpolationMode = interpolationMode;
-            }
+            if (pVolume)
+                pVolume->interpolationMode = interpolationMode;
+            if (pGradientVolume)
+                pGradientVolume->interpolationMode = interpolationMode;
             redrawUserInteraction = true;
         });
+    volVisMenu.setExportIsoSurfaceCallback(
+        [&](const std::filesystem::path& filePath) {
+            if (!pVolume || !pGradientVolume)
+                return false;
+            const auto isoSurface = mesh::extractIsoSurface(*pVolume, *pGradientVolume, volVisMenu.renderConfig().isoValue);
+            return mesh::writeMesh(isoSurface, filePath);
+        });
     myWindow.registerWindowResizeCallback(
         [&](const glm::ivec2& newWindowSize) {
             // Maintain aspect ratio!
@@ -110,7 +254,10 @@ int main(int argc, char** argv)
     int prevResolutionScale = 1;
     std::chrono::duration<double> renderTime { 0 };
     while (!myWindow.shouldClose()) {
+        TRACE_SCOPE("frame");
         myWindow.updateInput();
+        pollVolumeLoader();
+        updateSequencePlayback();
 
         if (optRenderer.has_value()) {
             // If camera changed in any way then we need to redraw.
@@ -158,15 +305,15 @@ int main(int argc, char** argv)
                 const auto end = clock::now();
                 renderTime = end - start;
 
-                fullScreenTextureGL.update(optRenderer->frameBuffer(), volVisMenu.renderConfig().renderResolution);
+                fullScreenTextureGL.update(optRenderer->frameBufferBytes(), volVisMenu.renderConfig().renderResolution, optRenderer->frameBufferFormat());
             }
 
             // === Drawing the framebuffer to the screen and adding the wireframe. ===
 
             // Make the wireframe slightly larger than the volume to prevent z-fighting
             constexpr float wireframeMargin = 0.05f;
-            const auto wireframeCubeSize = glm::vec3(optVolume->dims()) * (1.0f + wireframeMargin);
-            const auto wireframeCubeOffset = -glm::vec3(optVolume->dims()) * wireframeMargin * 0.5f;
+            const auto wireframeCubeSize = glm::vec3(pVolume->dims()) * (1.0f + wireframeMargin);
+            const auto wireframeCubeOffset = -glm::vec3(pVolume->dims()) * wireframeMargin * 0.5f;
             constexpr glm::vec3 wireframeColor { 1.0f };
 
             // Draw on the left side of the screen next to the menu.
@@ -183,7 +330,7 @@ int main(int argc, char** argv)
             glDepthMask(GL_TRUE);
             glDepthFunc(GL_LEQUAL);
             glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-            surfaceCube.draw(trackballCamera, optVolume->dims());
+            surfaceCube.draw(trackballCamera, pVolume->dims());
 
             // Enable color writes and depth blending.
             glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
@@ -221,8 +368,12 @@ int main(int argc, char** argv)
         if (myWindow.isKeyPressed(GLFW_KEY_ESCAPE))
             break;
 
-        volVisMenu.drawMenu(glm::ivec2(windowSize.x - menuWidth, 0), glm::ivec2(menuWidth, windowSize.y), renderTime);
+        {
+            TRACE_SCOPE("Menu::drawMenu");
+            volVisMenu.drawMenu(glm::ivec2(windowSize.x - menuWidth, 0), glm::ivec2(menuWidth, windowSize.y), renderTime);
+        }
 
+        TRACE_SCOPE("Window::swapBuffers");
         myWindow.swapBuffers();
     }
 
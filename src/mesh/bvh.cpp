@@ -0,0 +1,150 @@
+#include "bvh.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <array>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <limits>
+#include <numeric>
+#include <tuple>
+
+namespace mesh {
+
+TriangleBVH::TriangleBVH(const TriangleMesh& mesh)
+{
+    TRACE_SCOPE("TriangleBVH::TriangleBVH");
+    const size_t numTriangles = mesh.triangles.size();
+    std::vector<glm::vec3> centroids(numTriangles);
+    std::vector<glm::vec3> lowers(numTriangles), uppers(numTriangles);
+    for (size_t i = 0; i < numTriangles; i++) {
+        const glm::uvec3& triangle = mesh.triangles[i];
+        const glm::vec3 &a = mesh.positions[triangle.x], &b = mesh.positions[triangle.y], &c = mesh.positions[triangle.z];
+        lowers[i] = glm::min(a, glm::min(b, c));
+        uppers[i] = glm::max(a, glm::max(b, c));
+        centroids[i] = (a + b + c) / 3.0f;
+    }
+    std::vector<uint32_t> order(numTriangles);
+    std::iota(std::begin(order), std::end(order), 0u);
+
+    // Build top down without recursion: (node, first, last) of the nodes that still have to be split.
+    m_nodes.push_back(Node { glm::vec3(0.0f), glm::vec3(0.0f), 0, uint32_t(numTriangles) });
+    std::vector<uint32_t> pending { 0 };
+    while (!pending.empty()) {
+        const uint32_t nodeIndex = pending.back();
+        pending.pop_back();
+        const uint32_t first = m_nodes[nodeIndex].first, count = m_nodes[nodeIndex].count;
+
+        glm::vec3 lower { std::numeric_limits<float>::max() }, upper { std::numeric_limits<float>::lowest() };
+        glm::vec3 centroidLower = lower, centroidUpper = upper;
+        for (uint32_t i = first; i < first + count; i++) {
+            lower = glm::min(lower, lowers[order[i]]);
+            upper = glm::max(upper, uppers[order[i]]);
+            centroidLower = glm::min(centroidLower, centroids[order[i]]);
+            centroidUpper = glm::max(centroidUpper, centroids[order[i]]);
+        }
+        m_nodes[nodeIndex].lower = lower;
+        m_nodes[nodeIndex].upper = upper;
+        if (count <= maxLeafSize)
+            continue;
+
+        const glm::vec3 extent = centroidUpper - centroidLower;
+        const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        const uint32_t middle = first + count / 2;
+        std::nth_element(std::begin(order) + first, std::begin(order) + middle, std::begin(order) + first + count,
+            [&](uint32_t lhs, uint32_t rhs) { return centroids[lhs][axis] < centroids[rhs][axis]; });
+
+        const uint32_t firstChild = uint32_t(m_nodes.size());
+        m_nodes.push_back(Node { glm::vec3(0.0f), glm::vec3(0.0f), first, middle - first });
+        m_nodes.push_back(Node { glm::vec3(0.0f), glm::vec3(0.0f), middle, first + count - middle });
+        m_nodes[nodeIndex].first = firstChild;
+        m_nodes[nodeIndex].count = 0;
+        pending.push_back(firstChild);
+        pending.push_back(firstChild + 1);
+    }
+
+    m_triangles.reserve(numTriangles);
+    for (const uint32_t i : order) {
+        const glm::uvec3& triangle = mesh.triangles[i];
+        const glm::vec3& v0 = mesh.positions[triangle.x];
+        m_triangles.push_back(Triangle {
+            v0, mesh.positions[triangle.y] - v0, mesh.positions[triangle.z] - v0,
+            mesh.normals[triangle.x], mesh.normals[triangle.y], mesh.normals[triangle.z] });
+    }
+}
+
+size_t TriangleBVH::numTriangles() const
+{
+    return m_triangles.size();
+}
+
+// Distance at which the ray enters the box, or infinity if it misses the box within [tmin, tmax].
+static float intersectBox(const render::Ray& ray, const glm::vec3& invDirection, const glm::vec3& lower, const glm::vec3& upper, float tmax)
+{
+    const glm::vec3 tLower = (lower - ray.origin) * invDirection;
+    const glm::vec3 tUpper = (upper - ray.origin) * invDirection;
+    const glm::vec3 tNear = glm::min(tLower, tUpper), tFar = glm::max(tLower, tUpper);
+    const float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, ray.tmin));
+    const float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tmax));
+    return tEnter <= tExit ? tEnter : std::numeric_limits<float>::infinity();
+}
+
+std::optional<TriangleBVH::Hit> TriangleBVH::intersect(const render::Ray& ray) const
+{
+    if (m_triangles.empty())
+        return {};
+
+    const glm::vec3 invDirection = 1.0f / ray.direction;
+    float tClosest = ray.tmax;
+    std::optional<Hit> closestHit;
+
+    // Visit the nearer child first so that the farther one can often be culled by the closest hit.
+    std::array<uint32_t, 64> stack;
+    size_t stackSize = 0;
+    if (intersectBox(ray, invDirection, m_nodes[0].lower, m_nodes[0].upper, tClosest) < std::numeric_limits<float>::infinity())
+        stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if (node.count == 0) {
+            const Node &left = m_nodes[node.first], &right = m_nodes[node.first + 1];
+            float tLeft = intersectBox(ray, invDirection, left.lower, left.upper, tClosest);
+            float tRight = intersectBox(ray, invDirection, right.lower, right.upper, tClosest);
+            uint32_t nearChild = node.first, farChild = node.first + 1;
+            if (tRight < tLeft) {
+                std::swap(tLeft, tRight);
+                std::swap(nearChild, farChild);
+            }
+            if (tRight < std::numeric_limits<float>::infinity())
+                stack[stackSize++] = farChild;
+            if (tLeft < std::numeric_limits<float>::infinity())
+                stack[stackSize++] = nearChild;
+            continue;
+        }
+
+        // Moller-Trumbore ray/triangle intersection (two sided).
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            const Triangle& triangle = m_triangles[i];
+            const glm::vec3 p = glm::cross(ray.direction, triangle.edge2);
+            const float determinant = glm::dot(triangle.edge1, p);
+            if (determinant == 0.0f)
+                continue;
+            const float invDeterminant = 1.0f / determinant;
+            const glm::vec3 s = ray.origin - triangle.v0;
+            const float u = glm::dot(s, p) * invDeterminant;
+            if (u < 0.0f || u > 1.0f)
+                continue;
+            const glm::vec3 q = glm::cross(s, triangle.edge1);
+            const float v = glm::dot(ray.direction, q) * invDeterminant;
+            if (v < 0.0f || u + v > 1.0f)
+                continue;
+            const float t = glm::dot(triangle.edge2, q) * invDeterminant;
+            if (t < ray.tmin || t > tClosest)
+                continue;
+
+            tClosest = t;
+            closestHit = Hit { t, (1.0f - u - v) * triangle.n0 + u * triangle.n1 + v * triangle.n2 };
+        }
+    }
+    return closestHit;
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "mesh/triangle_mesh.h"
+#include "render/ray.h"
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <optional>
+#include <vector>
+
+namespace mesh {
+
+// Bounding volume hierarchy over the triangles of a mesh for CPU ray tracing. Nodes are split at the median
+// centroid along their longest axis; leaves hold up to maxLeafSize triangles. The BVH keeps its own copy of the
+// triangle data (in leaf order) so the mesh may be destroyed after building.
+class TriangleBVH {
+public:
+    explicit TriangleBVH(const TriangleMesh& mesh);
+
+    struct Hit {
+        float t;
+        glm::vec3 normal; // Interpolated vertex normal (not normalized).
+    };
+    // Closest intersection with t in [ray.tmin, ray.tmax].
+    std::optional<Hit> intersect(const render::Ray& ray) const;
+
+    size_t numTriangles() const;
+
+private:
+    struct Node {
+        glm::vec3 lower;
+        glm::vec3 upper;
+        // Leaf: first triangle and number of triangles. Inner node: index of the first child (the second child
+        // directly follows it) and a count of 0.
+        uint32_t first;
+        uint32_t count;
+    };
+    struct Triangle {
+        glm::vec3 v0, edge1, edge2; // Precomputed for the Moller-Trumbore intersection test.
+        glm::vec3 n0, n1, n2;
+    };
+
+    static constexpr uint32_t maxLeafSize = 4;
+
+    std::vector<Node> m_nodes;
+    std::vector<Triangle> m_triangles;
+};
+
+}
@@ -0,0 +1,239 @@
+#include "marching_cubes.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <glm/geometric.hpp>
+#include <limits>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <unordered_map>
+#include <vector>
+
+namespace mesh {
+
+// Corner i of a cell lies at offset (i & 1, (i >> 1) & 1, (i >> 2) & 1).
+static glm::ivec3 cornerOffset(int corner)
+{
+    return glm::ivec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+}
+
+struct CellEdge {
+    int corner0, corner1; // corner0 is the lower end of the edge.
+    int axis;
+};
+
+// Edges 4 * axis + k connect corner (k spread over the other two axes) to the corner one step along axis.
+static const std::array<CellEdge, 12> cellEdges = []() {
+    std::array<CellEdge, 12> edges;
+    for (int axis = 0, i = 0; axis < 3; axis++) {
+        for (int corner = 0; corner < 8; corner++) {
+            if (!(corner & (1 << axis)))
+                edges[size_t(i++)] = CellEdge { corner, corner | (1 << axis), axis };
+        }
+    }
+    return edges;
+}();
+
+struct MarchingCubesCase {
+    int numTriangles;
+    std::array<std::array<uint8_t, 3>, 10> triangles; // Edge indices.
+};
+
+// Build the triangulation of each of the 256 cases instead of hard coding the classic tables. Per cell face the
+// crossed edges are connected by segments, choosing the pairing that separates the corners above the iso value on
+// ambiguous faces (two diagonal corners above). The choice only depends on the face, so neighbouring cells agree
+// and the surface has no cracks. The segments are oriented consistently (entering the region above the iso value
+// towards leaving it, walking counter clockwise around the face seen from outside the cell) which chains them into
+// closed loops around the cell; each loop is triangulated as a fan.
+static std::array<MarchingCubesCase, 256> buildCaseTable()
+{
+    const auto findEdge = [](int cornerA, int cornerB) {
+        for (size_t i = 0; i < cellEdges.size(); i++) {
+            const CellEdge& edge = cellEdges[i];
+            if ((edge.corner0 == cornerA && edge.corner1 == cornerB) || (edge.corner0 == cornerB && edge.corner1 == cornerA))
+                return int(i);
+        }
+        return -1;
+    };
+
+    // Corners of each face in counter clockwise order when seen from outside of the cell.
+    std::array<std::array<int, 4>, 6> faces;
+    for (int axis = 0; axis < 3; axis++) {
+        const int u = 1 << ((axis + 1) % 3), v = 1 << ((axis + 2) % 3), w = 1 << axis;
+        faces[size_t(2 * axis)] = { 0, v, u | v, u }; // Normal -axis.
+        faces[size_t(2 * axis + 1)] = { w, w | u, w | u | v, w | v }; // Normal +axis.
+    }
+
+    std::array<MarchingCubesCase, 256> table {};
+    for (int caseIndex = 0; caseIndex < 256; caseIndex++) {
+        const auto above = [&](int corner) { return (caseIndex >> corner) & 1; };
+
+        std::array<int, 12> next;
+        next.fill(-1);
+        for (const auto& face : faces) {
+            // Edge k of the face connects corner k to corner k + 1.
+            for (int k = 0; k < 4; k++) {
+                if (!above(face[size_t(k)]) || above(face[size_t((k + 1) % 4)]))
+                    continue;
+                // Edge k leaves the region above the iso value; connect it to the closest preceding edge that enters it.
+                int j = (k + 3) % 4;
+                while (above(face[size_t(j)]))
+                    j = (j + 3) % 4;
+                const int enter = findEdge(face[size_t(j)], face[size_t((j + 1) % 4)]);
+                const int exit = findEdge(face[size_t(k)], face[size_t((k + 1) % 4)]);
+                next[size_t(enter)] = exit;
+            }
+        }
+
+        MarchingCubesCase& cellCase = table[size_t(caseIndex)];
+        std::array<bool, 12> visited {};
+        for (int start = 0; start < 12; start++) {
+            if (next[size_t(start)] < 0 || visited[size_t(start)])
+                continue;
+            std::vector<int> loop;
+            for (int edge = start; !visited[size_t(edge)]; edge = next[size_t(edge)]) {
+                visited[size_t(edge)] = true;
+                loop.push_back(edge);
+            }
+            for (size_t i = 1; i + 1 < loop.size(); i++)
+                cellCase.triangles[size_t(cellCase.numTriangles++)] = { uint8_t(loop[0]), uint8_t(loop[i]), uint8_t(loop[i + 1]) };
+        }
+    }
+    return table;
+}
+
+TriangleMesh extractIsoSurface(const volume::Volume& volume, const volume::GradientVolume& gradientVolume, float isoValue)
+{
+    return extractIsoSurface(volume, gradientVolume, volume::BrickMinMax(volume), isoValue);
+}
+
+TriangleMesh extractIsoSurface(const volume::Volume& volume, const volume::GradientVolume& gradientVolume, const volume::BrickMinMax& bricks, float isoValue)
+{
+    TRACE_SCOPE("extractIsoSurface");
+    static const std::array<MarchingCubesCase, 256> caseTable = buildCaseTable();
+
+    const glm::ivec3 dim = volume.dims();
+    const glm::ivec3 numCells = dim - 1;
+    if (glm::any(glm::lessThan(numCells, glm::ivec3(1))))
+        return {};
+
+    // Each slab covers one layer of bricks. A slab owns the vertices on the edges whose lower end lies in one of its
+    // cell layers; the vertices on its top plane belong to the next slab (unless this is the last slab).
+    const int slabSize = bricks.brickSize();
+    const int numSlabs = (numCells.z + slabSize - 1) / slabSize;
+    const auto edgeKey = [&](const glm::ivec3& voxel, int axis) {
+        return (uint64_t(voxel.x) + uint64_t(dim.x) * (uint64_t(voxel.y) + uint64_t(dim.y) * uint64_t(voxel.z))) * 3 + uint64_t(axis);
+    };
+    const auto ownerSlab = [&](int z) { return std::min(z / slabSize, numSlabs - 1); };
+
+    struct Slab {
+        std::unordered_map<uint64_t, uint32_t> edgeVertices; // Key: edgeKey(lower voxel, axis).
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<uint32_t> indices; // Three per triangle, local to the slab or unresolved (foreignIndex).
+        std::vector<std::pair<size_t, uint64_t>> foreignVertices; // (Position in indices, edge key in next slab).
+    };
+    static constexpr uint32_t foreignIndex = std::numeric_limits<uint32_t>::max();
+    std::vector<Slab> slabs(static_cast<size_t>(numSlabs));
+
+    tbb::parallel_for(tbb::blocked_range<int>(0, numSlabs, 1), [&](const tbb::blocked_range<int>& range) {
+        TRACE_SCOPE("extractIsoSurface::slab");
+        for (int slabIndex = range.begin(); slabIndex != range.end(); slabIndex++) {
+            Slab& slab = slabs[size_t(slabIndex)];
+
+            const auto createVertex = [&](const glm::ivec3& voxel, const CellEdge& edge, float value0, float value1) {
+                const glm::ivec3 voxel1 = voxel + cornerOffset(edge.corner1) - cornerOffset(edge.corner0);
+                const float t = (isoValue - value0) / (value1 - value0);
+                glm::vec3 position = glm::vec3(voxel);
+                position[edge.axis] += t;
+
+                // Interpolate the gradients of the end points; the normal points towards lower values.
+                const glm::vec3 gradient = glm::mix(gradientVolume.getGradient(voxel.x, voxel.y, voxel.z).dir, gradientVolume.getGradient(voxel1.x, voxel1.y, voxel1.z).dir, t);
+                glm::vec3 normal { 0.0f };
+                if (glm::dot(gradient, gradient) > 0.0f)
+                    normal = -glm::normalize(gradient);
+                else
+                    normal[edge.axis] = value1 > value0 ? -1.0f : 1.0f;
+
+                slab.positions.push_back(position);
+                slab.normals.push_back(normal);
+                return uint32_t(slab.positions.size() - 1);
+            };
+
+            const glm::ivec3 brickDims = bricks.dims();
+            for (int by = 0; by < brickDims.y; by++) {
+                for (int bx = 0; bx < brickDims.x; bx++) {
+                    const glm::ivec3 brick { bx, by, slabIndex };
+                    const glm::vec2 brickRange = bricks.range(bricks.brickIndex(brick));
+                    if (brickRange.y < isoValue || brickRange.x >= isoValue)
+                        continue;
+
+                    const glm::ivec3 begin = brick * slabSize;
+                    const glm::ivec3 end = glm::min(begin + slabSize, numCells);
+                    for (int z = begin.z; z < end.z; z++) {
+                        for (int y = begin.y; y < end.y; y++) {
+                            for (int x = begin.x; x < end.x; x++) {
+                                std::array<float, 8> values;
+                                int caseIndex = 0;
+                                for (int corner = 0; corner < 8; corner++) {
+                                    const glm::ivec3 voxel = glm::ivec3(x, y, z) + cornerOffset(corner);
+                                    values[size_t(corner)] = volume.getVoxel(voxel.x, voxel.y, voxel.z);
+                                    if (values[size_t(corner)] >= isoValue)
+                                        caseIndex |= 1 << corner;
+                                }
+
+                                const MarchingCubesCase& cellCase = caseTable[size_t(caseIndex)];
+                                for (int i = 0; i < cellCase.numTriangles; i++) {
+                                    for (const uint8_t edgeIndex : cellCase.triangles[size_t(i)]) {
+                                        const CellEdge& edge = cellEdges[edgeIndex];
+                                        const glm::ivec3 voxel = glm::ivec3(x, y, z) + cornerOffset(edge.corner0);
+                                        const uint64_t key = edgeKey(voxel, edge.axis);
+                                        if (ownerSlab(voxel.z) != slabIndex) {
+                                            slab.foreignVertices.emplace_back(slab.indices.size(), key);
+                                            slab.indices.push_back(foreignIndex);
+                                            continue;
+                                        }
+                                        auto [iter, inserted] = slab.edgeVertices.try_emplace(key, 0);
+                                        if (inserted)
+                                            iter->second = createVertex(voxel, edge, values[size_t(edge.corner0)], values[size_t(edge.corner1)]);
+                                        slab.indices.push_back(iter->second);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    // Concatenate the slabs, resolving the vertices that are owned by the next slab.
+    std::vector<size_t> vertexOffsets(slabs.size() + 1, 0), triangleOffsets(slabs.size() + 1, 0);
+    for (size_t i = 0; i < slabs.size(); i++) {
+        vertexOffsets[i + 1] = vertexOffsets[i] + slabs[i].positions.size();
+        triangleOffsets[i + 1] = triangleOffsets[i] + slabs[i].indices.size() / 3;
+    }
+    TriangleMesh mesh;
+    mesh.positions.resize(vertexOffsets.back());
+    mesh.normals.resize(vertexOffsets.back());
+    mesh.triangles.resize(triangleOffsets.back());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, slabs.size(), 1), [&](const tbb::blocked_range<size_t>& range) {
+        for (size_t slabIndex = range.begin(); slabIndex != range.end(); slabIndex++) {
+            Slab& slab = slabs[slabIndex];
+            const uint32_t vertexOffset = uint32_t(vertexOffsets[slabIndex]);
+            for (uint32_t& index : slab.indices)
+                index += vertexOffset;
+            for (const auto& [position, key] : slab.foreignVertices)
+                slab.indices[position] = uint32_t(vertexOffsets[slabIndex + 1]) + slabs[slabIndex + 1].edgeVertices.at(key);
+
+            std::copy(std::begin(slab.positions), std::end(slab.positions), std::begin(mesh.positions) + std::ptrdiff_t(vertexOffsets[slabIndex]));
+            std::copy(std::begin(slab.normals), std::end(slab.normals), std::begin(mesh.normals) + std::ptrdiff_t(vertexOffsets[slabIndex]));
+            for (size_t i = 0; i < slab.indices.size() / 3; i++)
+                mesh.triangles[triangleOffsets[slabIndex] + i] = glm::uvec3(slab.indices[3 * i], slab.indices[3 * i + 1], slab.indices[3 * i + 2]);
+        }
+    });
+    return mesh;
+}
+
+}
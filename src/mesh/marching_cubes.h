@@ -0,0 +1,19 @@
+#pragma once
+#include "mesh/triangle_mesh.h"
+#include "volume/brick_min_max.h"
+#include "volume/gradient_volume.h"
+#include "volume/volume.h"
+
+namespace mesh {
+
+// Extract the iso surface (the boundary of the region where the value is at least isoValue) with marching
+// cubes. The surface matches trilinear interpolation on the edges of the voxel grid. Normals are taken from the
+// gradient volume and point towards lower values (out of the region above the iso value).
+//
+// The volume is processed in parallel slabs of one brick thick; bricks whose value range does not contain the
+// iso value are skipped. Vertices are shared between triangles: each slab deduplicates the vertices on the edges
+// that it owns with a hash map and the triangles that cross into the next slab look their vertices up there.
+TriangleMesh extractIsoSurface(const volume::Volume& volume, const volume::GradientVolume& gradientVolume, const volume::BrickMinMax& bricks, float isoValue);
+TriangleMesh extractIsoSurface(const volume::Volume& volume, const volume::GradientVolume& gradientVolume, float isoValue);
+
+}
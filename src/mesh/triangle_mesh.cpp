@@ -0,0 +1,79 @@
+#include "triangle_mesh.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace mesh {
+
+static_assert(std::endian::native == std::endian::little, "The PLY writer assumes a little endian platform");
+
+template <typename T>
+static void writeBinary(std::ofstream& file, const T& value)
+{
+    std::array<char, sizeof(T)> bytes;
+    std::memcpy(bytes.data(), &value, sizeof(T));
+    file.write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+bool writePLY(const TriangleMesh& mesh, const std::filesystem::path& filePath)
+{
+    TRACE_SCOPE("writePLY");
+    std::ofstream file { filePath, std::ios::binary };
+    if (!file.is_open())
+        return false;
+
+    file << "ply\nformat binary_little_endian 1.0\n"
+         << fmt::format("element vertex {}\n", mesh.positions.size())
+         << "property float x\nproperty float y\nproperty float z\n"
+         << "property float nx\nproperty float ny\nproperty float nz\n"
+         << fmt::format("element face {}\n", mesh.triangles.size())
+         << "property list uchar uint vertex_indices\nend_header\n";
+    for (size_t i = 0; i < mesh.positions.size(); i++) {
+        writeBinary(file, mesh.positions[i]);
+        writeBinary(file, mesh.normals[i]);
+    }
+    for (const glm::uvec3& triangle : mesh.triangles) {
+        writeBinary(file, uint8_t(3));
+        writeBinary(file, triangle);
+    }
+    return file.good();
+}
+
+bool writeOBJ(const TriangleMesh& mesh, const std::filesystem::path& filePath)
+{
+    TRACE_SCOPE("writeOBJ");
+    std::ofstream file { filePath };
+    if (!file.is_open())
+        return false;
+
+    fmt::memory_buffer buffer;
+    for (const glm::vec3& position : mesh.positions)
+        fmt::format_to(std::back_inserter(buffer), "v {} {} {}\n", position.x, position.y, position.z);
+    for (const glm::vec3& normal : mesh.normals)
+        fmt::format_to(std::back_inserter(buffer), "vn {} {} {}\n", normal.x, normal.y, normal.z);
+    // OBJ indices start at 1.
+    for (const glm::uvec3& triangle : mesh.triangles)
+        fmt::format_to(std::back_inserter(buffer), "f {0}//{0} {1}//{1} {2}//{2}\n", triangle.x + 1, triangle.y + 1, triangle.z + 1);
+    file.write(buffer.data(), std::streamsize(buffer.size()));
+    return file.good();
+}
+
+bool writeMesh(const TriangleMesh& mesh, const std::filesystem::path& filePath)
+{
+    std::string extension = filePath.extension().string();
+    std::transform(std::begin(extension), std::end(extension), std::begin(extension), [](char c) { return char(std::tolower(c)); });
+    if (extension == ".ply")
+        return writePLY(mesh, filePath);
+    if (extension == ".obj")
+        return writeOBJ(mesh, filePath);
+    return false;
+}
+
+}
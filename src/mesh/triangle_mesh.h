@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <glm/vec3.hpp>
+#include <vector>
+
+namespace mesh {
+
+// Indexed triangle mesh in voxel coordinates. Every vertex has a unit normal; triangles are wound counter
+// clockwise when looking at the side that the normals point to.
+struct TriangleMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::uvec3> triangles;
+};
+
+// Write the mesh as binary little endian PLY (positions, normals and faces). Returns false on failure.
+bool writePLY(const TriangleMesh& mesh, const std::filesystem::path& filePath);
+// Write the mesh as Wavefront OBJ (v, vn and f v//vn lines). Returns false on failure.
+bool writeOBJ(const TriangleMesh& mesh, const std::filesystem::path& filePath);
+// Write as PLY or OBJ depending on the file extension (.ply or .obj).
+bool writeMesh(const TriangleMesh& mesh, const std::filesystem::path& filePath);
+
+}
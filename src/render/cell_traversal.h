@@ -0,0 +1,112 @@
+#pragma once
+#include "render/ray.h"
+#include "volume/voxel_layout.h"
+#include <algorithm>
+#include <cstddef>
+#include <glm/common.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vector_relational.hpp>
+#include <limits>
+
+namespace render {
+
+// Visits the unit cells of a grid that a ray passes through in order (Amanatides and Woo, "A Fast Voxel Traversal
+// Algorithm for Ray Tracing"). Cell c covers the positions [c - cellOffset, c + 1 - cellOffset) along each axis:
+// an offset of 0 visits the cells in between the voxels (trilinear interpolation) and an offset of 0.5 visits the
+// regions that are closest to each voxel (nearest neighbour interpolation).
+//
+// Usage:
+//   for (CellTraversal cells { ray, t0, t1, 0.0f }; !cells.done(); cells.next())
+//       visit(cells.cell(), cells.tEnter(), cells.tExit());
+class CellTraversal {
+public:
+    CellTraversal(const Ray& ray, float tBegin, float tEnd, float cellOffset)
+        : m_t(tBegin)
+        , m_tEnd(tEnd)
+    {
+        const glm::vec3 position = ray.origin + tBegin * ray.direction + cellOffset;
+        m_cell = glm::ivec3(glm::floor(position));
+        for (int axis = 0; axis < 3; axis++) {
+            if (ray.direction[axis] > 0.0f) {
+                m_step[axis] = 1;
+                m_tDelta[axis] = 1.0f / ray.direction[axis];
+                m_tNext[axis] = tBegin + (float(m_cell[axis] + 1) - position[axis]) * m_tDelta[axis];
+            } else if (ray.direction[axis] < 0.0f) {
+                m_step[axis] = -1;
+                m_tDelta[axis] = -1.0f / ray.direction[axis];
+                m_tNext[axis] = tBegin + (position[axis] - float(m_cell[axis])) * m_tDelta[axis];
+            } else {
+                m_step[axis] = 0;
+                m_tDelta[axis] = m_tNext[axis] = std::numeric_limits<float>::infinity();
+            }
+        }
+    }
+
+    bool done() const { return m_t > m_tEnd; }
+    const glm::ivec3& cell() const { return m_cell; }
+    float tEnter() const { return m_t; }
+    float tExit() const { return std::min(std::min(m_tNext.x, m_tNext.y), std::min(m_tNext.z, m_tEnd)); }
+
+    // Returns the axis along which the traversal stepped to the next cell.
+    int next()
+    {
+        const int axis = m_tNext.x < m_tNext.y ? (m_tNext.x < m_tNext.z ? 0 : 2) : (m_tNext.y < m_tNext.z ? 1 : 2);
+        m_t = m_tNext[axis];
+        m_cell[axis] += m_step[axis];
+        m_tNext[axis] += m_tDelta[axis];
+        return axis;
+    }
+    const glm::ivec3& step() const { return m_step; }
+
+private:
+    float m_t;
+    float m_tEnd;
+    glm::ivec3 m_cell;
+    glm::ivec3 m_step;
+    glm::vec3 m_tDelta;
+    glm::vec3 m_tNext;
+};
+
+// Visits the voxels whose nearest neighbour regions a ray passes through in order, each of them once. The storage
+// index of the current voxel is updated incrementally (see VoxelIndexer::step) so the voxels can be read without
+// rounding positions, computing indices or checking bounds. The ray is expected to be clipped to the volume; the
+// traversal ends where it leaves the grid.
+//
+// Usage:
+//   for (VoxelTraversal voxels { ray, t0, t1, volume.dims(), volume.indexer() }; !voxels.done(); voxels.next())
+//       visit(data[voxels.index()], voxels.tEnter(), voxels.tExit());
+class VoxelTraversal {
+public:
+    VoxelTraversal(const Ray& ray, float tBegin, float tEnd, const glm::ivec3& dim, const volume::VoxelIndexer& indexer)
+        : m_cells(ray, tBegin, tEnd, 0.5f)
+        , m_dim(dim)
+        , m_pIndexer(&indexer)
+        , m_inside(glm::all(glm::greaterThanEqual(m_cells.cell(), glm::ivec3(0))) && glm::all(glm::lessThan(m_cells.cell(), dim)))
+        , m_index(m_inside ? indexer(m_cells.cell().x, m_cells.cell().y, m_cells.cell().z) : 0)
+    {
+    }
+
+    bool done() const { return !m_inside || m_cells.done(); }
+    const glm::ivec3& voxel() const { return m_cells.cell(); }
+    size_t index() const { return m_index; }
+    float tEnter() const { return m_cells.tEnter(); }
+    float tExit() const { return m_cells.tExit(); }
+
+    void next()
+    {
+        const int axis = m_cells.next();
+        const int coordinate = m_cells.cell()[axis];
+        m_inside = coordinate >= 0 && coordinate < m_dim[axis];
+        if (m_inside)
+            m_index = m_pIndexer->step(m_index, axis, m_cells.step()[axis]);
+    }
+
+private:
+    CellTraversal m_cells;
+    glm::ivec3 m_dim;
+    const volume::VoxelIndexer* m_pIndexer;
+    bool m_inside;
+    size_t m_index;
+};
+
+}
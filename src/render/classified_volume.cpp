@@ -0,0 +1,74 @@
+#include "classified_volume.h"
+#include "render/shading.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <glm/common.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace render {
+
+ClassifiedVolume::ClassifiedVolume(const volume::Volume& volume, const volume::GradientVolume* pGradientVolume, const TransferFunction1DTable& tfTable)
+    : m_dim(volume.dims())
+    , m_indexer(volume.indexer())
+    , m_voxels(volume.storageSize(), ClassifiedVoxel { glm::u8vec4(0), 0 })
+{
+    TRACE_SCOPE("ClassifiedVolume::ClassifiedVolume");
+    volume.visit([&](const auto& voxels) {
+        tbb::parallel_for(tbb::blocked_range<int>(0, m_dim.z), [&](const tbb::blocked_range<int>& range) {
+            for (int z = range.begin(); z != range.end(); z++) {
+                for (int y = 0; y < m_dim.y; y++) {
+                    for (int x = 0; x < m_dim.x; x++) {
+                        const glm::vec4 color = glm::clamp(tfTable.lookup(voxels.voxel(x, y, z)), 0.0f, 1.0f);
+                        const uint32_t normal = pGradientVolume ? packNormal(pGradientVolume->getGradient(x, y, z).dir) : 0;
+                        m_voxels[m_indexer(x, y, z)] = ClassifiedVoxel { glm::u8vec4(color * 255.0f + 0.5f), normal };
+                    }
+                }
+            }
+        });
+    });
+}
+
+const ClassifiedVoxel& ClassifiedVolume::voxel(int x, int y, int z) const
+{
+    return m_voxels[m_indexer(x, y, z)];
+}
+
+// Same rounding and bounds as VoxelGrid::sampleNearestNeighbour.
+ClassifiedVolume::Sample ClassifiedVolume::sampleNearestNeighbour(const glm::vec3& coord) const
+{
+    const glm::vec3 shifted = coord + 0.5f;
+    if (shifted.x < 0.0f || shifted.y < 0.0f || shifted.z < 0.0f || shifted.x >= static_cast<float>(m_dim.x) || shifted.y >= static_cast<float>(m_dim.y) || shifted.z >= static_cast<float>(m_dim.z))
+        return {};
+
+    const ClassifiedVoxel& classified = voxel(static_cast<int>(shifted.x), static_cast<int>(shifted.y), static_cast<int>(shifted.z));
+    return Sample { glm::vec4(classified.color) / 255.0f, unpackNormal(classified.normal) };
+}
+
+// Same bounds as VoxelGrid::sampleTriLinear.
+ClassifiedVolume::Sample ClassifiedVolume::sampleTriLinear(const glm::vec3& coord) const
+{
+    if (coord.x < 0.0f || coord.y < 0.0f || coord.z < 0.0f || coord.x >= static_cast<float>(m_dim.x) || coord.y >= static_cast<float>(m_dim.y) || coord.z >= static_cast<float>(m_dim.z))
+        return {};
+
+    const glm::ivec3 lower { coord };
+    const glm::ivec3 upper = glm::min(lower + 1, m_dim - 1);
+    const glm::vec3 fraction = coord - glm::vec3(lower);
+    Sample sample {};
+    for (int corner = 0; corner < 8; corner++) {
+        float weight = 1.0f;
+        glm::ivec3 position;
+        for (int axis = 0; axis < 3; axis++) {
+            const bool isUpper = (corner >> axis) & 1;
+            position[axis] = isUpper ? upper[axis] : lower[axis];
+            weight *= isUpper ? fraction[axis] : 1.0f - fraction[axis];
+        }
+        const ClassifiedVoxel& classified = voxel(position.x, position.y, position.z);
+        sample.color += weight * glm::vec4(classified.color);
+        sample.normal += weight * unpackNormal(classified.normal);
+    }
+    sample.color /= 255.0f;
+    return sample;
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "render/transfer_function_1d.h"
+#include "volume/gradient_volume.h"
+#include "volume/volume.h"
+#include "volume/voxel_layout.h"
+#include <cstdint>
+#include <glm/gtc/type_precision.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+namespace render {
+
+// A voxel after classification: the entry of the 1D transfer function (premultiplied and opacity corrected, see
+// TransferFunction1DTable) and the gradient direction packed as three 10-bit signed normalized integers (see packNormal).
+struct ClassifiedVoxel {
+    glm::u8vec4 color;
+    uint32_t normal;
+};
+
+// The 1D transfer function applied to every voxel of a volume ahead of time (pre-classification). While the
+// transfer function does not change, compositing then fetches a single 8 byte voxel per sample instead of the
+// value, its table entry and the gradient. Samples in between voxels interpolate the classified colors, which
+// is slightly blurrier than classifying the interpolated value.
+class ClassifiedVolume {
+public:
+    // Without a gradient volume all normals are zero (only usable without shading).
+    ClassifiedVolume(const volume::Volume& volume, const volume::GradientVolume* pGradientVolume, const TransferFunction1DTable& tfTable);
+
+    struct Sample {
+        glm::vec4 color { 0.0f };
+        glm::vec3 normal { 0.0f }; // Not normalized.
+    };
+    Sample sampleNearestNeighbour(const glm::vec3& coord) const;
+    Sample sampleTriLinear(const glm::vec3& coord) const;
+
+private:
+    const ClassifiedVoxel& voxel(int x, int y, int z) const;
+
+    glm::ivec3 m_dim;
+    volume::VoxelIndexer m_indexer; // Same layout as the volume.
+    std::vector<ClassifiedVoxel> m_voxels;
+};
+
+}
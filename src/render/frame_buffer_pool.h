@@ -0,0 +1,56 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+// Keeps the framebuffers of recently used resolutions. The dynamic resolution scaling of the viewer switches
+// between a few resolutions while the user interacts; with the pool those switches reuse earlier buffers instead
+// of going to the heap. At most capacity buffers are kept, the least recently used one is recycled first.
+template <typename Pixel>
+class FrameBufferPool {
+public:
+    explicit FrameBufferPool(size_t capacity = 4)
+        : m_capacity(capacity)
+    {
+        m_entries.reserve(capacity + 1);
+    }
+
+    // Swap buffer (which holds an image of the current resolution, or is empty) for a buffer of the new resolution
+    // that is filled with black pixels.
+    void exchange(std::vector<Pixel>& buffer, const glm::ivec2& currentResolution, const glm::ivec2& resolution)
+    {
+        if (!buffer.empty())
+            m_entries.push_back(Entry { currentResolution, std::move(buffer), m_useCounter });
+
+        // Prefer a buffer of the same resolution; otherwise recycle the storage of the least recently used one.
+        auto iter = std::find_if(std::begin(m_entries), std::end(m_entries), [&](const Entry& entry) { return entry.resolution == resolution; });
+        if (iter == std::end(m_entries) && m_entries.size() > m_capacity)
+            iter = std::min_element(std::begin(m_entries), std::end(m_entries), [](const Entry& lhs, const Entry& rhs) { return lhs.lastUse < rhs.lastUse; });
+        if (iter != std::end(m_entries)) {
+            buffer = std::move(iter->buffer);
+            m_entries.erase(iter);
+        }
+        buffer.assign(size_t(resolution.x) * size_t(resolution.y), Pixel(0));
+        m_useCounter++;
+    }
+
+    // Free all buffers.
+    void clear() { m_entries.clear(); }
+
+private:
+    struct Entry {
+        glm::ivec2 resolution;
+        std::vector<Pixel> buffer;
+        uint64_t lastUse;
+    };
+
+    size_t m_capacity;
+    std::vector<Entry> m_entries;
+    uint64_t m_useCounter { 0 };
+};
+
+}
@@ -0,0 +1,138 @@
+#include "mpr.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <iterator>
+#include <limits>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace render {
+
+SlicePlane slicePlane(const volume::Volume& volume, const RenderConfig& config, const RayTraceCamera& camera)
+{
+    const glm::vec3 dim = glm::vec3(volume.dims());
+    const glm::vec2 resolution = glm::vec2(config.renderResolution);
+
+    if (config.sliceOrientation == SliceOrientation::Camera) {
+        const glm::vec3 normal = -glm::normalize(camera.forward());
+        const glm::vec3 center = dim / 2.0f + (config.slicePosition - 0.5f) * glm::length(dim) * normal;
+        // A plane parallel to the image plane is sampled on a regular grid by the rays of the pixels.
+        const auto intersect = [&](const glm::vec2& pixel) {
+            const Ray ray = camera.generateRay(pixel / resolution * 2.0f - 1.0f);
+            return ray.origin + ray.direction * (glm::dot(center - ray.origin, normal) / glm::dot(ray.direction, normal));
+        };
+        const glm::vec3 origin = intersect(glm::vec2(0.0f));
+        return SlicePlane {
+            origin,
+            (intersect(glm::vec2(resolution.x, 0.0f)) - origin) / resolution.x,
+            (intersect(glm::vec2(0.0f, resolution.y)) - origin) / resolution.y,
+            normal
+        };
+    }
+
+    // Axes of the plane (u, v) and of its normal.
+    glm::ivec2 axes { 0, 1 };
+    int normalAxis = 2;
+    if (config.sliceOrientation == SliceOrientation::Coronal) {
+        axes = glm::ivec2(0, 2);
+        normalAxis = 1;
+    } else if (config.sliceOrientation == SliceOrientation::Sagittal) {
+        axes = glm::ivec2(1, 2);
+        normalAxis = 0;
+    }
+    // Fit the slice (the voxels extend half a voxel beyond their centers) into the framebuffer, centered. The center
+    // of pixel x lies at x + 0.5.
+    const glm::vec2 sliceSize { dim[axes.x], dim[axes.y] };
+    const float voxelsPerPixel = std::max(sliceSize.x / resolution.x, sliceSize.y / resolution.y);
+    const glm::vec2 sliceOrigin = (0.5f - 0.5f * resolution) * voxelsPerPixel + 0.5f * (sliceSize - 1.0f);
+
+    SlicePlane plane { glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f) };
+    plane.origin[axes.x] = sliceOrigin.x;
+    plane.origin[axes.y] = sliceOrigin.y;
+    plane.origin[normalAxis] = config.slicePosition * (dim[normalAxis] - 1.0f);
+    plane.xStep[axes.x] = voxelsPerPixel;
+    plane.yStep[axes.y] = voxelsPerPixel;
+    plane.normal[normalAxis] = 1.0f;
+    return plane;
+}
+
+MultiPlanarReformat::MultiPlanarReformat(size_t cacheCapacity)
+    : m_cacheCapacity(std::max(cacheCapacity, size_t(1)))
+{
+}
+
+const std::vector<glm::vec2>& MultiPlanarReformat::extract(const volume::Volume& volume, const SlicePlane& plane, const glm::ivec2& resolution, const SlabSettings& slab)
+{
+    const Key key { &volume, volume.interpolationMode, plane, resolution, slab };
+    const auto cached = std::find_if(std::begin(m_slices), std::end(m_slices), [&](const Slice& slice) { return slice.key == key; });
+    if (cached != std::end(m_slices)) {
+        m_slices.splice(std::begin(m_slices), m_slices, cached);
+        return m_slices.front().pixels;
+    }
+
+    TRACE_SCOPE("MultiPlanarReformat::extract");
+    // Reuse the memory of the least recently used slice once the cache is full.
+    if (m_slices.size() < m_cacheCapacity)
+        m_slices.emplace_front();
+    else
+        m_slices.splice(std::begin(m_slices), m_slices, std::prev(std::end(m_slices)));
+    Slice& slice = m_slices.front();
+    slice.key = key;
+    slice.pixels.resize(size_t(resolution.x) * size_t(resolution.y));
+
+    // A slab is sampled at (at most) one voxel intervals across its thickness.
+    const int numLayers = slab.thickness > 0.0f ? static_cast<int>(std::ceil(slab.thickness)) + 1 : 1;
+    const float layerStep = numLayers > 1 ? slab.thickness / float(numLayers - 1) : 0.0f;
+    const glm::vec3 upper = glm::vec3(volume.dims() - 1);
+    const float maximum = volume.maximum();
+    const bool mip = slab.mode == SlabMode::MIP;
+
+    const auto resample = [&](const auto& sample) {
+        tbb::parallel_for(tbb::blocked_range<int>(0, resolution.y), [&](const tbb::blocked_range<int>& rows) {
+            for (int y = rows.begin(); y != rows.end(); y++) {
+                // Accumulates the maximum (or sum) of the samples in x and their number in y.
+                glm::vec2* pRow = &slice.pixels[size_t(y) * size_t(resolution.x)];
+                std::fill(pRow, pRow + resolution.x, glm::vec2(mip ? std::numeric_limits<float>::lowest() : 0.0f, 0.0f));
+                for (int layer = 0; layer < numLayers; layer++) {
+                    glm::vec3 position = plane.origin + float(y) * plane.yStep + (float(layer) * layerStep - 0.5f * slab.thickness) * plane.normal;
+                    for (int x = 0; x < resolution.x; x++, position += plane.xStep) {
+                        if (position.x < 0.0f || position.y < 0.0f || position.z < 0.0f || position.x > upper.x || position.y > upper.y || position.z > upper.z)
+                            continue;
+                        const float value = sample(position);
+                        pRow[x].x = mip ? std::max(pRow[x].x, value) : pRow[x].x + value;
+                        pRow[x].y += 1.0f;
+                    }
+                }
+                // Same gray value as the slicer (Renderer::traceRaySlice).
+                for (int x = 0; x < resolution.x; x++) {
+                    const float numSamples = pRow[x].y;
+                    const float value = mip ? pRow[x].x : pRow[x].x / std::max(numSamples, 1.0f);
+                    pRow[x] = numSamples > 0.0f ? glm::vec2(std::max(value / maximum, 0.0f), 1.0f) : glm::vec2(0.0f);
+                }
+            }
+        });
+    };
+    volume.visit([&](const auto& voxels) {
+        switch (volume.interpolationMode) {
+        case volume::InterpolationMode::NearestNeighbour:
+            resample([&](const glm::vec3& position) { return voxels.sampleNearestNeighbour(position); });
+            break;
+        case volume::InterpolationMode::Linear:
+            resample([&](const glm::vec3& position) { return voxels.sampleTriLinear(position); });
+            break;
+        default:
+            resample([&](const glm::vec3& position) { return volume.getSampleInterpolate(position); });
+            break;
+        }
+    });
+    return slice.pixels;
+}
+
+void MultiPlanarReformat::clear()
+{
+    m_slices.clear();
+}
+
+}
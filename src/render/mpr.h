@@ -0,0 +1,67 @@
+#pragma once
+#include "render/ray_trace_camera.h"
+#include "render/render_config.h"
+#include "volume/volume.h"
+#include <cstddef>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <list>
+#include <vector>
+
+namespace render {
+
+// A plane through the volume as seen in the framebuffer: the pixel (x, y) samples the volume at
+// origin + x * xStep + y * yStep, and a slab extends along the (unit) normal.
+struct SlicePlane {
+    glm::vec3 origin;
+    glm::vec3 xStep, yStep;
+    glm::vec3 normal;
+
+    bool operator==(const SlicePlane&) const = default;
+};
+
+// The plane of config.sliceOrientation at config.slicePosition. The camera is only used for the camera plane, which
+// (at position 0.5) is the plane of the slicer: through the center of the volume, perpendicular to the view.
+SlicePlane slicePlane(const volume::Volume& volume, const RenderConfig& config, const RayTraceCamera& camera);
+
+// Multi-planar reformat engine. Slices are resampled row by row: the sample position of the next pixel of a row is
+// found incrementally (one addition), and the samples of a slab are taken as whole rows, one row per depth. The
+// most recently extracted slices are cached, so scrolling back and forth through a volume only resamples the
+// slices that have not been seen recently.
+class MultiPlanarReformat {
+public:
+    explicit MultiPlanarReformat(size_t cacheCapacity = 8);
+
+    struct SlabSettings {
+        float thickness; // In voxels.
+        SlabMode mode;
+
+        bool operator==(const SlabSettings&) const = default;
+    };
+    // Per pixel (row by row, bottom row first): the value relative to the maximum of the volume in x and whether the
+    // (slab of the) plane intersects the volume in y. Valid until the next call.
+    const std::vector<glm::vec2>& extract(const volume::Volume& volume, const SlicePlane& plane, const glm::ivec2& resolution, const SlabSettings& slab);
+
+    // Must be called when the contents of the volume change.
+    void clear();
+
+private:
+    struct Key {
+        const volume::Volume* pVolume;
+        volume::InterpolationMode interpolationMode;
+        SlicePlane plane;
+        glm::ivec2 resolution;
+        SlabSettings slab;
+
+        bool operator==(const Key&) const = default;
+    };
+    struct Slice {
+        Key key;
+        std::vector<glm::vec2> pixels;
+    };
+
+    size_t m_cacheCapacity;
+    std::list<Slice> m_slices; // Most recently used first.
+};
+
+}
@@ -0,0 +1,162 @@
+#include "occupancy_grid.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/vector_relational.hpp>
+#include <limits>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <vector>
+
+namespace render {
+
+OccupancyGrid::OccupancyGrid(const volume::BrickMinMax* pValueBricks)
+    : m_pValueBricks(pValueBricks)
+    , m_maxPosition(glm::vec3(pValueBricks->dims() * pValueBricks->brickSize()))
+    , m_occupied(pValueBricks->ranges().size(), 1)
+    , m_distances(m_occupied.size(), 0)
+    , m_scratch(m_occupied.size(), 0)
+{
+}
+
+void OccupancyGrid::update(const TransferFunction1DTable& tf1DTable)
+{
+    TRACE_SCOPE("OccupancyGrid::update1D");
+
+    // Prefix sum over the number of entries with non-zero opacity. The number of visible entries in [i0, i1]
+    // is then prefixSum[i1 + 1] - prefixSum[i0] which makes the per-brick test O(1).
+    const auto entries = tf1DTable.entries();
+    std::vector<uint32_t> prefixSum(entries.size() + 1, 0);
+    for (size_t i = 0; i < entries.size(); i++)
+        prefixSum[i + 1] = prefixSum[i] + (entries[i].a > 0.0f ? 1 : 0);
+
+    const auto ranges = m_pValueBricks->ranges();
+    std::atomic_bool changed { false };
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, ranges.size()), [&](const tbb::blocked_range<size_t>& localRange) {
+        for (size_t i = localRange.begin(); i != localRange.end(); i++) {
+            const size_t i0 = tf1DTable.index(ranges[i].x);
+            const size_t i1 = tf1DTable.index(ranges[i].y);
+            const uint8_t occupied = prefixSum[i1 + 1] != prefixSum[i0];
+            if (m_occupied[i] != occupied) {
+                m_occupied[i] = occupied;
+                changed = true;
+            }
+        }
+    });
+    if (changed)
+        updateDistances();
+}
+
+void OccupancyGrid::update(const volume::BrickMinMax& magnitudeBricks, const TransferFunction2DTable& tf2DTable)
+{
+    TRACE_SCOPE("OccupancyGrid::update2D");
+
+    const auto valueRanges = m_pValueBricks->ranges();
+    const auto magnitudeRanges = magnitudeBricks.ranges();
+    std::atomic_bool changed { false };
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, valueRanges.size()), [&](const tbb::blocked_range<size_t>& localRange) {
+        for (size_t i = localRange.begin(); i != localRange.end(); i++) {
+            const uint8_t occupied = tf2DTable.isVisible(valueRanges[i], magnitudeRanges[i]);
+            if (m_occupied[i] != occupied) {
+                m_occupied[i] = occupied;
+                changed = true;
+            }
+        }
+    });
+    if (changed)
+        updateDistances();
+}
+
+// One pass of the separable Chebyshev distance transform along an axis: out(p) is the minimum over the bricks q on
+// the line through p of max(|p - q|, in(q)). Starting from 0 for the occupied bricks and maxDistance for the empty
+// ones, passes along x, y and z give the distance max(|dx|, |dy|, |dz|) to the nearest occupied brick.
+//
+// Every line takes linear time (Meijster, Roerdink and Hesselink, "A General Algorithm for Computing Distance
+// Transforms in Linear Time"): a forward scan keeps the bricks q whose functions max(|p - q|, in(q)) form the lower
+// envelope together with the position from which on they are minimal, and a backward scan reads the envelope.
+static void chebyshevPass(gsl::span<const uint8_t> in, gsl::span<uint8_t> out, const glm::ivec3& dims, int axis)
+{
+    const glm::ivec3 strides { 1, dims.x, dims.x * dims.y };
+    const int axis1 = (axis + 1) % 3, axis2 = (axis + 2) % 3;
+    const int length = dims[axis];
+    const int stride = strides[axis];
+    tbb::parallel_for(tbb::blocked_range<int>(0, dims[axis1] * dims[axis2]), [&](const tbb::blocked_range<int>& lines) {
+        std::vector<int> envelope(static_cast<size_t>(length)), envelopeStart(static_cast<size_t>(length));
+        for (int line = lines.begin(); line != lines.end(); line++) {
+            const int first = (line % dims[axis1]) * strides[axis1] + (line / dims[axis1]) * strides[axis2];
+            const auto g = [&](int q) { return int(in[size_t(first + q * stride)]); };
+            const auto f = [&](int p, int q) { return std::max(std::abs(p - q), g(q)); };
+            // First position from which on the function of u is not larger than that of q < u.
+            const auto separation = [&](int q, int u) {
+                return 1 + (g(q) <= g(u) ? std::max(q + g(u), (q + u) / 2) : std::min(u - g(q), (q + u) / 2));
+            };
+
+            int top = 0;
+            envelope[0] = envelopeStart[0] = 0;
+            for (int u = 1; u < length; u++) {
+                while (top >= 0 && f(envelopeStart[size_t(top)], envelope[size_t(top)]) > f(envelopeStart[size_t(top)], u))
+                    top--;
+                if (top < 0) {
+                    top = 0;
+                    envelope[0] = u;
+                } else if (const int start = separation(envelope[size_t(top)], u); start < length) {
+                    top++;
+                    envelope[size_t(top)] = u;
+                    envelopeStart[size_t(top)] = start;
+                }
+            }
+            for (int p = length - 1; p >= 0; p--) {
+                out[size_t(first + p * stride)] = static_cast<uint8_t>(std::min(f(p, envelope[size_t(top)]), OccupancyGrid::maxDistance));
+                if (p == envelopeStart[size_t(top)])
+                    top--;
+            }
+        }
+    });
+}
+
+void OccupancyGrid::updateDistances()
+{
+    TRACE_SCOPE("OccupancyGrid::updateDistances");
+    const glm::ivec3 dims = m_pValueBricks->dims();
+    std::transform(std::begin(m_occupied), std::end(m_occupied), std::begin(m_scratch), [](uint8_t occupied) { return occupied ? uint8_t(0) : uint8_t(maxDistance); });
+    chebyshevPass(m_scratch, m_distances, dims, 0);
+    chebyshevPass(m_distances, m_scratch, dims, 1);
+    chebyshevPass(m_scratch, m_distances, dims, 2);
+}
+
+bool OccupancyGrid::isOccupied(const glm::ivec3& brick) const
+{
+    return m_occupied[m_pValueBricks->brickIndex(brick)] != 0;
+}
+
+int OccupancyGrid::distance(const glm::ivec3& brick) const
+{
+    return m_distances[m_pValueBricks->brickIndex(brick)];
+}
+
+float OccupancyGrid::skipEmptyRegion(const Ray& ray, float t, const glm::vec3& samplePos) const
+{
+    if (glm::any(glm::lessThan(samplePos, glm::vec3(0.0f))) || glm::any(glm::greaterThanEqual(samplePos, m_maxPosition)))
+        return t;
+
+    const glm::ivec3 brick = m_pValueBricks->brickAt(samplePos);
+    const int distance = this->distance(brick);
+    if (distance == 0)
+        return t;
+
+    // Distance to the far side of the cube of bricks [brick - (distance - 1), brick + (distance - 1)] along each
+    // axis (slab test).
+    const float brickSize = float(m_pValueBricks->brickSize());
+    float tExit = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++) {
+        if (ray.direction[axis] == 0.0f)
+            continue;
+        const int boundaryBrick = ray.direction[axis] > 0.0f ? brick[axis] + distance : brick[axis] - distance + 1;
+        tExit = std::min(tExit, (float(boundaryBrick) * brickSize - ray.origin[axis]) / ray.direction[axis]);
+    }
+    return std::max(tExit, t);
+}
+
+}
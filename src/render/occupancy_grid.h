@@ -0,0 +1,51 @@
+#pragma once
+#include "render/ray.h"
+#include "render/transfer_function_1d.h"
+#include "render/transfer_function_2d.h"
+#include "volume/brick_min_max.h"
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <gsl/span>
+#include <vector>
+
+namespace render {
+
+// Per-brick flags that tell whether a brick can contribute anything to the image under the current transfer
+// function. Derived from the brick value ranges (volume::BrickMinMax) so it is cheap to rebuild whenever the
+// transfer function changes. Raymarchers use it to jump over bricks in which every sample has zero opacity.
+//
+// Every brick also stores its Chebyshev distance (in bricks) to the nearest occupied brick: all bricks within a
+// cube of radius distance - 1 around it are empty, so a ray can leap out of that whole cube at once instead of
+// leaving the empty bricks one at a time. The distances are computed with one parallel pass per axis and only
+// when an update changes the flags.
+class OccupancyGrid {
+public:
+    OccupancyGrid(const volume::BrickMinMax* pValueBricks);
+
+    // 1D transfer function: a brick is occupied if any entry of the table that its value range maps to has a non-zero
+    // opacity. Uses the index of TransferFunction1DTable::lookup so that a skipped brick never holds a visible sample.
+    void update(const TransferFunction1DTable& tf1DTable);
+    // 2D transfer function: a brick is occupied if the table is non-zero anywhere within its value and gradient magnitude range.
+    void update(const volume::BrickMinMax& magnitudeBricks, const TransferFunction2DTable& tf2DTable);
+
+    bool isOccupied(const glm::ivec3& brick) const;
+    // Chebyshev distance to the nearest occupied brick (0 for an occupied brick), at most maxDistance.
+    int distance(const glm::ivec3& brick) const;
+    static constexpr int maxDistance = 255;
+
+    // If samplePos lies in an empty brick, returns the distance along the ray at which the ray leaves the cube of
+    // empty bricks around that brick. Otherwise (occupied or outside of the volume) returns t.
+    float skipEmptyRegion(const Ray& ray, float t, const glm::vec3& samplePos) const;
+
+private:
+    void updateDistances();
+
+    const volume::BrickMinMax* m_pValueBricks;
+    glm::vec3 m_maxPosition;
+    std::vector<uint8_t> m_occupied;
+    std::vector<uint8_t> m_distances;
+    std::vector<uint8_t> m_scratch; // Distances after the first passes.
+};
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "render/ray.h"
+#include "volume/min_max_octree.h"
+#include <algorithm>
+#include <glm/gtx/component_wise.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace render {
+
+enum class OctreeVisit {
+    Skip, // Do not visit the children of the node.
+    Descend, // Visit the children of the node (same as Skip for the leaves).
+    Stop // Terminate the traversal.
+};
+
+namespace detail {
+    template <typename Visitor>
+    bool traverseOctreeNode(const volume::MinMaxOctree& octree, const Ray& ray, int directionMask, int level, const glm::ivec3& node, const glm::vec3& t0, const glm::vec3& t1, Visitor& visitor)
+    {
+        const float tEnter = std::max(glm::compMax(t0), ray.tmin);
+        const float tExit = std::min(glm::compMin(t1), ray.tmax);
+        if (tEnter > tExit)
+            return false;
+
+        const OctreeVisit visit = visitor(level, node, octree.range(level, node), tEnter, tExit);
+        if (visit == OctreeVisit::Stop)
+            return true;
+        if (visit == OctreeVisit::Skip || level == 0)
+            return false;
+
+        const glm::vec3 tMid = 0.5f * (t0 + t1);
+        const glm::ivec3 childLevelDims = octree.levelDims(level - 1);
+        for (int i = 0; i < 8; i++) {
+            const int childIndex = i ^ directionMask;
+            const glm::ivec3 child = node * 2 + glm::ivec3(childIndex & 1, (childIndex >> 1) & 1, (childIndex >> 2) & 1);
+            if (child.x >= childLevelDims.x || child.y >= childLevelDims.y || child.z >= childLevelDims.z)
+                continue;
+
+            glm::vec3 childT0, childT1;
+            for (int axis = 0; axis < 3; axis++) {
+                const bool upperHalf = (i >> axis) & 1;
+                childT0[axis] = upperHalf ? tMid[axis] : t0[axis];
+                childT1[axis] = upperHalf ? t1[axis] : tMid[axis];
+            }
+            if (traverseOctreeNode(octree, ray, directionMask, level - 1, child, childT0, childT1, visitor))
+                return true;
+        }
+        return false;
+    }
+}
+
+// Visits the octree nodes that the ray passes through within [ray.tmin, ray.tmax] front to back, calling
+// visitor(level, node, range, tEnter, tExit) -> OctreeVisit for each of them. Returns true if the visitor
+// stopped the traversal.
+//
+// The traversal is parametric: instead of intersecting the ray with the box of every node, the entry and exit
+// distances of the slabs of a node along each axis are passed down and split at the midpoint for the children.
+// The axes along which the ray travels in the negative direction are mirrored such that child 0 is always in
+// front; the mirrored child index is converted back by XOR-ing with directionMask.
+template <typename Visitor>
+bool traverseOctree(const volume::MinMaxOctree& octree, const Ray& ray, Visitor&& visitor)
+{
+    // Rays parallel to an axis would produce NaNs when splitting infinite slabs, so nudge those components.
+    glm::vec3 direction = ray.direction;
+    for (int axis = 0; axis < 3; axis++) {
+        if (direction[axis] == 0.0f)
+            direction[axis] = 1e-20f;
+    }
+
+    const int topLevel = octree.numLevels() - 1;
+    const glm::vec3 tLower = (octree.nodeLower(topLevel, glm::ivec3(0)) - ray.origin) / direction;
+    const glm::vec3 tUpper = (octree.nodeUpper(topLevel, glm::ivec3(0)) - ray.origin) / direction;
+    const int directionMask = (direction.x < 0.0f ? 1 : 0) | (direction.y < 0.0f ? 2 : 0) | (direction.z < 0.0f ? 4 : 0);
+    return detail::traverseOctreeNode(octree, ray, directionMask, topLevel, glm::ivec3(0), glm::min(tLower, tUpper), glm::max(tLower, tUpper), visitor);
+}
+
+}
@@ -0,0 +1,85 @@
+#include "render_config.h"
+#include <functional>
+
+namespace render {
+
+bool requiresGradients(const RenderConfig& config)
+{
+    switch (config.renderMode) {
+    case RenderMode::RenderIso:
+    case RenderMode::RenderComposite:
+    case RenderMode::RenderShearWarp:
+        return config.volumeShading;
+    case RenderMode::RenderTF2D:
+    case RenderMode::RenderIsoMesh: // The mesh normals are taken from the gradients.
+        return true;
+    default:
+        return false;
+    };
+}
+
+RenderConfigChange diff(const RenderConfig& lhs, const RenderConfig& rhs)
+{
+    RenderConfigChange changes = RenderConfigChange::None;
+    if (lhs.renderMode != rhs.renderMode)
+        changes |= RenderConfigChange::RenderMode;
+    if (lhs.renderResolution != rhs.renderResolution)
+        changes |= RenderConfigChange::Resolution;
+    if (lhs.frameBufferFormat != rhs.frameBufferFormat)
+        changes |= RenderConfigChange::FrameBufferFormat;
+    if (lhs.volumeShading != rhs.volumeShading)
+        changes |= RenderConfigChange::Shading;
+    if (lhs.preClassification != rhs.preClassification)
+        changes |= RenderConfigChange::PreClassification;
+    if (lhs.sliceOrientation != rhs.sliceOrientation || lhs.slicePosition != rhs.slicePosition || lhs.slabThickness != rhs.slabThickness || lhs.slabMode != rhs.slabMode)
+        changes |= RenderConfigChange::Slice;
+    if (lhs.isoValue != rhs.isoValue)
+        changes |= RenderConfigChange::IsoValue;
+    if (lhs.tfColorMapVersion != rhs.tfColorMapVersion || lhs.tfColorMapIndexStart != rhs.tfColorMapIndexStart || lhs.tfColorMapIndexRange != rhs.tfColorMapIndexRange)
+        changes |= RenderConfigChange::TransferFunction1D;
+    if (lhs.TF2DIntensity != rhs.TF2DIntensity || lhs.TF2DRadius != rhs.TF2DRadius || lhs.TF2DColor != rhs.TF2DColor || lhs.TF2DPrimitives != rhs.TF2DPrimitives)
+        changes |= RenderConfigChange::TransferFunction2D;
+    return changes;
+}
+
+// https://www.boost.org/doc/libs/1_75_0/doc/html/hash/reference.html#boost.hash_combine
+template <typename T>
+static void hashCombine(size_t& seed, const T& value)
+{
+    seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+size_t hash(const RenderConfig& config)
+{
+    size_t seed = 0;
+    hashCombine(seed, int(config.renderMode));
+    hashCombine(seed, config.renderResolution.x);
+    hashCombine(seed, config.renderResolution.y);
+    hashCombine(seed, int(config.frameBufferFormat));
+    hashCombine(seed, int(config.sliceOrientation));
+    hashCombine(seed, config.slicePosition);
+    hashCombine(seed, config.slabThickness);
+    hashCombine(seed, int(config.slabMode));
+    hashCombine(seed, config.volumeShading);
+    hashCombine(seed, int(config.preClassification));
+    hashCombine(seed, config.isoValue);
+    hashCombine(seed, config.tfColorMapVersion);
+    hashCombine(seed, config.tfColorMapIndexStart);
+    hashCombine(seed, config.tfColorMapIndexRange);
+    hashCombine(seed, config.TF2DIntensity);
+    hashCombine(seed, config.TF2DRadius);
+    for (int i = 0; i < 4; i++)
+        hashCombine(seed, config.TF2DColor[i]);
+    for (const TF2DPrimitive& primitive : config.TF2DPrimitives) {
+        hashCombine(seed, int(primitive.shape));
+        for (int i = 0; i < 2; i++) {
+            hashCombine(seed, primitive.center[i]);
+            hashCombine(seed, primitive.halfSize[i]);
+        }
+        for (int i = 0; i < 4; i++)
+            hashCombine(seed, primitive.color[i]);
+    }
+    return seed;
+}
+
+}
@@ -1,8 +1,10 @@
 #pragma once
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
-#include <cstring> // memcmp  // macOS change TH
+#include <vector>
 
 namespace render {
 
@@ -11,37 +13,149 @@ enum class RenderMode {
     RenderMIP,
     RenderIso,
     RenderComposite,
-    RenderTF2D
+    RenderTF2D,
+    // Ray trace a triangle mesh of the iso surface (extracted with marching cubes) instead of the volume.
+    RenderIsoMesh,
+    // Compositing (with the 1D transfer function) in object order by shear-warp factorization, see ShearWarpVolume.
+    RenderShearWarp,
+    // Multi-planar reformat: a (thick) slice through the volume, see MultiPlanarReformat.
+    RenderMPR
+};
+
+// Pixel format of the CPU framebuffer. The final image is displayed with 8 bits per channel so RGBA8 is
+// the default; the wider formats are only useful when the output is post-processed.
+enum class FrameBufferFormat {
+    RGBA8,
+    RGBA16F,
+    RGBA32F
+};
+
+// Whether the compositing mode renders from a pre-classified volume (see ClassifiedVolume). Auto switches to it
+// once the 1D transfer function has not changed for a moment, e.g. while the user orbits the camera.
+enum class PreClassification {
+    Off,
+    Auto,
+    On
+};
+
+// Plane of the multi-planar reformat mode. The axis aligned planes are shown fitted to the framebuffer; the camera
+// plane (perpendicular to the view direction, i.e. any oblique plane) is shown from the camera like the slicer.
+enum class SliceOrientation {
+    Camera,
+    Axial, // Normal along z.
+    Coronal, // Normal along y.
+    Sagittal // Normal along x.
+};
+// How the samples across the thickness of a slab are combined.
+enum class SlabMode {
+    MIP,
+    Average
+};
+
+// Primitive of the 2D transfer function, defined over (voxel value, normalized gradient magnitude) where the
+// gradient magnitude is mapped from [minMagnitude, maxMagnitude] of the gradient volume to [0, 1].
+enum class TF2DShape {
+    // Tent around center.x whose half width grows linearly from 0 at magnitude 0 to halfSize.x at magnitude 1.
+    Triangle,
+    // Constant opacity within center +/- halfSize.
+    Box,
+    // exp(-d^2 / 2) with d the distance to center in units of halfSize (the standard deviations).
+    Gaussian
+};
+struct TF2DPrimitive {
+    TF2DShape shape { TF2DShape::Triangle };
+    glm::vec2 center { 0.0f };
+    glm::vec2 halfSize { 1.0f };
+    glm::vec4 color { 1.0f };
+
+    bool operator==(const TF2DPrimitive&) const = default;
 };
 
 struct RenderConfig {
     RenderMode renderMode { RenderMode::RenderSlicer };
     glm::ivec2 renderResolution;
+    FrameBufferFormat frameBufferFormat { FrameBufferFormat::RGBA8 };
+
+    // Multi-planar reformat: the position of the plane along its normal goes from 0 (first slice) to 1 (last slice);
+    // 0.5 is the center of the volume. The slab thickness is in voxels (0 samples the plane only).
+    SliceOrientation sliceOrientation { SliceOrientation::Axial };
+    float slicePosition { 0.5f };
+    float slabThickness { 0.0f };
+    SlabMode slabMode { SlabMode::MIP };
 
     bool volumeShading { false };
+    PreClassification preClassification { PreClassification::Auto };
     float isoValue { 95.0f };
 
-    // 1D transfer function.
-    std::array<glm::vec4, 256> tfColorMap;
+    // 1D transfer function. The number of entries sets its resolution (up to 65536, such that every 16-bit value
+    // can have its own entry).
+    std::vector<glm::vec4> tfColorMap = std::vector<glm::vec4>(256);
     // Used to convert from a value to an index in the color map.
     // index = (value - start) / range * tfColorMap.size();
     float tfColorMapIndexStart;
     float tfColorMapIndexRange;
+    // Identifies the contents of tfColorMap. Whoever modifies tfColorMap must also assign a new (unique) version
+    // so that the color map does not have to be compared element by element.
+    uint64_t tfColorMapVersion { 0 };
 
-    // 2D transfer function.
+    // 2D transfer function: the triangle of the widget plus any number of additional primitives. The renderer
+    // rasterizes all of them into a lookup table (see TransferFunction2DTable).
     float TF2DIntensity;
     float TF2DRadius;
     glm::vec4 TF2DColor;
+    std::vector<TF2DPrimitive> TF2DPrimitives;
+};
+
+// Bit mask of the parts of a RenderConfig that differ between two configs. Renderer caches use this to only
+// invalidate what actually changed (e.g. moving the iso value does not invalidate transfer function tables).
+enum class RenderConfigChange : uint32_t {
+    None = 0,
+    RenderMode = 1 << 0,
+    Resolution = 1 << 1,
+    FrameBufferFormat = 1 << 2,
+    Shading = 1 << 3,
+    IsoValue = 1 << 4,
+    TransferFunction1D = 1 << 5,
+    TransferFunction2D = 1 << 6,
+    PreClassification = 1 << 7,
+    // The multi-planar reformat caches slices by their plane, so moving the slice does not invalidate them.
+    Slice = 1 << 8,
+    All = (1 << 9) - 1
 };
 
-// NOTE(Mathijs): should be replaced by C++20 three-way operator (aka spaceship operator) if we require C++ 20 support from Linux users (GCC10 / Clang10).
+constexpr RenderConfigChange operator|(RenderConfigChange lhs, RenderConfigChange rhs)
+{
+    return RenderConfigChange(uint32_t(lhs) | uint32_t(rhs));
+}
+constexpr RenderConfigChange operator&(RenderConfigChange lhs, RenderConfigChange rhs)
+{
+    return RenderConfigChange(uint32_t(lhs) & uint32_t(rhs));
+}
+constexpr RenderConfigChange& operator|=(RenderConfigChange& lhs, RenderConfigChange rhs)
+{
+    return lhs = lhs | rhs;
+}
+// Whether any of the bits in mask are set.
+constexpr bool any(RenderConfigChange changes, RenderConfigChange mask = RenderConfigChange::All)
+{
+    return (changes & mask) != RenderConfigChange::None;
+}
+
+// Whether the render mode (with the current settings) samples the gradient volume.
+bool requiresGradients(const RenderConfig& config);
+
+// Compare two configs field by field (the color map is compared through its version).
+RenderConfigChange diff(const RenderConfig& lhs, const RenderConfig& rhs);
+// Cheap hash for frame-to-frame change detection (does not touch the color map contents).
+size_t hash(const RenderConfig& config);
+
 inline bool operator==(const RenderConfig& lhs, const RenderConfig& rhs)
 {
-    return std::memcmp(&lhs, &rhs, sizeof(RenderConfig)) == 0;
+    return diff(lhs, rhs) == RenderConfigChange::None;
 }
 inline bool operator!=(const RenderConfig& lhs, const RenderConfig& rhs)
 {
     return !(lhs == rhs);
 }
 
-}
\ No newline at end of file
+}
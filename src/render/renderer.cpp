@@ -1,14 +1,25 @@
 #include "renderer.h"
+#include "mesh/marching_cubes.h"
+#include "render/cell_traversal.h"
+#include "render/octree_traversal.h"
+#include "util/numa.h"
+#include "util/trace.h"
 #include <algorithm>
 #include <algorithm> // std::fill
+#include <array>
 #include <cmath>
 #include <functional>
 #include <glm/common.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/component_wise.hpp>
+#include <glm/vector_relational.hpp>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <tbb/blocked_range2d.h>
 #include <tbb/parallel_for.h>
 #include <tuple>
+#include <type_traits>
 
 namespace render {
 
@@ -25,48 +36,240 @@ Renderer::Renderer(
     , m_pGradientVolume(pGradientVolume)
     , m_pCamera(pCamera)
     , m_config(initialConfig)
+    , m_valueBricks(*pVolume)
+    , m_valueOctree(m_valueBricks)
+    , m_occupancyTF1D(&m_valueBricks)
+    , m_occupancyTF2D(&m_valueBricks)
 {
-    resizeImage(initialConfig.renderResolution);
+    if (pGradientVolume)
+        m_magnitudeBricks.emplace(*pGradientVolume);
+    resizeImage(initialConfig.renderResolution, initialConfig.frameBufferFormat);
+}
+
+// Provide the gradient volume once it becomes available (it is computed in the background after loading).
+void Renderer::setGradientVolume(const volume::GradientVolume* pGradientVolume)
+{
+    m_pGradientVolume = pGradientVolume;
+    if (pGradientVolume)
+        m_magnitudeBricks.emplace(*pGradientVolume);
+    else
+        m_magnitudeBricks.reset();
+    m_isoSurfaceBVH.reset();
+    m_classifiedVolume.reset(); // Normals.
+    m_normalVolume.reset();
+    m_shearWarpVolumes = {};
+    m_dirty |= RenderConfigChange::TransferFunction2D;
 }
 
 // Set a new render config if the user changed the settings.
+// Only the framebuffer is updated immediately; other derived data is rebuilt lazily by updateCaches() and
+// only for the parts of the config that actually changed.
 void Renderer::setConfig(const RenderConfig& config)
 {
-    if (config.renderResolution != m_config.renderResolution)
-        resizeImage(config.renderResolution);
+    const RenderConfigChange changes = diff(m_config, config);
+    if (any(changes, RenderConfigChange::Resolution | RenderConfigChange::FrameBufferFormat))
+        resizeImage(config.renderResolution, config.frameBufferFormat);
 
     m_config = config;
+    m_dirty |= changes;
+}
+
+void Renderer::setVolume(const volume::Volume* pVolume, const volume::GradientVolume* pGradientVolume)
+{
+    m_pVolume = pVolume;
+    m_valueBricks = volume::BrickMinMax(*pVolume);
+    m_valueOctree = volume::MinMaxOctree(m_valueBricks);
+    m_occupancyTF1D = OccupancyGrid(&m_valueBricks);
+    m_occupancyTF2D = OccupancyGrid(&m_valueBricks);
+    m_mpr.clear();
+    m_dirty |= RenderConfigChange::TransferFunction1D;
+    setGradientVolume(pGradientVolume);
+}
+
+// Bring the data derived from the render config up to date before rendering a frame. Each cache checks the
+// bits of m_dirty that it depends on so that, for example, moving the camera or the iso value does not
+// rebuild transfer function tables.
+void Renderer::updateCaches()
+{
+    if (any(m_dirty, RenderConfigChange::TransferFunction1D)) {
+        m_tf1DTable.update(m_config, renderSampleStep);
+        m_occupancyTF1D.update(m_tf1DTable);
+        m_classifiedVolume.reset();
+        m_shearWarpVolumes = {};
+        m_tf1DChangeTime = std::chrono::steady_clock::now();
+    }
+    if (m_config.renderMode != RenderMode::RenderShearWarp)
+        m_shearWarpVolumes = {};
+    // Classify the volume once the transfer function has settled (Auto); release it when it is not used.
+    if (m_config.preClassification == PreClassification::Off || m_config.renderMode != RenderMode::RenderComposite)
+        m_classifiedVolume.reset();
+    else if (!m_classifiedVolume && (m_config.preClassification == PreClassification::On || std::chrono::steady_clock::now() - m_tf1DChangeTime >= preClassificationDelay))
+        m_classifiedVolume.emplace(*m_pVolume, m_pGradientVolume, m_tf1DTable);
+    // Shear-warp uses the normals when falling back to ray casting.
+    const bool compositing = m_config.renderMode == RenderMode::RenderComposite || m_config.renderMode == RenderMode::RenderShearWarp;
+    if (!m_config.volumeShading || !compositing || !m_pGradientVolume)
+        m_normalVolume.reset();
+    else if (!m_normalVolume)
+        m_normalVolume.emplace(*m_pVolume, *m_pGradientVolume);
+    if (any(m_dirty, RenderConfigChange::TransferFunction2D) && m_pGradientVolume) {
+        m_tf2DTable.rasterize(m_config, glm::vec2(m_pVolume->minimum(), m_pVolume->maximum()), glm::vec2(m_pGradientVolume->minMagnitude(), m_pGradientVolume->maxMagnitude()));
+        m_occupancyTF2D.update(*m_magnitudeBricks, m_tf2DTable);
+    }
+    // Release the cached slices while the multi-planar reformat is not shown.
+    if (any(m_dirty, RenderConfigChange::RenderMode | RenderConfigChange::Slice) && m_config.renderMode != RenderMode::RenderMPR)
+        m_mpr.clear();
+    if (any(m_dirty, RenderConfigChange::IsoValue))
+        m_isoSurfaceBVH.reset();
+    if (m_config.renderMode == RenderMode::RenderIsoMesh && !m_isoSurfaceBVH && m_pGradientVolume)
+        m_isoSurfaceBVH.emplace(mesh::extractIsoSurface(*m_pVolume, *m_pGradientVolume, m_valueBricks, m_config.isoValue));
+
+    m_dirty = RenderConfigChange::None;
 }
 
-// Resize the framebuffer and fill it with black pixels.
-void Renderer::resizeImage(const glm::ivec2& resolution)
+// Resize the framebuffer of the given format and fill it with black pixels. The previous framebuffer goes back
+// to the pool; framebuffers (and pools) of the other formats are released. Must be called before m_config is
+// updated to the new resolution.
+void Renderer::resizeImage(const glm::ivec2& resolution, FrameBufferFormat format)
 {
-    m_frameBuffer.resize(size_t(resolution.x) * size_t(resolution.y), glm::vec4(0.0f));
+    auto resizeOrRelease = [&](auto& buffer, auto& pool, FrameBufferFormat bufferFormat) {
+        if (format == bufferFormat) {
+            pool.exchange(buffer, m_config.renderResolution, resolution);
+        } else {
+            pool.clear();
+            std::decay_t<decltype(buffer)>().swap(buffer);
+        }
+    };
+    resizeOrRelease(m_frameBuffer, m_frameBufferPool, FrameBufferFormat::RGBA32F);
+    resizeOrRelease(m_frameBufferRGBA16F, m_frameBufferPoolRGBA16F, FrameBufferFormat::RGBA16F);
+    resizeOrRelease(m_frameBufferRGBA8, m_frameBufferPoolRGBA8, FrameBufferFormat::RGBA8);
 }
 
 // Clear the framebuffer by setting all pixels to black.
 void Renderer::resetImage()
 {
     std::fill(std::begin(m_frameBuffer), std::end(m_frameBuffer), glm::vec4(0.0f));
+    std::fill(std::begin(m_frameBufferRGBA16F), std::end(m_frameBufferRGBA16F), glm::u16vec4(0));
+    std::fill(std::begin(m_frameBufferRGBA8), std::end(m_frameBufferRGBA8), glm::u8vec4(0));
+}
+
+// Return a copy of the framebuffer converted to RGBA32F, whatever the format in which it is stored.
+std::vector<glm::vec4> Renderer::frameBuffer() const
+{
+    switch (m_config.frameBufferFormat) {
+    case FrameBufferFormat::RGBA8: {
+        std::vector<glm::vec4> pixels(m_frameBufferRGBA8.size());
+        std::transform(std::begin(m_frameBufferRGBA8), std::end(m_frameBufferRGBA8), std::begin(pixels), [](const glm::u8vec4& pixel) { return glm::unpackUnorm<float>(pixel); });
+        return pixels;
+    }
+    case FrameBufferFormat::RGBA16F: {
+        std::vector<glm::vec4> pixels(m_frameBufferRGBA16F.size());
+        std::transform(std::begin(m_frameBufferRGBA16F), std::end(m_frameBufferRGBA16F), std::begin(pixels), [](const glm::u16vec4& pixel) { return glm::unpackHalf(pixel); });
+        return pixels;
+    }
+    case FrameBufferFormat::RGBA32F:
+    default:
+        return m_frameBuffer;
+    };
+}
+
+// Return a VIEW of the raw bytes of the framebuffer in the format given by frameBufferFormat().
+gsl::span<const std::byte> Renderer::frameBufferBytes() const
+{
+    switch (m_config.frameBufferFormat) {
+    case FrameBufferFormat::RGBA8:
+        return gsl::as_bytes(gsl::span<const glm::u8vec4>(m_frameBufferRGBA8));
+    case FrameBufferFormat::RGBA16F:
+        return gsl::as_bytes(gsl::span<const glm::u16vec4>(m_frameBufferRGBA16F));
+    case FrameBufferFormat::RGBA32F:
+    default:
+        return gsl::as_bytes(gsl::span<const glm::vec4>(m_frameBuffer));
+    };
 }
 
-// Return a VIEW into the framebuffer. This view is merely a reference to the m_frameBuffer member variable.
-// This does NOT make a copy of the framebuffer.
-gsl::span<const glm::vec4> Renderer::frameBuffer() const
+FrameBufferFormat Renderer::frameBufferFormat() const
 {
-    return m_frameBuffer;
+    return m_config.frameBufferFormat;
 }
 
 // Main render function. It computes an image according to the current renderMode.
 // Multithreading is enabled in Release/RelWithDebInfo modes. In Debug mode multithreading is disabled to make debugging easier.
 void Renderer::render()
 {
+    TRACE_SCOPE("Renderer::render");
+    m_frameArena.reset();
+    updateCaches();
     resetImage();
 
-    static constexpr float sampleStep = 1.0f;
+    static constexpr float sampleStep = renderSampleStep;
     const glm::vec3 planeNormal = -glm::normalize(m_pCamera->forward());
     const glm::vec3 volumeCenter = glm::vec3(m_pVolume->dims()) / 2.0f;
     const Bounds bounds { glm::vec3(0.0f), glm::vec3(m_pVolume->dims() - glm::ivec3(1)) };
+    // Show a MIP preview until the gradients (computed in the background) are available.
+    const RenderMode renderMode = (m_pGradientVolume || !requiresGradients(m_config)) ? m_config.renderMode : RenderMode::RenderMIP;
+    // Shear-warp composites the whole image at once; with the camera in between the slices it falls back to ray casting.
+    if (renderMode == RenderMode::RenderShearWarp && renderShearWarp())
+        return;
+    if (renderMode == RenderMode::RenderMPR) {
+        renderMPR();
+        return;
+    }
+
+    // Compute the color of a single pixel.
+    const auto renderPixel = [&](const auto& voxels, int x, int y) {
+        // Compute a ray for the current pixel.
+        const glm::vec2 pixelPos = glm::vec2(x, y) / glm::vec2(m_config.renderResolution);
+        Ray ray = m_pCamera->generateRay(pixelPos * 2.0f - 1.0f);
+
+        // Compute where the ray enters and exists the volume.
+        // If the ray misses the volume then we continue to the next pixel.
+        if (!instersectRayVolumeBounds(ray, bounds))
+            return;
+
+        // Get a color for the current pixel according to the current render mode.
+        glm::vec4 color {};
+        switch (renderMode) {
+        case RenderMode::RenderSlicer: {
+            color = traceRaySlice(ray, volumeCenter, planeNormal);
+            break;
+        }
+        case RenderMode::RenderMIP: {
+            // Cubic interpolation can overshoot the voxel values so the octree ranges do not bound it.
+            if (m_pVolume->interpolationMode == volume::InterpolationMode::Cubic)
+                color = traceRayMIP(ray, sampleStep);
+            else
+                color = traceRayMIPOctree(voxels, ray, sampleStep);
+            break;
+        }
+        case RenderMode::RenderComposite:
+        case RenderMode::RenderShearWarp: {
+            // Cubic interpolation is not available on the classified volume.
+            if (m_classifiedVolume && m_pVolume->interpolationMode != volume::InterpolationMode::Cubic)
+                color = traceRayCompositeClassified(ray, sampleStep);
+            else
+                color = traceRayComposite(voxels, ray, sampleStep);
+            break;
+        }
+        case RenderMode::RenderIso: {
+            if (m_pVolume->interpolationMode == volume::InterpolationMode::Cubic)
+                color = traceRayISO(ray, sampleStep);
+            else
+                color = traceRayISOOctree(voxels, ray);
+            break;
+        }
+        case RenderMode::RenderTF2D: {
+            color = traceRayTF2D(voxels, ray, sampleStep);
+            break;
+        }
+        case RenderMode::RenderIsoMesh: {
+            color = traceRayIsoMesh(ray);
+            break;
+        }
+        case RenderMode::RenderMPR: // Not rendered per pixel (see renderMPR).
+            break;
+        };
+        // Write the resulting color to the screen.
+        fillColor(x, y, color);
+    };
 
     // 0 = sequential (single-core), 1 = TBB (multi-core)
 #ifdef NDEBUG
@@ -79,60 +282,112 @@ void Renderer::render()
 
 #if PARALLELISM == 0
     // Regular (single threaded) for loops.
-    for (int x = 0; x < m_config.renderResolution.x; x++) {
-        for (int y = 0; y < m_config.renderResolution.y; y++) {
+    m_pVolume->visit([&](const auto& voxels) {
+        for (int x = 0; x < m_config.renderResolution.x; x++) {
+            for (int y = 0; y < m_config.renderResolution.y; y++)
+                renderPixel(voxels, x, y);
+        }
+    });
 #else
-    // Parallel for loop (in 2 dimensions) that subdivides the screen into tiles.
-    const tbb::blocked_range2d<int> screenRange { 0, m_config.renderResolution.y, 0, m_config.renderResolution.x };
-        tbb::parallel_for(screenRange, [&](tbb::blocked_range2d<int> localRange) {
-        // Loop over the pixels in a tile. This function is called on multiple threads at the same time.
-        for (int y = std::begin(localRange.rows()); y != std::end(localRange.rows()); y++) {
-            for (int x = std::begin(localRange.cols()); x != std::end(localRange.cols()); x++) {
+    // Loop over the pixels in a tile. This function is called on multiple threads at the same time.
+    const auto renderTile = [&](const tbb::blocked_range2d<int>& localRange) {
+        TRACE_SCOPE("Renderer::renderTile");
+        m_pVolume->visit([&](const auto& voxels) {
+            for (int y = std::begin(localRange.rows()); y != std::end(localRange.rows()); y++) {
+                for (int x = std::begin(localRange.cols()); x != std::end(localRange.cols()); x++)
+                    renderPixel(voxels, x, y);
+            }
+        });
+    };
+
+    const util::NumaTopology& numaTopology = util::NumaTopology::instance();
+    if (numaTopology.numNodes() > 1 && m_pVolume->placement() == util::NumaPlacement::Partitioned) {
+        // Render every tile on the NUMA node that owns the voxel halfway along the ray through the center of the
+        // tile, such that most samples are read from local memory. Tiles that miss the volume are spread evenly.
+        constexpr int tileSize = 16;
+        const glm::ivec2 resolution = m_config.renderResolution;
+        const glm::ivec2 numTiles = (resolution + tileSize - 1) / tileSize;
+        using TileList = util::ArenaVector<tbb::blocked_range2d<int>>;
+        const util::ArenaAllocator<TileList> allocator { m_frameArena };
+        util::ArenaVector<TileList> nodeTiles(numaTopology.numNodes(), TileList(allocator), allocator);
+        for (TileList& tiles : nodeTiles)
+            tiles.reserve(size_t(numTiles.x * numTiles.y));
+        for (int tileY = 0; tileY < numTiles.y; tileY++) {
+            for (int tileX = 0; tileX < numTiles.x; tileX++) {
+                const glm::vec2 tileCenter = (glm::vec2(tileX, tileY) + 0.5f) * float(tileSize) / glm::vec2(resolution);
+                Ray ray = m_pCamera->generateRay(tileCenter * 2.0f - 1.0f);
+                size_t node = size_t(tileX + tileY) % numaTopology.numNodes();
+                if (instersectRayVolumeBounds(ray, bounds)) {
+                    const glm::vec3 middle = ray.origin + 0.5f * (ray.tmin + ray.tmax) * ray.direction;
+                    const glm::ivec3 voxel = glm::clamp(glm::ivec3(middle), glm::ivec3(0), m_pVolume->dims() - 1);
+                    node = numaTopology.partitionNode(m_pVolume->indexer()(voxel.x, voxel.y, voxel.z), m_pVolume->storageSize());
+                }
+                nodeTiles[node].emplace_back(
+                    tileY * tileSize, std::min((tileY + 1) * tileSize, resolution.y),
+                    tileX * tileSize, std::min((tileX + 1) * tileSize, resolution.x));
+            }
+        }
+        numaTopology.forEachNode([&](size_t node) {
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, nodeTiles[node].size(), 1), [&](const tbb::blocked_range<size_t>& range) {
+                for (size_t i = range.begin(); i != range.end(); i++)
+                    renderTile(nodeTiles[node][i]);
+            });
+        });
+    } else {
+        // Parallel for loop (in 2 dimensions) that subdivides the screen into tiles.
+        const tbb::blocked_range2d<int> screenRange { 0, m_config.renderResolution.y, 0, m_config.renderResolution.x };
+        tbb::parallel_for(screenRange, renderTile);
+    }
 #endif
-            // Compute a ray for the current pixel.
-            const glm::vec2 pixelPos = glm::vec2(x, y) / glm::vec2(m_config.renderResolution);
-            Ray ray = m_pCamera->generateRay(pixelPos * 2.0f - 1.0f);
+}
 
-            // Compute where the ray enters and exists the volume.
-            // If the ray misses the volume then we continue to the next pixel.
-            if (!instersectRayVolumeBounds(ray, bounds))
-                continue;
+// Composite the volume in object order (see ShearWarpVolume) and warp the intermediate image onto the framebuffer.
+// Returns false when the camera lies in between the slices along the principal axis of the view, which the
+// factorization does not support.
+bool Renderer::renderShearWarp()
+{
+    TRACE_SCOPE("Renderer::renderShearWarp");
+    const glm::vec3 viewDirection = glm::normalize(m_pCamera->forward());
+    const int axis = ShearWarpVolume::principalAxis(viewDirection);
+    std::optional<ShearWarpVolume>& shearWarpVolume = m_shearWarpVolumes[size_t(axis)];
+    if (!shearWarpVolume)
+        shearWarpVolume.emplace(*m_pVolume, m_pGradientVolume, m_tf1DTable, axis);
+    const glm::vec3 eye = m_pCamera->position();
+    if (!shearWarpVolume->canRender(eye))
+        return false;
 
-            // Get a color for the current pixel according to the current render mode.
-            glm::vec4 color {};
-            switch (m_config.renderMode) {
-            case RenderMode::RenderSlicer: {
-                color = traceRaySlice(ray, volumeCenter, planeNormal);
-                break;
-            }
-            case RenderMode::RenderMIP: {
-                color = traceRayMIP(ray, sampleStep);
-                break;
-            }
-            case RenderMode::RenderComposite: {
-                color = traceRayComposite(ray, sampleStep);
-                break;
-            }
-            case RenderMode::RenderIso: {
-                color = traceRayISO(ray, sampleStep);
-                break;
-            }
-            case RenderMode::RenderTF2D: {
-                color = traceRayTF2D(ray, sampleStep);
-                break;
-            }
-            };
-            // Write the resulting color to the screen.
-            fillColor(x, y, color);
+    // Consecutive slices are 1 / cos(angle to the principal axis) voxels apart along the view direction.
+    const float sampleDistance = 1.0f / std::abs(viewDirection[axis]);
+    const HeadlightShading* pShading = (m_config.volumeShading && m_pGradientVolume) ? &m_shading : nullptr;
+    const ShearWarpVolume::IntermediateImage image = shearWarpVolume->composite(eye, sampleDistance, pShading, m_frameArena);
 
-#if PARALLELISM == 1
+    const tbb::blocked_range2d<int> screenRange { 0, m_config.renderResolution.y, 0, m_config.renderResolution.x };
+    tbb::parallel_for(screenRange, [&](const tbb::blocked_range2d<int>& localRange) {
+        TRACE_SCOPE("Renderer::warpTile");
+        for (int y = std::begin(localRange.rows()); y != std::end(localRange.rows()); y++) {
+            for (int x = std::begin(localRange.cols()); x != std::end(localRange.cols()); x++) {
+                const glm::vec2 pixelPos = glm::vec2(x, y) / glm::vec2(m_config.renderResolution);
+                fillColor(x, y, shearWarpVolume->warp(image, m_pCamera->generateRay(pixelPos * 2.0f - 1.0f)));
+            }
         }
-    }
-});
-#else
+    });
+    return true;
+}
+
+// Show a (thick) slice through the volume, see MultiPlanarReformat.
+void Renderer::renderMPR()
+{
+    TRACE_SCOPE("Renderer::renderMPR");
+    const SlicePlane plane = slicePlane(*m_pVolume, m_config, *m_pCamera);
+    const std::vector<glm::vec2>& pixels = m_mpr.extract(*m_pVolume, plane, m_config.renderResolution, { m_config.slabThickness, m_config.slabMode });
+    tbb::parallel_for(tbb::blocked_range<int>(0, m_config.renderResolution.y), [&](const tbb::blocked_range<int>& rows) {
+        for (int y = rows.begin(); y != rows.end(); y++) {
+            for (int x = 0; x < m_config.renderResolution.x; x++) {
+                const glm::vec2 pixel = pixels[size_t(y) * size_t(m_config.renderResolution.x) + size_t(x)];
+                fillColor(x, y, glm::vec4(glm::vec3(pixel.x), pixel.y));
             }
         }
-#endif
+    });
 }
 
 // ======= DO NOT MODIFY THIS FUNCTION ========
@@ -175,8 +430,6 @@ glm::vec4 Renderer::traceRayMIP(const Ray& ray, float sampleStep) const
 // Use the bisectionAccuracy function (to be implemented) to get a more precise isosurface location between two steps.
 glm::vec4 Renderer::traceRayISO(const Ray& ray, float sampleStep) const
 {
-    static constexpr glm::vec3 isoColor { 0.8f, 0.8f, 0.2f };
-
     glm::vec3 samplePos = ray.origin + ray.tmin * ray.direction;
     const glm::vec3 increment = sampleStep * ray.direction;
     for (float t = ray.tmin; t <= ray.tmax; t += sampleStep, samplePos += increment) {
@@ -186,19 +439,32 @@ glm::vec4 Renderer::traceRayISO(const Ray& ray, float sampleStep) const
             float refinedT      = bisectionAccuracy(ray, t - sampleStep, t, m_config.isoValue);
             glm::vec3 finalPos  = ray.origin + (refinedT * ray.direction);
 
-            // Compute final colour value
-            if (m_config.volumeShading) {
-                const volume::GradientVoxel &localGradient  = m_pGradientVolume->getGradientInterpolate(finalPos);
-                glm::vec3 viewDirection                     = finalPos - m_pCamera->position();
-                glm::vec3 phongRes                          = computePhongShading(isoColor, localGradient, viewDirection, viewDirection);
-                return glm::vec4(phongRes, 1.0f);
-            } else { return glm::vec4(isoColor, 1.0f); }
+            return shadeIsoSurface(finalPos);
         }
     }
 
     return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 }
 
+// Color of the iso surface at the given position, shaded with the local gradient when volume shading is enabled.
+glm::vec4 Renderer::shadeIsoSurface(const glm::vec3& position) const
+{
+    // Only look up the gradient when it is used.
+    const volume::GradientVoxel gradient = m_config.volumeShading ? m_pGradientVolume->getGradientInterpolate(position) : volume::GradientVoxel {};
+    return shadeIsoSurface(position, gradient);
+}
+
+glm::vec4 Renderer::shadeIsoSurface(const glm::vec3& position, const volume::GradientVoxel& gradient) const
+{
+    static constexpr glm::vec3 isoColor { 0.8f, 0.8f, 0.2f };
+    if (!m_config.volumeShading)
+        return glm::vec4(isoColor, 1.0f);
+
+    // Use the camera position as the light position.
+    const glm::vec3 viewDirection = position - m_pCamera->position();
+    return glm::vec4(computePhongShading(isoColor, gradient, viewDirection, viewDirection), 1.0f);
+}
+
 // ======= TODO: IMPLEMENT ========
 // Given that the iso value lies somewhere between t0 and t1, find a t for which the value
 // closely matches the iso value (less than 0.01 difference). Add a limit to the number of
@@ -264,37 +530,44 @@ glm::vec3 Renderer::computePhongShading(const glm::vec3& color, const volume::Gr
     return ambient + diffuse + specular;
 }
 
+glm::vec4 Renderer::traceRayComposite(const Ray& ray, float sampleStep) const
+{
+    return m_pVolume->visit([&](const auto& voxels) { return traceRayComposite(voxels, ray, sampleStep); });
+}
+
 // ======= TODO: IMPLEMENT ========
 // In this function, implement 1D transfer function raycasting.
-// Use getTFValue to compute the color for a given volume value according to the 1D transfer function.
-glm::vec4 Renderer::traceRayComposite(const Ray& ray, float sampleStep) const {
+// The colors of the transfer function (the entries of getTFValue) are looked up premultiplied and with the opacity
+// corrected for the sample step in m_tf1DTable.
+template <typename T>
+glm::vec4 Renderer::traceRayComposite(const volume::VoxelGrid<T>& voxels, const Ray& ray, float sampleStep) const {
     glm::vec4 retColour         = glm::vec4(0.0f);
     float alpha                 = 0.0f;
     glm::vec3 samplePos         = ray.origin + (ray.tmin * ray.direction);
     const glm::vec3 increment   = sampleStep * ray.direction;
+    const bool skipEmpty        = m_pVolume->interpolationMode != volume::InterpolationMode::Cubic;
+    // The table is corrected for the sample step of render(); other steps are corrected per sample.
+    const bool correctOpacity   = sampleStep != m_tf1DTable.sampleStep();
+    const glm::vec3 cameraPos   = m_pCamera->position();
     for(float t = ray.tmin; t <= ray.tmax; t += sampleStep, samplePos += increment) {
-        float intValue      = m_pVolume->getSampleInterpolate(samplePos);
-        glm::vec4 TFVal     = getTFValue(intValue);
-        
-        // Extract the alpha value
-        float retAlpha  = TFVal.a;
-        TFVal.a         = 1.0f;
+        // Jump over bricks that are fully transparent under the current transfer function
+        if (skipEmpty && skipEmptySpace(m_occupancyTF1D, ray, sampleStep, t, samplePos) && t > ray.tmax) { break; }
+
+        float intValue      = sampleVolume(voxels, samplePos);
+        glm::vec4 TFVal     = m_tf1DTable.lookup(intValue);
+        if (TFVal.a <= 0.0f) { continue; }
+        if (correctOpacity) { TFVal = m_tf1DTable.correctOpacity(TFVal, sampleStep); }
         
-        // Phong shading for each sample point
-        if (m_config.volumeShading) {
-                glm::vec3 intrmCol(TFVal);
-                const volume::GradientVoxel &localGradient  = m_pGradientVolume->getGradientInterpolate(samplePos);
-                glm::vec3 viewDirection                     = samplePos - m_pCamera->position();
-                glm::vec3 phongRes                          = computePhongShading(intrmCol, localGradient, viewDirection, viewDirection);
-                TFVal                                       = glm::vec4(phongRes, 1.0f);
+        // Phong shading of the samples that contribute (shading is linear in the color so it may be applied to the
+        // premultiplied color); the gradient is only fetched for those samples
+        if (m_config.volumeShading && TFVal.a > minShadedOpacity) {
+                glm::vec3 viewDirection = glm::normalize(samplePos - cameraPos);
+                TFVal                   = glm::vec4(m_shading.shade(glm::vec3(TFVal), shadingNormal(samplePos), viewDirection), TFVal.a);
         } 
 
-        // Create the R*A, B*A, G*A, A vector
-        TFVal = retAlpha * TFVal;
-        
-        // Accumulate
+        // Accumulate the premultiplied (R*A, G*A, B*A, A) vector
         retColour   += (1.0f - alpha) * TFVal;
-        alpha       += (1.0f - alpha) * retAlpha;
+        alpha       += (1.0f - alpha) * TFVal.a;
 
         // EARLY TERMINATION
         if (alpha >= 1.0f) { break; }
@@ -303,6 +576,44 @@ glm::vec4 Renderer::traceRayComposite(const Ray& ray, float sampleStep) const {
     return retColour;
 }
 
+// Compositing from the pre-classified volume: a single fetch per sample (per voxel when interpolating), shaded with
+// the stored normals. Only valid for the sample step of render() for which the volume was classified.
+glm::vec4 Renderer::traceRayCompositeClassified(const Ray& ray, float sampleStep) const
+{
+    glm::vec4 color { 0.0f };
+    glm::vec3 samplePos = ray.origin + ray.tmin * ray.direction;
+    const glm::vec3 increment = sampleStep * ray.direction;
+    const bool nearestNeighbour = m_pVolume->interpolationMode == volume::InterpolationMode::NearestNeighbour;
+    const glm::vec3 cameraPosition = m_pCamera->position();
+    for (float t = ray.tmin; t <= ray.tmax; t += sampleStep, samplePos += increment) {
+        if (skipEmptySpace(m_occupancyTF1D, ray, sampleStep, t, samplePos) && t > ray.tmax)
+            break;
+
+        const ClassifiedVolume::Sample sample = nearestNeighbour ? m_classifiedVolume->sampleNearestNeighbour(samplePos) : m_classifiedVolume->sampleTriLinear(samplePos);
+        glm::vec4 sampleColor = sample.color;
+        if (m_config.volumeShading && sampleColor.a > minShadedOpacity) {
+            const glm::vec3 viewDirection = glm::normalize(samplePos - cameraPosition);
+            sampleColor = glm::vec4(m_shading.shade(glm::vec3(sampleColor), normalizeOrZero(sample.normal), viewDirection), sampleColor.a);
+        }
+
+        color += (1.0f - color.a) * sampleColor;
+        if (color.a >= 1.0f)
+            break;
+    }
+    return color;
+}
+
+// Unit gradient direction at the given position, interpolated like GradientVolume::getGradientInterpolate. Falls back
+// to the gradient volume when the normals are not available (traceRayComposite called outside of render()).
+glm::vec3 Renderer::shadingNormal(const glm::vec3& position) const
+{
+    if (!m_normalVolume)
+        return normalizeOrZero(m_pGradientVolume->getGradientInterpolate(position).dir);
+    if (m_pGradientVolume->interpolationMode == volume::InterpolationMode::NearestNeighbour)
+        return m_normalVolume->sampleNearestNeighbour(position);
+    return m_normalVolume->sampleTriLinear(position);
+}
+
 // ======= DO NOT MODIFY THIS FUNCTION ========
 // Looks up the color+opacity corresponding to the given volume value from the 1D tranfer function LUT (m_config.tfColorMap).
 // The value will initially range from (m_config.tfColorMapIndexStart) to (m_config.tfColorMapIndexStart + m_config.tfColorMapIndexRange) .
@@ -314,26 +625,35 @@ glm::vec4 Renderer::getTFValue(float val) const
     return m_config.tfColorMap[i];
 }
 
+glm::vec4 Renderer::traceRayTF2D(const Ray& ray, float sampleStep) const
+{
+    return m_pVolume->visit([&](const auto& voxels) { return traceRayTF2D(voxels, ray, sampleStep); });
+}
+
 // ======= TODO: IMPLEMENT ========
 // In this function, implement 2D transfer function raycasting.
-// Use the getTF2DOpacity function that you implemented to compute the opacity according to the 2D transfer function.
-glm::vec4 Renderer::traceRayTF2D(const Ray& ray, float sampleStep) const
+// TransferFunction2DTable::rasterize evaluates the triangle of the config (the same tent as getTF2DOpacity, which
+// the renderer no longer calls) together with any additional primitives into m_tf2DTable, such that every sample
+// costs a single table lookup. Returns the (premultiplied) entry with the highest opacity.
+template <typename T>
+glm::vec4 Renderer::traceRayTF2D(const volume::VoxelGrid<T>& voxels, const Ray& ray, float sampleStep) const
 {
-    float alpha = 0;
+    glm::vec4 color { 0.0f };
 
     glm::vec3 samplePos = ray.origin + ray.tmin * ray.direction;
     const glm::vec3 increment = sampleStep * ray.direction;
+    const bool skipEmpty = m_pVolume->interpolationMode != volume::InterpolationMode::Cubic;
     for (float t = ray.tmin; t <= ray.tmax; t += sampleStep, samplePos += increment) {
-        
-        float curOpacity = getTF2DOpacity(
-            m_pVolume->getSampleInterpolate(samplePos),
-            m_pGradientVolume->getGradientInterpolate(samplePos).magnitude);
+        // Jump over bricks in which the 2D transfer function is zero everywhere.
+        if (skipEmpty && skipEmptySpace(m_occupancyTF2D, ray, sampleStep, t, samplePos) && t > ray.tmax)
+            break;
 
-        alpha = glm::max(alpha, curOpacity);
+        const glm::vec4 tfColor = m_tf2DTable.lookup(
+            sampleVolume(voxels, samplePos),
+            m_pGradientVolume->getGradientInterpolate(samplePos).magnitude);
+        if (tfColor.a > color.a)
+            color = tfColor;
     }
-
-    auto color = m_config.TF2DColor;
-    color = color * alpha;
     return color;
 }
 
@@ -358,6 +678,249 @@ float Renderer::getTF2DOpacity(float intensity, float gradientMagnitude) const
     return 1 - ratioToMiddle;
 }
 
+// Sample the typed voxels with the interpolation mode of the volume. Cubic interpolation is only provided by the
+// Volume itself.
+template <typename T>
+float Renderer::sampleVolume(const volume::VoxelGrid<T>& voxels, const glm::vec3& position) const
+{
+    switch (m_pVolume->interpolationMode) {
+    case volume::InterpolationMode::NearestNeighbour:
+        return voxels.sampleNearestNeighbour(position);
+    case volume::InterpolationMode::Linear:
+        return voxels.sampleTriLinear(position);
+    default:
+        return m_pVolume->getSampleInterpolate(position);
+    }
+}
+
+// Advance t (and samplePos) to the first sample on the regular sample grid (tmin + k * sampleStep) that lies
+// outside of the empty region (see OccupancyGrid::skipEmptyRegion) containing samplePos. Repeats for consecutive
+// empty regions. Returns whether any samples were skipped. Skipping is exact: all skipped samples would have had
+// zero opacity.
+bool Renderer::skipEmptySpace(const OccupancyGrid& occupancyGrid, const Ray& ray, float sampleStep, float& t, glm::vec3& samplePos) const
+{
+    bool skipped = false;
+    while (t <= ray.tmax) {
+        const float tExit = occupancyGrid.skipEmptyRegion(ray, t, samplePos);
+        // Number of samples that lie inside of the empty region.
+        const float numSkipped = std::ceil((tExit - t) / sampleStep);
+        if (numSkipped < 1.0f)
+            break;
+        t += numSkipped * sampleStep;
+        samplePos = ray.origin + t * ray.direction;
+        skipped = true;
+    }
+    return skipped;
+}
+
+// Prepares the nearest neighbour traversal of a brick that the ray enters at tEnter. The bricks are visited front to
+// back, so the traversal of the previous brick continues into an adjacent brick (visiting the voxels on the boundary
+// only once); it restarts at tEnter when bricks in between were skipped.
+static void advanceVoxelTraversal(std::optional<VoxelTraversal>& cells, const volume::Volume& volume, const Ray& ray, float tEnter)
+{
+    if (!cells || cells->tExit() < tEnter)
+        cells.emplace(ray, tEnter, ray.tmax, volume.dims(), volume.indexer());
+}
+
+// MIP using the max octree. Nodes are visited front to back and any node whose maximum does not exceed the
+// running maximum is skipped since none of its samples can change the result. The ray terminates as soon as
+// the maximum of the whole volume has been found. The samples are taken at t = tmin + k * sampleStep like in
+// traceRayMIP; the result only differs where the accumulated t of traceRayMIP drifts past the last sample. This also
+// holds for nearest neighbour interpolation: rounding a sample position is cheaper than stepping a VoxelTraversal
+// through every voxel that the ray crosses, so only the iso surface search traverses voxels exactly.
+glm::vec4 Renderer::traceRayMIPOctree(const Ray& ray, float sampleStep) const
+{
+    return m_pVolume->visit([&](const auto& voxels) { return traceRayMIPOctree(voxels, ray, sampleStep); });
+}
+
+template <typename T>
+glm::vec4 Renderer::traceRayMIPOctree(const volume::VoxelGrid<T>& voxels, const Ray& ray, float sampleStep) const
+{
+    float maxVal = 0.0f;
+    traverseOctree(m_valueOctree, ray, [&](int level, const glm::ivec3&, const glm::vec2& range, float tEnter, float tExit) {
+        if (range.y <= maxVal)
+            return OctreeVisit::Skip;
+        if (level > 0)
+            return OctreeVisit::Descend;
+
+        // Samples on the boundary between two bricks may be taken twice, which does not change the maximum. The
+        // small margin prevents such samples from being missed due to rounding.
+        constexpr float margin = 1e-4f;
+        const float firstSample = std::ceil((std::max(tEnter - margin, ray.tmin) - ray.tmin) / sampleStep);
+        const float lastSample = std::floor((std::min(tExit + margin, ray.tmax) - ray.tmin) / sampleStep);
+        for (float k = firstSample; k <= lastSample; k++) {
+            const glm::vec3 samplePos = ray.origin + (ray.tmin + k * sampleStep) * ray.direction;
+            maxVal = std::max(maxVal, sampleVolume(voxels, samplePos));
+        }
+        return maxVal >= m_pVolume->maximum() ? OctreeVisit::Stop : OctreeVisit::Skip;
+    });
+
+    // Normalize the result to a range of [0 to mpVolume->maximum()].
+    return glm::vec4(glm::vec3(maxVal) / m_pVolume->maximum(), 1.0f);
+}
+
+// Returns the smallest s in [0, sEnd] at which the cubic polynomial c[0] + c[1] s + c[2] s^2 + c[3] s^3 is
+// non-negative. The polynomial is split into monotonic pieces at the roots of its derivative; the first piece
+// that ends non-negative contains the root, which is then refined with regula falsi.
+static std::optional<float> firstNonNegative(const std::array<float, 4>& c, float sEnd)
+{
+    const auto evaluate = [&](float s) { return c[0] + s * (c[1] + s * (c[2] + s * c[3])); };
+    if (c[0] >= 0.0f)
+        return 0.0f;
+
+    // Extrema: roots of 3 c[3] s^2 + 2 c[2] s + c[1], using the numerically stable form of the quadratic formula.
+    std::array<float, 3> splits { sEnd, sEnd, sEnd };
+    const float a = 3.0f * c[3], b = 2.0f * c[2];
+    if (a == 0.0f) {
+        if (b != 0.0f)
+            splits[0] = -c[1] / b;
+    } else if (const float discriminant = b * b - 4.0f * a * c[1]; discriminant >= 0.0f) {
+        const float q = -0.5f * (b + std::copysign(std::sqrt(discriminant), b));
+        splits[0] = q / a;
+        if (q != 0.0f)
+            splits[1] = c[1] / q;
+    }
+    for (float& split : splits)
+        split = std::isfinite(split) && split > 0.0f ? std::min(split, sEnd) : sEnd;
+    std::sort(std::begin(splits), std::end(splits));
+
+    float s0 = 0.0f, g0 = c[0];
+    for (const float split : splits) {
+        float s1 = split;
+        float g1 = evaluate(s1);
+        if (g1 >= 0.0f) {
+            // Illinois variant of regula falsi: g0 < 0 <= g1 and the polynomial is monotonic in between.
+            int side = 0;
+            for (int iteration = 0; iteration < 16 && s1 - s0 > 1e-5f; iteration++) {
+                const float s = (s0 * g1 - s1 * g0) / (g1 - g0);
+                const float g = evaluate(s);
+                if (g >= 0.0f) {
+                    s1 = s;
+                    g1 = g;
+                    if (side == 1)
+                        g0 *= 0.5f;
+                    side = 1;
+                } else {
+                    s0 = s;
+                    g0 = g;
+                    if (side == -1)
+                        g1 *= 0.5f;
+                    side = -1;
+                }
+            }
+            return s1;
+        }
+        s0 = s1;
+        g0 = g1;
+    }
+    return {};
+}
+
+// Iso surface rendering using the min/max octree. Nodes whose maximum is below the iso value are skipped and a
+// node whose minimum is at or above it is hit where the ray enters. Inside the remaining bricks the ray visits
+// every cell that it crosses and solves for the exact first crossing: the nearest neighbour value is constant
+// per voxel, and trilinear interpolation along a ray through a cell is a cubic polynomial in t. Unlike fixed-step
+// sampling this never misses surfaces that are thinner than the sample step. Cubic interpolation has no such
+// closed form and uses traceRayISO instead.
+glm::vec4 Renderer::traceRayISOOctree(const Ray& ray) const
+{
+    return m_pVolume->visit([&](const auto& voxels) { return traceRayISOOctree(voxels, ray); });
+}
+
+template <typename T>
+glm::vec4 Renderer::traceRayISOOctree(const volume::VoxelGrid<T>& voxels, const Ray& ray) const
+{
+    if (const auto t = findIsoSurfaceOctree(voxels, ray))
+        return shadeIsoSurface(ray.origin + *t * ray.direction);
+    return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+// Returns the distance along the ray of the first position at which the value is at least the iso value.
+std::optional<float> Renderer::findIsoSurfaceOctree(const Ray& ray) const
+{
+    return m_pVolume->visit([&](const auto& voxels) { return findIsoSurfaceOctree(voxels, ray); });
+}
+
+template <typename T>
+std::optional<float> Renderer::findIsoSurfaceOctree(const volume::VoxelGrid<T>& voxels, const Ray& ray) const
+{
+    const float isoValue = m_config.isoValue;
+    const glm::ivec3 maxVoxel = m_pVolume->dims() - 1;
+    const bool nearestNeighbour = m_pVolume->interpolationMode == volume::InterpolationMode::NearestNeighbour;
+
+    // Find the first cell crossing in [t0, t1] of a brick.
+    std::optional<VoxelTraversal> voxelCells;
+    const auto findInBrick = [&](float t0, float t1) -> std::optional<float> {
+        if (nearestNeighbour) {
+            advanceVoxelTraversal(voxelCells, *m_pVolume, ray, t0);
+            for (; !voxelCells->done() && voxelCells->tEnter() <= t1; voxelCells->next()) {
+                if (voxels[voxelCells->index()] >= isoValue)
+                    return voxelCells->tEnter();
+            }
+            return {};
+        }
+
+        for (CellTraversal cells { ray, t0, t1, 0.0f }; !cells.done(); cells.next()) {
+            // Rounding may put the ray just outside of the volume; the last cell also covers the upper boundary.
+            const glm::ivec3 cell = glm::clamp(cells.cell(), glm::ivec3(0), glm::max(maxVoxel - 1, 0));
+            const glm::ivec3 upper = glm::min(cell + 1, maxVoxel);
+            std::array<float, 8> corners;
+            for (int i = 0; i < 8; i++)
+                corners[size_t(i)] = voxels.voxel(i & 1 ? upper.x : cell.x, i & 2 ? upper.y : cell.y, i & 4 ? upper.z : cell.z);
+            if (*std::max_element(std::begin(corners), std::end(corners)) < isoValue)
+                continue;
+
+            // Trilinear interpolation at p(s) = entry + s * direction (in cell coordinates) is the sum of the corner
+            // values weighted by a product of three functions that are linear in s: x(s) or 1 - x(s) per axis.
+            const glm::vec3 entry = ray.origin + cells.tEnter() * ray.direction - glm::vec3(cell);
+            std::array<float, 4> coefficients { -isoValue, 0.0f, 0.0f, 0.0f };
+            for (int i = 0; i < 8; i++) {
+                glm::vec3 a, b;
+                for (int axis = 0; axis < 3; axis++) {
+                    const bool upperCorner = (i >> axis) & 1;
+                    a[axis] = upperCorner ? entry[axis] : 1.0f - entry[axis];
+                    b[axis] = upperCorner ? ray.direction[axis] : -ray.direction[axis];
+                }
+                const float value = corners[size_t(i)];
+                coefficients[0] += value * a.x * a.y * a.z;
+                coefficients[1] += value * (b.x * a.y * a.z + a.x * b.y * a.z + a.x * a.y * b.z);
+                coefficients[2] += value * (b.x * b.y * a.z + b.x * a.y * b.z + a.x * b.y * b.z);
+                coefficients[3] += value * b.x * b.y * b.z;
+            }
+            if (const auto s = firstNonNegative(coefficients, cells.tExit() - cells.tEnter()))
+                return cells.tEnter() + *s;
+        }
+        return {};
+    };
+
+    std::optional<float> tHit;
+    traverseOctree(m_valueOctree, ray, [&](int level, const glm::ivec3&, const glm::vec2& range, float tEnter, float tExit) {
+        if (range.y < isoValue)
+            return OctreeVisit::Skip;
+        if (range.x >= isoValue) {
+            tHit = tEnter;
+            return OctreeVisit::Stop;
+        }
+        if (level > 0)
+            return OctreeVisit::Descend;
+        tHit = findInBrick(tEnter, tExit);
+        return tHit ? OctreeVisit::Stop : OctreeVisit::Skip;
+    });
+    return tHit;
+}
+
+// Iso surface rendering by ray tracing the marching cubes mesh of the iso surface (built in updateCaches) instead
+// of searching the volume, shaded with the interpolated vertex normals. Meant for comparing frame times: the
+// mesh is only rebuilt when the iso value changes.
+glm::vec4 Renderer::traceRayIsoMesh(const Ray& ray) const
+{
+    const auto hit = m_isoSurfaceBVH->intersect(ray);
+    if (!hit)
+        return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    // The mesh normals point towards lower values, the opposite of the gradient.
+    return shadeIsoSurface(ray.origin + hit->t * ray.direction, volume::GradientVoxel { -hit->normal, glm::length(hit->normal) });
+}
+
 // This function computes if a ray intersects with the axis-aligned bounding box around the volume.
 // If the ray intersects then tmin/tmax are set to the distance at which the ray hits/exists the
 // volume and true is returned. If the ray misses the volume the the function returns false.
@@ -391,9 +954,21 @@ bool Renderer::instersectRayVolumeBounds(Ray& ray, const Bounds& bounds) const
 }
 
 // This function inserts a color into the framebuffer at position x,y
+// The color is converted to the framebuffer format here so that the reduced precision formats are written
+// directly by the render tiles (no separate conversion pass over the image).
 void Renderer::fillColor(int x, int y, const glm::vec4& color)
 {
     const size_t index = static_cast<size_t>(m_config.renderResolution.x * y + x);
-    m_frameBuffer[index] = color;
+    switch (m_config.frameBufferFormat) {
+    case FrameBufferFormat::RGBA8: {
+        m_frameBufferRGBA8[index] = glm::packUnorm<uint8_t>(color);
+    } break;
+    case FrameBufferFormat::RGBA16F: {
+        m_frameBufferRGBA16F[index] = glm::packHalf(color);
+    } break;
+    case FrameBufferFormat::RGBA32F: {
+        m_frameBuffer[index] = color;
+    } break;
+    };
 }
 }
\ No newline at end of file
@@ -1,16 +1,32 @@
 #pragma once
+#include "render/classified_volume.h"
+#include "render/frame_buffer_pool.h"
+#include "render/mpr.h"
+#include "render/occupancy_grid.h"
 #include "render/ray.h"
 #include "render/ray_trace_camera.h"
+#include "mesh/bvh.h"
 #include "render/render_config.h"
+#include "render/shading.h"
+#include "render/shear_warp.h"
+#include "render/transfer_function_1d.h"
+#include "render/transfer_function_2d.h"
+#include "util/arena.h"
+#include "volume/brick_min_max.h"
 #include "volume/gradient_volume.h"
+#include "volume/min_max_octree.h"
 #include "volume/volume.h"
-#include <cstring> // memcmp
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <glm/gtc/type_precision.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <gsl/span>
 #include <memory>
+#include <optional>
 #include <tuple>
 #include <vector>
 
@@ -26,21 +42,36 @@ union Bounds {
 
 class Renderer {
 public:
+    // The gradient volume may be nullptr (while it is still being computed). Until it is provided through
+    // setGradientVolume() render modes that require gradients fall back to MIP.
     Renderer(
         const volume::Volume* pVolume,
         const volume::GradientVolume* pGradientVolume,
         const render::RayTraceCamera* pCamera,
         const RenderConfig& config);
+    // The occupancy grids point into m_valueBricks of the same object, so a renderer can neither be copied nor moved.
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
 
     void setConfig(const RenderConfig& config);
+    void setGradientVolume(const volume::GradientVolume* pGradientVolume);
+    // Switch to another volume (e.g. the next time step of a sequence). The gradient volume may be nullptr.
+    void setVolume(const volume::Volume* pVolume, const volume::GradientVolume* pGradientVolume);
     void render();
-    gsl::span<const glm::vec4> frameBuffer() const;
+    // The framebuffer converted to RGBA32F, whatever the format in which it is stored.
+    std::vector<glm::vec4> frameBuffer() const;
+    gsl::span<const std::byte> frameBufferBytes() const;
+    FrameBufferFormat frameBufferFormat() const;
 
 protected:
     // These functions will be automatically tested.
     glm::vec4 traceRaySlice(const Ray& ray, const glm::vec3& volumeCenter, const glm::vec3& planeNormal) const;
     glm::vec4 traceRayMIP(const Ray& ray, float sampleStep) const;
+    glm::vec4 traceRayMIPOctree(const Ray& ray, float sampleStep) const;
     glm::vec4 traceRayISO(const Ray& ray, float sampleStep) const;
+    glm::vec4 traceRayISOOctree(const Ray& ray) const;
+    std::optional<float> findIsoSurfaceOctree(const Ray& ray) const;
+    glm::vec4 traceRayIsoMesh(const Ray& ray) const;
     glm::vec4 traceRayComposite(const Ray& ray, float sampleStep) const;
     glm::vec4 traceRayTF2D(const Ray& ray, float sampleStep) const;
 
@@ -58,12 +89,44 @@ protected:
                                          uint32_t specularPower = 100U);
 
 private:
-    void resizeImage(const glm::ivec2& resolution);
+    // Distance between two samples along a ray (in voxels) in render().
+    static constexpr float renderSampleStep = 1.0f;
+    // How long the 1D transfer function must be unchanged before PreClassification::Auto classifies the volume.
+    static constexpr std::chrono::milliseconds preClassificationDelay { 500 };
+    // Compositing only shades samples that are more opaque than this; fainter samples are composited unshaded.
+    static constexpr float minShadedOpacity = 1.0f / 1024.0f;
+
+    void resizeImage(const glm::ivec2& resolution, FrameBufferFormat format);
     void resetImage();
+    void updateCaches();
+    bool renderShearWarp();
+    void renderMPR();
 
     glm::vec4 getTFValue(float val) const;
     float getTF2DOpacity(float val, float gradientMagnitude) const;
 
+    // The render modes that take many samples are instantiated for every voxel type (see Volume::visit). The
+    // overloads without voxels dispatch on the voxel type once per ray, render() does so once per tile.
+    template <typename T>
+    float sampleVolume(const volume::VoxelGrid<T>& voxels, const glm::vec3& position) const;
+    template <typename T>
+    glm::vec4 traceRayMIPOctree(const volume::VoxelGrid<T>& voxels, const Ray& ray, float sampleStep) const;
+    template <typename T>
+    glm::vec4 traceRayISOOctree(const volume::VoxelGrid<T>& voxels, const Ray& ray) const;
+    template <typename T>
+    std::optional<float> findIsoSurfaceOctree(const volume::VoxelGrid<T>& voxels, const Ray& ray) const;
+    template <typename T>
+    glm::vec4 traceRayComposite(const volume::VoxelGrid<T>& voxels, const Ray& ray, float sampleStep) const;
+    template <typename T>
+    glm::vec4 traceRayTF2D(const volume::VoxelGrid<T>& voxels, const Ray& ray, float sampleStep) const;
+
+    glm::vec4 traceRayCompositeClassified(const Ray& ray, float sampleStep) const;
+    glm::vec3 shadingNormal(const glm::vec3& position) const;
+
+    glm::vec4 shadeIsoSurface(const glm::vec3& position) const;
+    glm::vec4 shadeIsoSurface(const glm::vec3& position, const volume::GradientVoxel& gradient) const;
+    bool skipEmptySpace(const OccupancyGrid& occupancyGrid, const Ray& ray, float sampleStep, float& t, glm::vec3& samplePos) const;
+
     bool instersectRayVolumeBounds(Ray& ray, const Bounds& volumeBounds) const;
     void fillColor(int x, int y, const glm::vec4& color);
 
@@ -72,8 +135,46 @@ protected:
     const volume::GradientVolume* m_pGradientVolume;
     const render::RayTraceCamera* m_pCamera;
     RenderConfig m_config;
+    // Parts of the config that changed since the derived data (caches) were last brought up to date.
+    RenderConfigChange m_dirty { RenderConfigChange::All };
+
+    // Empty space skipping for the compositing (1D) and 2D transfer function modes.
+    volume::BrickMinMax m_valueBricks;
+    volume::MinMaxOctree m_valueOctree;
+    std::optional<volume::BrickMinMax> m_magnitudeBricks; // Empty while there is no gradient volume.
+    OccupancyGrid m_occupancyTF1D;
+    OccupancyGrid m_occupancyTF2D;
+    // Premultiplied and opacity corrected 1D transfer function of the compositing mode.
+    TransferFunction1DTable m_tf1DTable;
+    // Pre-classified volume of the compositing mode; discarded when the 1D transfer function or the volume changes.
+    std::optional<ClassifiedVolume> m_classifiedVolume;
+    std::chrono::steady_clock::time_point m_tf1DChangeTime;
+    // Phong shading of the compositing mode and the (pre-normalized) normals that it uses; the normals are discarded
+    // when the gradient volume changes.
+    HeadlightShading m_shading;
+    std::optional<NormalVolume> m_normalVolume;
+    // Classified and transposed volumes of the shear-warp mode, indexed by the principal axis of the view. Each is
+    // built the first time that the view has that principal axis and kept until the transfer function changes or
+    // the mode is left (see ShearWarpVolume for the memory cost).
+    std::array<std::optional<ShearWarpVolume>, 3> m_shearWarpVolumes;
+    // Slices of the multi-planar reformat mode (with a cache of the recently viewed slices).
+    MultiPlanarReformat m_mpr;
+    // All primitives of the 2D transfer function rasterized over (value, gradient magnitude).
+    TransferFunction2DTable m_tf2DTable;
+    // Iso surface mesh of the RenderIsoMesh mode; built on demand and discarded when the iso value or volume changes.
+    std::optional<mesh::TriangleBVH> m_isoSurfaceBVH;
 
+    // Only the framebuffer matching m_config.frameBufferFormat is in use, the others are empty.
     std::vector<glm::vec4> m_frameBuffer;
+    std::vector<glm::u16vec4> m_frameBufferRGBA16F;
+    std::vector<glm::u8vec4> m_frameBufferRGBA8;
+    // Framebuffers of recently used resolutions (of the current format).
+    FrameBufferPool<glm::vec4> m_frameBufferPool;
+    FrameBufferPool<glm::u16vec4> m_frameBufferPoolRGBA16F;
+    FrameBufferPool<glm::u8vec4> m_frameBufferPoolRGBA8;
+
+    // Scratch memory for the duration of a single frame (released at the start of render()).
+    util::Arena m_frameArena;
 };
 
 }
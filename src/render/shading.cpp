@@ -0,0 +1,114 @@
+#include "shading.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace render {
+
+uint32_t packNormal(const glm::vec3& normal)
+{
+    const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    if (!(length > 0.0f))
+        return 0;
+    uint32_t packed = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        const int component = static_cast<int>(std::round(normal[axis] / length * 511.0f));
+        packed |= (static_cast<uint32_t>(component) & 0x3FF) << (10 * axis);
+    }
+    return packed;
+}
+
+glm::vec3 unpackNormal(uint32_t packed)
+{
+    // Move the 10 bits of the component to the top and sign extend them with an arithmetic shift.
+    const auto component = [&](int axis) { return static_cast<float>(static_cast<int32_t>(packed << (22 - 10 * axis)) >> 22) / 511.0f; };
+    return glm::vec3(component(0), component(1), component(2));
+}
+
+glm::vec3 normalizeOrZero(const glm::vec3& vector)
+{
+    const float lengthSquared = glm::dot(vector, vector);
+    return lengthSquared > 0.0f ? vector / std::sqrt(lengthSquared) : glm::vec3(0.0f);
+}
+
+NormalVolume::NormalVolume(const volume::Volume& volume, const volume::GradientVolume& gradientVolume)
+    : m_dim(volume.dims())
+    , m_indexer(volume.indexer())
+    , m_normals(volume.storageSize(), 0)
+{
+    TRACE_SCOPE("NormalVolume::NormalVolume");
+    tbb::parallel_for(tbb::blocked_range<int>(0, m_dim.z), [&](const tbb::blocked_range<int>& range) {
+        for (int z = range.begin(); z != range.end(); z++) {
+            for (int y = 0; y < m_dim.y; y++) {
+                for (int x = 0; x < m_dim.x; x++)
+                    m_normals[m_indexer(x, y, z)] = packNormal(gradientVolume.getGradient(x, y, z).dir);
+            }
+        }
+    });
+}
+
+glm::vec3 NormalVolume::sampleNearestNeighbour(const glm::vec3& coord) const
+{
+    if (coord.x < 0.0f || coord.y < 0.0f || coord.z < 0.0f || coord.x >= static_cast<float>(m_dim.x) || coord.y >= static_cast<float>(m_dim.y) || coord.z >= static_cast<float>(m_dim.z))
+        return glm::vec3(0.0f);
+
+    const glm::ivec3 voxel = glm::min(glm::ivec3(coord + 0.5f), m_dim - 1);
+    return normalizeOrZero(unpackNormal(m_normals[m_indexer(voxel.x, voxel.y, voxel.z)]));
+}
+
+glm::vec3 NormalVolume::sampleTriLinear(const glm::vec3& coord) const
+{
+    if (coord.x < 0.0f || coord.y < 0.0f || coord.z < 0.0f || coord.x >= static_cast<float>(m_dim.x) || coord.y >= static_cast<float>(m_dim.y) || coord.z >= static_cast<float>(m_dim.z))
+        return glm::vec3(0.0f);
+
+    const glm::ivec3 lower { coord };
+    const glm::ivec3 upper = glm::min(lower + 1, m_dim - 1);
+    const glm::vec3 fraction = coord - glm::vec3(lower);
+    glm::vec3 normal { 0.0f };
+    for (int corner = 0; corner < 8; corner++) {
+        float weight = 1.0f;
+        glm::ivec3 position;
+        for (int axis = 0; axis < 3; axis++) {
+            const bool isUpper = (corner >> axis) & 1;
+            position[axis] = isUpper ? upper[axis] : lower[axis];
+            weight *= isUpper ? fraction[axis] : 1.0f - fraction[axis];
+        }
+        normal += weight * unpackNormal(m_normals[m_indexer(position.x, position.y, position.z)]);
+    }
+    return normalizeOrZero(normal);
+}
+
+HeadlightShading::HeadlightShading(float kA, float kD, float kS, uint32_t specularPower)
+    : m_kA(kA)
+    , m_kD(kD)
+    , m_kS(kS)
+{
+    for (size_t i = 0; i < m_specularTable.size(); i++)
+        m_specularTable[i] = std::pow(static_cast<float>(i) / float(specularTableSize), static_cast<float>(specularPower));
+}
+
+glm::vec3 HeadlightShading::shade(const glm::vec3& color, const glm::vec3& normal, const glm::vec3& viewDirection) const
+{
+    const float diffuseDot = glm::dot(viewDirection, normal);
+    if (!(diffuseDot > 0.0f))
+        return m_kA * color;
+
+    // The light reflected around the normal is 2 * diffuseDot * normal - viewDirection.
+    const float specularDot = 2.0f * diffuseDot * diffuseDot - 1.0f;
+    const float specularTerm = specularDot > 0.0f ? m_kS * specular(specularDot) : 0.0f;
+    return (m_kA + m_kD * diffuseDot + specularTerm) * color;
+}
+
+// Linear interpolation between the table entries.
+float HeadlightShading::specular(float specularDot) const
+{
+    const float position = std::min(specularDot, 1.0f) * float(specularTableSize);
+    const int i = std::min(static_cast<int>(position), specularTableSize - 1);
+    const float fraction = position - float(i);
+    return m_specularTable[static_cast<size_t>(i)] + fraction * (m_specularTable[static_cast<size_t>(i + 1)] - m_specularTable[static_cast<size_t>(i)]);
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "volume/gradient_volume.h"
+#include "volume/volume.h"
+#include "volume/voxel_layout.h"
+#include <array>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <vector>
+
+namespace render {
+
+// A unit vector packed as three 10-bit signed normalized integers; the zero vector is packed as 0.
+uint32_t packNormal(const glm::vec3& normal);
+glm::vec3 unpackNormal(uint32_t packed);
+// The vector scaled to unit length, or the zero vector if it has no length.
+glm::vec3 normalizeOrZero(const glm::vec3& vector);
+
+// The gradient directions of a GradientVolume normalized ahead of time and packed into 4 bytes per voxel (a
+// quarter of a GradientVoxel). Sampled with the same rounding and bounds as GradientVolume::getGradientInterpolate;
+// voxels without a gradient (the border of the volume) have a zero normal.
+class NormalVolume {
+public:
+    NormalVolume(const volume::Volume& volume, const volume::GradientVolume& gradientVolume);
+
+    // Both return a unit normal or the zero vector.
+    glm::vec3 sampleNearestNeighbour(const glm::vec3& coord) const;
+    glm::vec3 sampleTriLinear(const glm::vec3& coord) const;
+
+private:
+    glm::ivec3 m_dim;
+    volume::VoxelIndexer m_indexer; // Same layout as the volume.
+    std::vector<uint32_t> m_normals;
+};
+
+// Renderer::computePhongShading with the light at the camera (lightDirection == viewDirection) for unit normals and
+// view directions. With the light at the camera the reflection angle follows from the diffuse term, and the
+// specular power is read from a table instead of being computed for every sample.
+class HeadlightShading {
+public:
+    HeadlightShading(float kA = 0.1f, float kD = 0.7f, float kS = 0.2f, uint32_t specularPower = 100);
+
+    // A zero normal only receives ambient light.
+    glm::vec3 shade(const glm::vec3& color, const glm::vec3& normal, const glm::vec3& viewDirection) const;
+
+private:
+    float specular(float specularDot) const;
+
+    static constexpr int specularTableSize = 1024;
+    float m_kA, m_kD, m_kS;
+    // specularDot^specularPower at specularDot = i / specularTableSize.
+    std::array<float, specularTableSize + 1> m_specularTable;
+};
+
+}
@@ -0,0 +1,271 @@
+#include "shear_warp.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace render {
+
+// Pixels of the intermediate image stop compositing once they are this opaque.
+static constexpr float opaqueAlpha = 0.99f;
+// Rows of the intermediate image that are composited together (through all slices) by one task.
+static constexpr int rowsPerTask = 8;
+
+// Volume axes of the u and v axes of the slices perpendicular to the principal axis; u is the x axis where possible
+// such that the transposition reads the volume in memory order.
+static glm::ivec2 sliceAxes(int principalAxis)
+{
+    switch (principalAxis) {
+    case 0:
+        return { 1, 2 };
+    case 1:
+        return { 0, 2 };
+    default:
+        return { 0, 1 };
+    }
+}
+
+ShearWarpVolume::ShearWarpVolume(const volume::Volume& volume, const volume::GradientVolume* pGradientVolume, const TransferFunction1DTable& tfTable, int principalAxis)
+    : m_axis(principalAxis)
+    , m_sliceAxes(sliceAxes(principalAxis))
+    , m_sampleStep(tfTable.sampleStep())
+{
+    TRACE_SCOPE("ShearWarpVolume::ShearWarpVolume");
+    const glm::ivec3 dim = volume.dims();
+    m_dim = glm::ivec3(dim[m_sliceAxes.x], dim[m_sliceAxes.y], dim[m_axis]);
+    const size_t numScanlines = size_t(m_dim.y) * size_t(m_dim.z);
+    m_voxels.resize(numScanlines * size_t(m_dim.x));
+    m_runOffsets.resize(numScanlines + 1, 0);
+
+    // Classify the slices in parallel; every slice collects its own runs (with offsets relative to the slice).
+    std::vector<std::vector<Run>> sliceRuns(size_t(m_dim.z));
+    volume.visit([&](const auto& voxels) {
+        tbb::parallel_for(tbb::blocked_range<int>(0, m_dim.z), [&](const tbb::blocked_range<int>& range) {
+            for (int slice = range.begin(); slice != range.end(); slice++) {
+                std::vector<Run>& runs = sliceRuns[size_t(slice)];
+                for (int v = 0; v < m_dim.y; v++) {
+                    const size_t scanline = size_t(slice) * size_t(m_dim.y) + size_t(v);
+                    int runBegin = -1;
+                    for (int u = 0; u < m_dim.x; u++) {
+                        glm::ivec3 position;
+                        position[m_sliceAxes.x] = u;
+                        position[m_sliceAxes.y] = v;
+                        position[m_axis] = slice;
+                        const glm::vec4 color = glm::clamp(tfTable.lookup(voxels.voxel(position.x, position.y, position.z)), 0.0f, 1.0f);
+                        const uint32_t normal = pGradientVolume ? packNormal(pGradientVolume->getGradient(position.x, position.y, position.z).dir) : 0;
+                        const ClassifiedVoxel classified { glm::u8vec4(color * 255.0f + 0.5f), normal };
+                        m_voxels[scanline * size_t(m_dim.x) + size_t(u)] = classified;
+
+                        if (classified.color.a > 0 && runBegin < 0) {
+                            runBegin = u;
+                        } else if (classified.color.a == 0 && runBegin >= 0) {
+                            runs.push_back({ runBegin, u });
+                            runBegin = -1;
+                        }
+                    }
+                    if (runBegin >= 0)
+                        runs.push_back({ runBegin, m_dim.x });
+                    m_runOffsets[scanline + 1] = uint32_t(runs.size());
+                }
+            }
+        });
+    });
+
+    for (size_t slice = 0; slice < sliceRuns.size(); slice++) {
+        const uint32_t sliceOffset = uint32_t(m_runs.size());
+        for (size_t v = 0; v < size_t(m_dim.y); v++)
+            m_runOffsets[slice * size_t(m_dim.y) + v + 1] += sliceOffset;
+        m_runs.insert(std::end(m_runs), std::begin(sliceRuns[slice]), std::end(sliceRuns[slice]));
+    }
+}
+
+int ShearWarpVolume::principalAxis(const glm::vec3& viewDirection)
+{
+    const glm::vec3 extent = glm::abs(viewDirection);
+    if (extent.x >= extent.y && extent.x >= extent.z)
+        return 0;
+    return extent.y >= extent.z ? 1 : 2;
+}
+
+int ShearWarpVolume::principalAxis() const
+{
+    return m_axis;
+}
+
+bool ShearWarpVolume::canRender(const glm::vec3& eye) const
+{
+    return eye[m_axis] < 0.0f || eye[m_axis] > float(m_dim.z - 1);
+}
+
+const ClassifiedVoxel& ShearWarpVolume::voxel(int u, int v, int slice) const
+{
+    return m_voxels[(size_t(slice) * size_t(m_dim.y) + size_t(v)) * size_t(m_dim.x) + size_t(u)];
+}
+
+gsl::span<const ShearWarpVolume::Run> ShearWarpVolume::scanlineRuns(int v, int slice) const
+{
+    const size_t scanline = size_t(slice) * size_t(m_dim.y) + size_t(v);
+    return gsl::span<const Run>(m_runs).subspan(m_runOffsets[scanline], m_runOffsets[scanline + 1] - m_runOffsets[scanline]);
+}
+
+ShearWarpVolume::IntermediateImage ShearWarpVolume::composite(const glm::vec3& eye, float sampleDistance, const HeadlightShading* pShading, util::Arena& arena) const
+{
+    TRACE_SCOPE("ShearWarpVolume::composite");
+    const glm::vec2 eyeUV { eye[m_sliceAxes.x], eye[m_sliceAxes.y] };
+    const float eyeSlice = eye[m_axis];
+    const int front = eyeSlice < 0.0f ? 0 : m_dim.z - 1;
+    const int back = eyeSlice < 0.0f ? m_dim.z - 1 : 0;
+    const int sliceStep = eyeSlice < 0.0f ? 1 : -1;
+    // The point p of a slice projects onto the front slice at eyeUV + (p - eyeUV) / scale, and the pixel at b of the
+    // intermediate image samples the slice at b * scale + eyeUV * (1 - scale).
+    const auto sliceScale = [&](int slice) { return (float(slice) - eyeSlice) / (float(front) - eyeSlice); };
+
+    // The projections of the slices shrink linearly (in 1 / scale) from the front slice to the back slice.
+    const glm::vec2 sliceUpper { m_dim.x - 1, m_dim.y - 1 };
+    const float backScale = sliceScale(back);
+    const glm::vec2 lower = glm::min(glm::vec2(0.0f), eyeUV - eyeUV / backScale);
+    const glm::vec2 upper = glm::max(sliceUpper, eyeUV + (sliceUpper - eyeUV) / backScale);
+    IntermediateImage image;
+    image.origin = glm::ivec2(glm::floor(lower));
+    image.size = glm::ivec2(glm::ceil(upper)) - image.origin + 1;
+    image.plane = float(front);
+    const size_t numPixels = size_t(image.size.x) * size_t(image.size.y);
+    image.pixels = arena.allocateArray<glm::vec4>(numPixels);
+    std::fill(std::begin(image.pixels), std::end(image.pixels), glm::vec4(0.0f));
+    // Per row: the first pixel at or after each pixel that is not opaque yet (plus one past the end).
+    const size_t rowLinks = size_t(image.size.x) + 1;
+    const gsl::span<int> links = arena.allocateArray<int>(rowLinks * size_t(image.size.y));
+
+    // The opacities were corrected for m_sampleStep; scale them (and the premultiplied colors) per voxel.
+    std::array<float, 256> opacityCorrection;
+    opacityCorrection[0] = 0.0f;
+    for (size_t alpha = 1; alpha < opacityCorrection.size(); alpha++) {
+        const float opacity = float(alpha) / 255.0f;
+        opacityCorrection[alpha] = (1.0f - std::pow(1.0f - opacity, sampleDistance / m_sampleStep)) / opacity;
+    }
+
+    tbb::parallel_for(tbb::blocked_range<int>(0, image.size.y, rowsPerTask), [&](const tbb::blocked_range<int>& rows) {
+        for (int row = rows.begin(); row != rows.end(); row++) {
+            const gsl::span<int> rowLink = links.subspan(size_t(row) * rowLinks, rowLinks);
+            for (size_t i = 0; i < rowLinks; i++)
+                rowLink[i] = int(i);
+        }
+
+        for (int slice = front; slice != back + sliceStep; slice += sliceStep) {
+            const float scale = sliceScale(slice);
+            const glm::vec2 offset = eyeUV * (1.0f - scale);
+            // Pixels of a row whose samples lie within the slice.
+            const int firstPixel = std::max(int(std::ceil(-offset.x / scale)) - image.origin.x, 0);
+            const int lastPixel = std::min(int(std::floor((sliceUpper.x - offset.x) / scale)) - image.origin.x, image.size.x - 1);
+
+            for (int row = rows.begin(); row != rows.end(); row++) {
+                const float sampleV = float(image.origin.y + row) * scale + offset.y;
+                if (sampleV < 0.0f || sampleV > sliceUpper.y)
+                    continue;
+                const int v0 = int(sampleV);
+                const int v1 = std::min(v0 + 1, m_dim.y - 1);
+                const float fractionV = sampleV - float(v0);
+                const gsl::span<int> rowLink = links.subspan(size_t(row) * rowLinks, rowLinks);
+                glm::vec4* pRow = &image.pixels[size_t(row) * size_t(image.size.x)];
+
+                const auto findPixel = [&](int pixel) {
+                    while (rowLink[size_t(pixel)] != pixel) {
+                        rowLink[size_t(pixel)] = rowLink[size_t(rowLink[size_t(pixel)])];
+                        pixel = rowLink[size_t(pixel)];
+                    }
+                    return pixel;
+                };
+                const auto compositeRun = [&](const Run& run) {
+                    // A sample between u - 1 and u reads voxel u, so the run affects samples in (begin - 1, end).
+                    const int begin = std::max(int(std::ceil((float(run.begin - 1) - offset.x) / scale)) - image.origin.x, firstPixel);
+                    const int end = std::min(int(std::floor((float(run.end) - offset.x) / scale)) - image.origin.x, lastPixel);
+                    for (int pixel = findPixel(begin); pixel <= end; pixel = findPixel(pixel + 1)) {
+                        const float sampleU = float(image.origin.x + pixel) * scale + offset.x;
+                        const int u0 = int(sampleU);
+                        const int u1 = std::min(u0 + 1, m_dim.x - 1);
+                        const float fractionU = sampleU - float(u0);
+
+                        glm::vec4 color { 0.0f };
+                        glm::vec3 normal { 0.0f };
+                        const auto addVoxel = [&](int u, int v, float weight) {
+                            const ClassifiedVoxel& classified = voxel(u, v, slice);
+                            if (classified.color.a == 0)
+                                return;
+                            color += (weight * opacityCorrection[classified.color.a]) * glm::vec4(classified.color);
+                            if (pShading)
+                                normal += weight * unpackNormal(classified.normal);
+                        };
+                        addVoxel(u0, v0, (1.0f - fractionU) * (1.0f - fractionV));
+                        addVoxel(u1, v0, fractionU * (1.0f - fractionV));
+                        addVoxel(u0, v1, (1.0f - fractionU) * fractionV);
+                        addVoxel(u1, v1, fractionU * fractionV);
+                        if (!(color.a > 0.0f))
+                            continue;
+                        color /= 255.0f;
+
+                        if (pShading) {
+                            glm::vec3 position;
+                            position[m_sliceAxes.x] = sampleU;
+                            position[m_sliceAxes.y] = sampleV;
+                            position[m_axis] = float(slice);
+                            color = glm::vec4(pShading->shade(glm::vec3(color), normalizeOrZero(normal), glm::normalize(position - eye)), color.a);
+                        }
+
+                        glm::vec4& accumulated = pRow[pixel];
+                        accumulated += (1.0f - accumulated.a) * color;
+                        if (accumulated.a >= opaqueAlpha)
+                            rowLink[size_t(pixel)] = pixel + 1;
+                    }
+                };
+
+                // Both scanlines share the u axis: visit the union of their runs in order.
+                const gsl::span<const Run> runs0 = scanlineRuns(v0, slice);
+                const gsl::span<const Run> runs1 = scanlineRuns(v1, slice);
+                size_t i0 = 0, i1 = 0;
+                while (i0 < runs0.size() || i1 < runs1.size()) {
+                    const bool takeFirst = i1 == runs1.size() || (i0 < runs0.size() && runs0[i0].begin <= runs1[i1].begin);
+                    Run run = takeFirst ? runs0[i0++] : runs1[i1++];
+                    while (true) {
+                        if (i0 < runs0.size() && runs0[i0].begin <= run.end)
+                            run.end = std::max(run.end, runs0[i0++].end);
+                        else if (i1 < runs1.size() && runs1[i1].begin <= run.end)
+                            run.end = std::max(run.end, runs1[i1++].end);
+                        else
+                            break;
+                    }
+                    compositeRun(run);
+                }
+            }
+        }
+    });
+    return image;
+}
+
+glm::vec4 ShearWarpVolume::warp(const IntermediateImage& image, const Ray& ray) const
+{
+    const float t = (image.plane - ray.origin[m_axis]) / ray.direction[m_axis];
+    const glm::vec3 point = ray.origin + t * ray.direction;
+    const glm::vec2 coord = glm::vec2(point[m_sliceAxes.x], point[m_sliceAxes.y]) - glm::vec2(image.origin);
+    // Also rejects NaN (rays parallel to the plane).
+    if (!(t > 0.0f && coord.x > -1.0f && coord.y > -1.0f && coord.x < float(image.size.x) && coord.y < float(image.size.y)))
+        return glm::vec4(0.0f);
+
+    // Bilinear interpolation with zero outside of the image.
+    const glm::ivec2 lower { glm::floor(coord) };
+    const glm::vec2 fraction = coord - glm::vec2(lower);
+    const auto pixel = [&](int x, int y) {
+        if (x < 0 || y < 0 || x >= image.size.x || y >= image.size.y)
+            return glm::vec4(0.0f);
+        return image.pixels[size_t(y) * size_t(image.size.x) + size_t(x)];
+    };
+    return glm::mix(
+        glm::mix(pixel(lower.x, lower.y), pixel(lower.x + 1, lower.y), fraction.x),
+        glm::mix(pixel(lower.x, lower.y + 1), pixel(lower.x + 1, lower.y + 1), fraction.x),
+        fraction.y);
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "render/classified_volume.h"
+#include "render/ray.h"
+#include "render/shading.h"
+#include "render/transfer_function_1d.h"
+#include "util/arena.h"
+#include "volume/gradient_volume.h"
+#include "volume/volume.h"
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <gsl/span>
+#include <vector>
+
+namespace render {
+
+// Object-order compositing by shear-warp factorization (Lacroute and Levoy, 1994). The volume is classified with the
+// 1D transfer function and transposed such that the slices perpendicular to the principal axis of the view are
+// stored one after the other, and the non-transparent voxels of every scanline are run-length encoded.
+//
+// composite() projects the slices front to back onto an intermediate image in the plane of the front slice (a
+// slice further away is scaled down for the perspective), one pixel per voxel of the front slice. Rows of the
+// intermediate image only read two scanlines of a slice, in memory order, and skip the transparent runs of those
+// scanlines as well as the pixels that are already opaque. warp() then resamples the intermediate image along the
+// rays of the final image.
+//
+// Memory: every voxel is stored as a ClassifiedVoxel (8 bytes) plus the runs, i.e. 4x the memory of a 16-bit volume
+// for one principal axis (64 GB at 2048^3). Building it takes a full pass over the volume, which stalls the frame in
+// which the view crosses over to another principal axis; the renderer keeps the volume of every axis that it has
+// built (up to 3 copies) until the transfer function changes, so that the stall only happens once per axis.
+class ShearWarpVolume {
+public:
+    ShearWarpVolume(const volume::Volume& volume, const volume::GradientVolume* pGradientVolume, const TransferFunction1DTable& tfTable, int principalAxis);
+
+    // The axis (0, 1 or 2) along which the view direction has its largest component.
+    static int principalAxis(const glm::vec3& viewDirection);
+    int principalAxis() const;
+    // The factorization requires the eye to lie in front of the first (or behind the last) slice.
+    bool canRender(const glm::vec3& eye) const;
+
+    struct IntermediateImage {
+        glm::ivec2 origin; // Of pixel (0, 0) in the plane of the front slice.
+        glm::ivec2 size;
+        float plane; // Coordinate of the front slice along the principal axis.
+        gsl::span<glm::vec4> pixels; // Premultiplied colors, row by row.
+    };
+    // Allocates the intermediate image from the (per frame) arena. Samples are sampleDistance voxels apart along the
+    // view direction; without shading the stored normals are not used.
+    IntermediateImage composite(const glm::vec3& eye, float sampleDistance, const HeadlightShading* pShading, util::Arena& arena) const;
+    glm::vec4 warp(const IntermediateImage& image, const Ray& ray) const;
+
+private:
+    struct Run {
+        int begin, end; // Non-transparent voxels [begin, end) of a scanline.
+    };
+    const ClassifiedVoxel& voxel(int u, int v, int slice) const;
+    gsl::span<const Run> scanlineRuns(int v, int slice) const;
+
+    int m_axis;
+    glm::ivec2 m_sliceAxes; // Volume axes of the u and v axes of a slice.
+    glm::ivec3 m_dim; // Along u, v and the principal axis.
+    float m_sampleStep; // For which the opacities of the transfer function were corrected.
+    std::vector<ClassifiedVoxel> m_voxels;
+    std::vector<Run> m_runs;
+    std::vector<uint32_t> m_runOffsets; // Runs [m_runOffsets[i], m_runOffsets[i + 1]) belong to scanline i.
+};
+
+}
@@ -0,0 +1,55 @@
+#include "transfer_function_1d.h"
+#include "util/trace.h"
+#include <cmath>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace render {
+
+// Opacity of a segment of length sampleStep when the given opacity holds for a segment of length one.
+static float correctedOpacity(float opacity, float sampleStep)
+{
+    return 1.0f - std::pow(1.0f - std::clamp(opacity, 0.0f, 1.0f), sampleStep);
+}
+
+TransferFunction1DTable::TransferFunction1DTable()
+    : m_entries(1, glm::vec4(0.0f))
+{
+}
+
+void TransferFunction1DTable::update(const RenderConfig& config, float sampleStep)
+{
+    TRACE_SCOPE("TransferFunction1DTable::update");
+    const auto& colorMap = config.tfColorMap;
+    m_entries.resize(std::max(colorMap.size(), size_t(1)), glm::vec4(0.0f));
+    m_indexStart = config.tfColorMapIndexStart;
+    m_indexScale = static_cast<float>(colorMap.size()) / config.tfColorMapIndexRange;
+    m_sampleStep = sampleStep;
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, colorMap.size(), 1024), [&](const tbb::blocked_range<size_t>& range) {
+        for (size_t i = range.begin(); i != range.end(); i++) {
+            const float opacity = correctedOpacity(colorMap[i].a, sampleStep);
+            m_entries[i] = glm::vec4(glm::vec3(colorMap[i]) * opacity, opacity);
+        }
+    });
+}
+
+glm::vec4 TransferFunction1DTable::correctOpacity(const glm::vec4& entry, float sampleStep) const
+{
+    if (entry.a <= 0.0f)
+        return entry;
+    const float opacity = correctedOpacity(entry.a, sampleStep / m_sampleStep);
+    return glm::vec4(glm::vec3(entry) * (opacity / entry.a), opacity);
+}
+
+gsl::span<const glm::vec4> TransferFunction1DTable::entries() const
+{
+    return m_entries;
+}
+
+float TransferFunction1DTable::sampleStep() const
+{
+    return m_sampleStep;
+}
+
+}
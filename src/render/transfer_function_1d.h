@@ -0,0 +1,45 @@
+#pragma once
+#include "render/render_config.h"
+#include <algorithm>
+#include <cstddef>
+#include <glm/vec4.hpp>
+#include <gsl/span>
+#include <vector>
+
+namespace render {
+
+// The 1D transfer function (RenderConfig::tfColorMap) prepared for compositing: the colors are premultiplied by
+// their opacity, and the opacity is corrected for the distance between two samples (the color map defines the
+// opacity of a segment of one voxel). The table has the resolution of the color map: the index range
+// [tfColorMapIndexStart, tfColorMapIndexStart + tfColorMapIndexRange) is divided into one interval per entry.
+class TransferFunction1DTable {
+public:
+    TransferFunction1DTable();
+
+    // Rebuild the table (in parallel) for rays that take a sample every sampleStep voxels.
+    void update(const RenderConfig& config, float sampleStep);
+
+    // Entry of the given value, clamped to the table. Monotonic in the value, so all values in [a, b] map to the
+    // entries [index(a), index(b)]; OccupancyGrid relies on that to find the entries of a brick.
+    size_t index(float value) const
+    {
+        return std::min(static_cast<size_t>(std::max((value - m_indexStart) * m_indexScale, 0.0f)), m_entries.size() - 1);
+    }
+    // Premultiplied color and corrected opacity of the given value.
+    glm::vec4 lookup(float value) const
+    {
+        return m_entries[index(value)];
+    }
+    gsl::span<const glm::vec4> entries() const;
+    // Corrects an entry of this table for another sample distance.
+    glm::vec4 correctOpacity(const glm::vec4& entry, float sampleStep) const;
+
+    float sampleStep() const;
+
+private:
+    std::vector<glm::vec4> m_entries;
+    float m_indexStart { 0.0f }, m_indexScale { 0.0f };
+    float m_sampleStep { 1.0f };
+};
+
+}
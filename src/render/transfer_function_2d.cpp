@@ -0,0 +1,110 @@
+#include "transfer_function_2d.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace render {
+
+static constexpr size_t numEntries = static_cast<size_t>(TransferFunction2DTable::resolution.x * TransferFunction2DTable::resolution.y);
+
+// Opacity weight in [0, 1] of a primitive at the given value and normalized gradient magnitude.
+static float primitiveWeight(const TF2DPrimitive& primitive, float value, float normalizedMagnitude)
+{
+    switch (primitive.shape) {
+    case TF2DShape::Triangle: {
+        const float halfWidth = primitive.halfSize.x * normalizedMagnitude;
+        if (halfWidth <= 0.0f)
+            return 0.0f;
+        return std::max(1.0f - std::abs(value - primitive.center.x) / halfWidth, 0.0f);
+    }
+    case TF2DShape::Box: {
+        const bool inside = std::abs(value - primitive.center.x) <= primitive.halfSize.x && std::abs(normalizedMagnitude - primitive.center.y) <= primitive.halfSize.y;
+        return inside ? 1.0f : 0.0f;
+    }
+    case TF2DShape::Gaussian: {
+        const glm::vec2 d = (glm::vec2(value, normalizedMagnitude) - primitive.center) / primitive.halfSize;
+        return std::exp(-0.5f * (d.x * d.x + d.y * d.y));
+    }
+    default:
+        return 0.0f;
+    }
+}
+
+TransferFunction2DTable::TransferFunction2DTable()
+    : m_entries(numEntries, glm::vec4(0.0f))
+    , m_visibleSum(static_cast<size_t>((resolution.x + 1) * (resolution.y + 1)), 0)
+{
+}
+
+void TransferFunction2DTable::rasterize(const RenderConfig& config, const glm::vec2& valueRange, const glm::vec2& magnitudeRange)
+{
+    TRACE_SCOPE("TransferFunction2DTable::rasterize");
+
+    std::vector<TF2DPrimitive> primitives { TF2DPrimitive { TF2DShape::Triangle, glm::vec2(config.TF2DIntensity, 0.0f), glm::vec2(config.TF2DRadius, 1.0f), config.TF2DColor } };
+    primitives.insert(std::end(primitives), std::begin(config.TF2DPrimitives), std::end(config.TF2DPrimitives));
+
+    // An empty range maps everything to the first row/column.
+    const glm::vec2 extent { valueRange.y - valueRange.x, magnitudeRange.y - magnitudeRange.x };
+    m_offset = glm::vec2(valueRange.x, magnitudeRange.x);
+    m_scale = glm::vec2(
+        extent.x > 0.0f ? float(resolution.x - 1) / extent.x : 0.0f,
+        extent.y > 0.0f ? float(resolution.y - 1) / extent.y : 0.0f);
+
+    tbb::parallel_for(tbb::blocked_range<int>(0, resolution.y), [&](const tbb::blocked_range<int>& range) {
+        for (int y = range.begin(); y != range.end(); y++) {
+            const float normalizedMagnitude = float(y) / float(resolution.y - 1);
+            for (int x = 0; x < resolution.x; x++) {
+                const float value = valueRange.x + extent.x * float(x) / float(resolution.x - 1);
+                glm::vec4 entry { 0.0f };
+                for (const TF2DPrimitive& primitive : primitives) {
+                    const glm::vec4 color = primitive.color * primitiveWeight(primitive, value, normalizedMagnitude);
+                    if (color.a > entry.a)
+                        entry = color;
+                }
+                m_entries[static_cast<size_t>(x + y * resolution.x)] = entry;
+            }
+        }
+    });
+
+    const size_t stride = static_cast<size_t>(resolution.x + 1);
+    for (size_t y = 0; y < size_t(resolution.y); y++) {
+        for (size_t x = 0; x < size_t(resolution.x); x++) {
+            const uint32_t visible = m_entries[x + y * size_t(resolution.x)].a > 0.0f ? 1 : 0;
+            m_visibleSum[(x + 1) + (y + 1) * stride] = visible + m_visibleSum[x + (y + 1) * stride] + m_visibleSum[(x + 1) + y * stride] - m_visibleSum[x + y * stride];
+        }
+    }
+}
+
+glm::vec2 TransferFunction2DTable::tableCoordinates(float value, float gradientMagnitude) const
+{
+    return glm::clamp((glm::vec2(value, gradientMagnitude) - m_offset) * m_scale, glm::vec2(0.0f), glm::vec2(resolution - 1));
+}
+
+glm::vec4 TransferFunction2DTable::lookup(float value, float gradientMagnitude) const
+{
+    const glm::vec2 coordinates = tableCoordinates(value, gradientMagnitude);
+    const int x = std::min(static_cast<int>(coordinates.x), resolution.x - 2);
+    const int y = std::min(static_cast<int>(coordinates.y), resolution.y - 2);
+    const glm::vec2 fraction = coordinates - glm::vec2(x, y);
+
+    const glm::vec4* pEntry = &m_entries[static_cast<size_t>(x + y * resolution.x)];
+    const glm::vec4 bottom = glm::mix(pEntry[0], pEntry[1], fraction.x);
+    const glm::vec4 top = glm::mix(pEntry[resolution.x], pEntry[resolution.x + 1], fraction.x);
+    return glm::mix(bottom, top, fraction.y);
+}
+
+bool TransferFunction2DTable::isVisible(const glm::vec2& valueRange, const glm::vec2& magnitudeRange) const
+{
+    // Bilinear interpolation is non-zero only between entries of which at least one is non-zero.
+    const glm::vec2 lower = tableCoordinates(valueRange.x, magnitudeRange.x);
+    const glm::vec2 upper = tableCoordinates(valueRange.y, magnitudeRange.y);
+    const size_t x0 = static_cast<size_t>(std::floor(lower.x)), x1 = static_cast<size_t>(std::ceil(upper.x)) + 1;
+    const size_t y0 = static_cast<size_t>(std::floor(lower.y)), y1 = static_cast<size_t>(std::ceil(upper.y)) + 1;
+    const size_t stride = static_cast<size_t>(resolution.x + 1);
+    return m_visibleSum[x1 + y1 * stride] + m_visibleSum[x0 + y0 * stride] != m_visibleSum[x0 + y1 * stride] + m_visibleSum[x1 + y0 * stride];
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "render/render_config.h"
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+namespace render {
+
+// The 2D transfer function (all primitives of a RenderConfig) rasterized into a table over (voxel value, gradient
+// magnitude), such that the raymarcher does a single bilinear lookup per sample no matter how many primitives
+// there are. An entry holds the color of the primitive with the highest opacity at that point, premultiplied by
+// the opacity weight of that primitive (so the triangle gives TF2DColor * tent).
+class TransferFunction2DTable {
+public:
+    // Entries lie on a regular grid that includes both ends of the value and the magnitude range.
+    static constexpr glm::ivec2 resolution { 256, 128 };
+
+    TransferFunction2DTable();
+
+    // The table covers the values in valueRange and the gradient magnitudes in magnitudeRange.
+    void rasterize(const RenderConfig& config, const glm::vec2& valueRange, const glm::vec2& magnitudeRange);
+
+    // Bilinearly interpolated entry; values and magnitudes outside of the table are clamped.
+    glm::vec4 lookup(float value, float gradientMagnitude) const;
+    // Whether the opacity may be non-zero for any combination of a value and a magnitude in the given ranges.
+    bool isVisible(const glm::vec2& valueRange, const glm::vec2& magnitudeRange) const;
+
+private:
+    glm::vec2 tableCoordinates(float value, float gradientMagnitude) const;
+
+    std::vector<glm::vec4> m_entries; // Stored as m_entries[x + y * resolution.x].
+    // Summed area table of the entries with non-zero opacity; (resolution.x + 1) * (resolution.y + 1) elements.
+    std::vector<uint32_t> m_visibleSum;
+    glm::vec2 m_offset { 0.0f }, m_scale { 0.0f }; // Table coordinates = ((value, magnitude) - offset) * scale.
+};
+
+}
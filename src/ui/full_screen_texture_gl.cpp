@@ -1,12 +1,22 @@
 #include "ui/full_screen_texture_gl.h"
 #include "opengl.h"
 #include "ui/gl_error.h"
+#include "util/trace.h"
+#include <cstring>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/vec3.hpp>
 
+struct TextureFormatGL {
+    GLint internalFormat;
+    GLenum format, type;
+    size_t bytesPerPixel;
+};
+static TextureFormatGL getTextureFormat(render::FrameBufferFormat format);
+
 namespace ui {
 
 FullScreenTextureGL::FullScreenTextureGL()
+    : m_persistentMapping(GLEW_ARB_buffer_storage)
 {
     // Generate texture
     glGenTextures(1, &m_texture);
@@ -72,6 +82,7 @@ FullScreenTextureGL::FullScreenTextureGL()
 
 FullScreenTextureGL::~FullScreenTextureGL()
 {
+    releasePixelBuffers();
     glDeleteTextures(1, &m_texture);
     glDeleteVertexArrays(1, &m_vao);
     glDeleteBuffers(1, &m_vbo);
@@ -80,14 +91,115 @@ FullScreenTextureGL::~FullScreenTextureGL()
 
 void FullScreenTextureGL::update(gsl::span<const glm::vec3> frameBuffer, const glm::ivec2& resolution)
 {
+    TRACE_SCOPE("FullScreenTextureGL::update");
     glBindTexture(GL_TEXTURE_2D, m_texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, resolution.x, resolution.y, 0, GL_RGB, GL_FLOAT, frameBuffer.data());
+    // Texture storage was replaced; make sure that the next RGBA upload reallocates it.
+    m_textureResolution = glm::ivec2(0);
 }
 
 void FullScreenTextureGL::update(gsl::span<const glm::vec4> frameBuffer, const glm::ivec2& resolution)
 {
+    update(gsl::as_bytes(frameBuffer), resolution, render::FrameBufferFormat::RGBA32F);
+}
+
+// Upload the framebuffer through a pixel buffer object. The texture storage is only (re)allocated when the
+// resolution or format changes; every other frame is a memcpy into a mapped buffer followed by an asynchronous
+// glTexSubImage2D.
+void FullScreenTextureGL::update(gsl::span<const std::byte> frameBuffer, const glm::ivec2& resolution, render::FrameBufferFormat format)
+{
+    TRACE_SCOPE("FullScreenTextureGL::update");
+    const TextureFormatGL formatGL = getTextureFormat(format);
+    const size_t numBytes = size_t(resolution.x) * size_t(resolution.y) * formatGL.bytesPerPixel;
+    if (numBytes == 0 || frameBuffer.size() < numBytes)
+        return;
+
+    if (resolution != m_textureResolution || format != m_textureFormat)
+        allocateTexture(resolution, format);
+    if (numBytes > m_pixelBufferSize)
+        allocatePixelBuffers(numBytes);
+
+    // Wait until the GPU has finished reading from the buffer that we are about to overwrite. With a ring of
+    // three buffers this practically never blocks.
+    m_currentPixelBuffer = (m_currentPixelBuffer + 1) % numPixelBuffers;
+    GLsync& fence = m_pixelBufferFences[m_currentPixelBuffer];
+    if (fence) {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffers[m_currentPixelBuffer]);
+    if (m_persistentMapping) {
+        std::memcpy(m_mappedPixelBuffers[m_currentPixelBuffer], frameBuffer.data(), numBytes);
+    } else {
+        // Orphan the old storage so that the driver does not have to synchronize with pending transfers.
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(m_pixelBufferSize), nullptr, GL_STREAM_DRAW);
+        void* pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(numBytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (pMapped) {
+            std::memcpy(pMapped, frameBuffer.data(), numBytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+    }
+
     glBindTexture(GL_TEXTURE_2D, m_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, resolution.x, resolution.y, 0, GL_RGBA, GL_FLOAT, frameBuffer.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, resolution.x, resolution.y, formatGL.format, formatGL.type, nullptr);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void FullScreenTextureGL::allocateTexture(const glm::ivec2& resolution, render::FrameBufferFormat format)
+{
+    const TextureFormatGL formatGL = getTextureFormat(format);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, formatGL.internalFormat, resolution.x, resolution.y, 0, formatGL.format, formatGL.type, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_textureResolution = resolution;
+    m_textureFormat = format;
+}
+
+// (Re)create the ring of pixel buffers. Buffers grow to the largest frame seen so far and are never shrunk
+// so that dynamic resolution changes during interaction do not cause reallocations.
+void FullScreenTextureGL::allocatePixelBuffers(size_t size)
+{
+    releasePixelBuffers();
+
+    m_pixelBufferSize = size;
+    glGenBuffers(GLsizei(numPixelBuffers), m_pixelBuffers.data());
+    for (size_t i = 0; i < numPixelBuffers; i++) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffers[i]);
+        if (m_persistentMapping) {
+            constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(size), nullptr, flags);
+            m_mappedPixelBuffers[i] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(size), flags);
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(size), nullptr, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void FullScreenTextureGL::releasePixelBuffers()
+{
+    for (size_t i = 0; i < numPixelBuffers; i++) {
+        if (m_pixelBufferFences[i]) {
+            glDeleteSync(m_pixelBufferFences[i]);
+            m_pixelBufferFences[i] = nullptr;
+        }
+        if (m_mappedPixelBuffers[i]) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffers[i]);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            m_mappedPixelBuffers[i] = nullptr;
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (m_pixelBufferSize > 0)
+        glDeleteBuffers(GLsizei(numPixelBuffers), m_pixelBuffers.data());
+    m_pixelBuffers = {};
+    m_pixelBufferSize = 0;
 }
 
 void FullScreenTextureGL::draw()
@@ -105,3 +217,16 @@ void FullScreenTextureGL::draw()
 }
 
 }
+
+static TextureFormatGL getTextureFormat(render::FrameBufferFormat format)
+{
+    switch (format) {
+    case render::FrameBufferFormat::RGBA8:
+        return { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 };
+    case render::FrameBufferFormat::RGBA16F:
+        return { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8 };
+    case render::FrameBufferFormat::RGBA32F:
+    default:
+        return { GL_RGBA32F, GL_RGBA, GL_FLOAT, 16 };
+    };
+}
@@ -1,5 +1,8 @@
 #pragma once
+#include "render/render_config.h"
 #include "ui/window.h"
+#include <array>
+#include <cstddef>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
@@ -14,11 +17,32 @@ public:
 
     void update(gsl::span<const glm::vec3> frameBuffer, const glm::ivec2& resolution);
     void update(gsl::span<const glm::vec4> frameBuffer, const glm::ivec2& resolution);
+    void update(gsl::span<const std::byte> frameBuffer, const glm::ivec2& resolution, render::FrameBufferFormat format);
     void draw();
 
+private:
+    void allocateTexture(const glm::ivec2& resolution, render::FrameBufferFormat format);
+    void allocatePixelBuffers(size_t size);
+    void releasePixelBuffers();
+
 private:
     GLuint m_texture;
     GLuint m_vbo, m_vao;
     GLuint m_shader;
+
+    // Resolution / format of the storage currently allocated for m_texture.
+    glm::ivec2 m_textureResolution { 0 };
+    render::FrameBufferFormat m_textureFormat { render::FrameBufferFormat::RGBA32F };
+
+    // Ring of pixel unpack buffers. When GL_ARB_buffer_storage is available they are persistently mapped,
+    // otherwise they are orphaned and mapped every upload. A fence per buffer prevents overwriting a buffer
+    // that the GPU is still copying from.
+    static constexpr size_t numPixelBuffers = 3;
+    bool m_persistentMapping;
+    size_t m_pixelBufferSize { 0 };
+    size_t m_currentPixelBuffer { 0 };
+    std::array<GLuint, numPixelBuffers> m_pixelBuffers {};
+    std::array<void*, numPixelBuffers> m_mappedPixelBuffers {};
+    std::array<GLsync, numPixelBuffers> m_pixelBufferFences {};
 };
 }
@@ -0,0 +1,94 @@
+#include "histogram_image.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <utility>
+
+namespace ui {
+
+// Source bins [begin, end) that are merged into destination bin i when numSource bins are re-binned to numDest
+// bins. When there are fewer source than destination bins, a source bin is repeated over multiple destination bins.
+static std::pair<size_t, size_t> sourceBins(size_t i, size_t numSource, size_t numDest)
+{
+    const size_t begin = i * numSource / numDest;
+    const size_t end = std::max((i + 1) * numSource / numDest, begin + 1);
+    return { begin, end };
+}
+
+// Maps a count to [0, 1] on a log scale; zero maps to zero and maxCount to one.
+static auto logScale(int64_t maxCount)
+{
+    const float factor = maxCount > 0 ? 1.0f / std::log1p(static_cast<float>(maxCount)) : 0.0f;
+    return [=](int64_t count) { return std::log1p(static_cast<float>(count)) * factor; };
+}
+
+std::vector<glm::u8vec4> createHistogramImage(gsl::span<const int> histogram, float maxValue, const glm::ivec2& resolution, float opacity)
+{
+    TRACE_SCOPE("createHistogramImage");
+    const size_t width = static_cast<size_t>(resolution.x);
+    const size_t height = static_cast<size_t>(resolution.y);
+    // Bin i of the volume histogram counts the voxels with a value in [i, i + 1).
+    const size_t numBins = std::clamp(static_cast<size_t>(std::max(maxValue, 0.0f)) + 1, size_t(1), histogram.size());
+
+    std::vector<int64_t> columns(width);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, width), [&](const tbb::blocked_range<size_t>& range) {
+        for (size_t x = range.begin(); x != range.end(); x++) {
+            const auto [begin, end] = sourceBins(x, numBins, width);
+            columns[x] = std::accumulate(std::begin(histogram) + static_cast<ptrdiff_t>(begin), std::begin(histogram) + static_cast<ptrdiff_t>(end), int64_t(0));
+        }
+    });
+
+    // Leave some room above the highest bar.
+    const auto scale = logScale(*std::max_element(std::begin(columns), std::end(columns)));
+    std::vector<float> barHeights(width);
+    std::transform(std::begin(columns), std::end(columns), std::begin(barHeights), [&](int64_t count) { return scale(count) * static_cast<float>(height) / 1.1f; });
+
+    const glm::u8vec4 barColor { 255, 255, 255, static_cast<uint8_t>(std::clamp(opacity, 0.0f, 1.0f) * 255.0f + 0.5f) };
+    std::vector<glm::u8vec4> image(width * height);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, height), [&](const tbb::blocked_range<size_t>& range) {
+        for (size_t y = range.begin(); y != range.end(); y++) {
+            const float rowHeight = static_cast<float>(height - y);
+            for (size_t x = 0; x < width; x++)
+                image[x + y * width] = rowHeight < barHeights[x] ? barColor : glm::u8vec4(0);
+        }
+    });
+    return image;
+}
+
+std::vector<glm::u8vec4> createHistogramImage(const volume::Histogram2D& histogram, const glm::ivec2& resolution)
+{
+    TRACE_SCOPE("createHistogramImage2D");
+    const size_t width = static_cast<size_t>(resolution.x);
+    const size_t height = static_cast<size_t>(resolution.y);
+    const size_t sourceWidth = static_cast<size_t>(histogram.resolution.x);
+    const size_t sourceHeight = static_cast<size_t>(histogram.resolution.y);
+
+    std::vector<int64_t> counts(width * height);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, height), [&](const tbb::blocked_range<size_t>& range) {
+        for (size_t y = range.begin(); y != range.end(); y++) {
+            // Flip vertically such that the highest gradient magnitude ends up at the top.
+            const auto [beginY, endY] = sourceBins(height - 1 - y, sourceHeight, height);
+            for (size_t x = 0; x < width; x++) {
+                const auto [beginX, endX] = sourceBins(x, sourceWidth, width);
+                int64_t count = 0;
+                for (size_t sourceY = beginY; sourceY < endY; sourceY++) {
+                    const auto row = std::begin(histogram.bins) + static_cast<ptrdiff_t>(sourceY * sourceWidth);
+                    count = std::accumulate(row + static_cast<ptrdiff_t>(beginX), row + static_cast<ptrdiff_t>(endX), count);
+                }
+                counts[x + y * width] = count;
+            }
+        }
+    });
+
+    const auto scale = logScale(*std::max_element(std::begin(counts), std::end(counts)));
+    std::vector<glm::u8vec4> image(width * height);
+    std::transform(std::begin(counts), std::end(counts), std::begin(image),
+        [&](int64_t count) { return glm::u8vec4(255, 255, 255, static_cast<uint8_t>(scale(count) * 255.0f + 0.5f)); });
+    return image;
+}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "volume/gradient_volume.h"
+#include <glm/gtc/type_precision.hpp>
+#include <glm/vec2.hpp>
+#include <gsl/span>
+#include <vector>
+
+namespace ui {
+
+// Background images of the transfer function widgets. The histograms are re-binned to the resolution of the
+// widget canvas (so memory and work do not depend on the value range of the volume) and counts are log-scaled
+// such that small features remain visible next to the large background peak. Images are RGBA8, row 0 at the top.
+
+// Bar chart of the value histogram (volume::Volume::histogram()) over the values [0, maxValue].
+std::vector<glm::u8vec4> createHistogramImage(gsl::span<const int> histogram, float maxValue, const glm::ivec2& resolution, float opacity);
+// Joint (value, gradient magnitude) histogram with the magnitude increasing upwards; the count sets the opacity.
+std::vector<glm::u8vec4> createHistogramImage(const volume::Histogram2D& histogram, const glm::ivec2& resolution);
+
+}
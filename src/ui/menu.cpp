@@ -1,5 +1,7 @@
 #include "menu.h"
 #include "render/renderer.h"
+#include "util/trace.h"
+#include <array>
 #include <filesystem>
 #include <fmt/format.h>
 #include <imgui.h>
@@ -10,6 +12,9 @@
 namespace ui {
 
 const std::filesystem::path DATA_PATH = RESOURCES_DIR;
+const std::filesystem::path TRACE_PATH = "volvis_trace.json";
+const std::filesystem::path ISO_SURFACE_PLY_PATH = "volvis_isosurface.ply";
+const std::filesystem::path ISO_SURFACE_OBJ_PATH = "volvis_isosurface.obj";
 std::string currentFileName = "FLD File";
 
 Menu::Menu(const glm::ivec2& baseRenderResolution)
@@ -33,7 +38,12 @@ void Menu::setInterpolationModeChangedCallback(InterpolationModeChangedCallback&
     m_optInterpolationModeChangedCallback = std::move(callback);
 }
 
-render::RenderConfig Menu::renderConfig() const
+void Menu::setExportIsoSurfaceCallback(ExportIsoSurfaceCallback&& callback)
+{
+    m_optExportIsoSurfaceCallback = std::move(callback);
+}
+
+const render::RenderConfig& Menu::renderConfig() const
 {
     return m_renderConfig;
 }
@@ -43,6 +53,16 @@ volume::InterpolationMode Menu::interpolationMode() const
     return m_interpolationMode;
 }
 
+volume::VoxelLayout Menu::voxelLayout() const
+{
+    return m_voxelLayout;
+}
+
+util::NumaPlacement Menu::numaPlacement() const
+{
+    return m_numaPlacement;
+}
+
 void Menu::setBaseRenderResolution(const glm::ivec2& baseRenderResolution)
 {
     m_baseRenderResolution = baseRenderResolution;
@@ -51,22 +71,68 @@ void Menu::setBaseRenderResolution(const glm::ivec2& baseRenderResolution)
 }
 
 // This function handles a part of the volume loading where we create the widget histograms, set some config values
-//  and set the menu volume information
-void Menu::setLoadedVolume(const volume::Volume& volume, const volume::GradientVolume& gradientVolume)
+//  and set the menu volume information. The 2D transfer function widget is created once the gradients are
+//  available (see setLoadedGradientVolume).
+void Menu::setLoadedVolume(const volume::Volume& volume)
 {
     m_tfWidget = TransferFunctionWidget(volume);
-    m_tf2DWidget = TransferFunction2DWidget(volume, gradientVolume);
+    m_tf2DWidget.reset();
 
     m_tfWidget->updateRenderConfig(m_renderConfig);
-    m_tf2DWidget->updateRenderConfig(m_renderConfig);
 
+    static constexpr std::array<const char*, 4> voxelTypeNames { "8-bit", "16-bit", "half float", "float" };
     const glm::ivec3 dim = volume.dims();
-    m_volumeInfo = fmt::format("Volume info:\n{}\nDimensions: ({}, {}, {})\nVoxel value range: {} - {}\n",
-        volume.fileName(), dim.x, dim.y, dim.z, volume.minimum(), volume.maximum());
+    m_volumeInfo = fmt::format("Volume info:\n{}\nDimensions: ({}, {}, {})\nVoxel type: {}\nVoxel value range: {} - {}\n",
+        volume.fileName(), dim.x, dim.y, dim.z, voxelTypeNames[size_t(volume.voxelType())], volume.minimum(), volume.maximum());
     m_volumeMax = int(volume.maximum());
     m_volumeLoaded = true;
 }
 
+void Menu::setLoadedGradientVolume(const volume::Volume& volume, const volume::GradientVolume& gradientVolume)
+{
+    m_tf2DWidget = TransferFunction2DWidget(volume, gradientVolume);
+    m_tf2DWidget->updateRenderConfig(m_renderConfig);
+}
+
+void Menu::setLoadProgress(std::string_view stage, float progress)
+{
+    m_loading = true;
+    m_loadStage = stage;
+    m_loadProgress = progress;
+}
+
+void Menu::clearLoadProgress()
+{
+    m_loading = false;
+}
+
+void Menu::setSequenceLength(size_t numFrames)
+{
+    m_sequenceLength = int(numFrames);
+    m_sequenceFrame = 0;
+    m_playing = false;
+}
+
+void Menu::setSequenceFrame(int frame)
+{
+    m_sequenceFrame = frame;
+}
+
+int Menu::sequenceFrame() const
+{
+    return m_sequenceFrame;
+}
+
+bool Menu::isPlaying() const
+{
+    return m_playing;
+}
+
+float Menu::playbackFps() const
+{
+    return m_playbackFps;
+}
+
 // This function draws the menu
 void Menu::drawMenu(const glm::ivec2& pos, const glm::ivec2& size, std::chrono::duration<double> renderTime)
 {
@@ -78,14 +144,15 @@ void Menu::drawMenu(const glm::ivec2& pos, const glm::ivec2& size, std::chrono::
     ImGui::BeginTabBar("VolVisTabs");
     showLoadVolTab();
     if (m_volumeLoaded) {
-        const auto renderConfigBefore = m_renderConfig;
+        // Compare hashes instead of copying/comparing the whole config (which includes the color map) every frame.
+        const size_t renderConfigHashBefore = render::hash(m_renderConfig);
         const auto interpolationModeBefore = m_interpolationMode;
 
         showRayCastTab(renderTime);
         showTransFuncTab();
         show2DTransFuncTab();
 
-        if (m_renderConfig != renderConfigBefore)
+        if (render::hash(m_renderConfig) != renderConfigHashBefore)
             callRenderConfigChangedCallback();
         if (m_interpolationMode != interpolationModeBefore)
             callInterpolationModeChangedCallback();
@@ -99,7 +166,7 @@ void Menu::drawMenu(const glm::ivec2& pos, const glm::ivec2& size, std::chrono::
 void Menu::showLoadVolTab()
 {
     if (ImGui::BeginTabItem("Load")) {
-        // Create drop-down with all data files
+        // Create drop-down with all data files (selecting a directory loads all files in it as a time series)
         if (ImGui::BeginCombo("Volumes", currentFileName.c_str())) {
             for (const auto &file : std::filesystem::directory_iterator(DATA_PATH)) {
                 const std::filesystem::path &fileName = file.path().filename();
@@ -110,16 +177,44 @@ void Menu::showLoadVolTab()
             ImGui::EndCombo();
         }
 
+        // Memory layout of the voxels, applied when the volume is loaded.
+        int* pVoxelLayoutInt = reinterpret_cast<int*>(&m_voxelLayout);
+        ImGui::Text("Voxel layout:");
+        ImGui::RadioButton("Linear", pVoxelLayoutInt, int(volume::VoxelLayout::Linear));
+        ImGui::SameLine();
+        ImGui::RadioButton("Morton (Z-order)", pVoxelLayoutInt, int(volume::VoxelLayout::Morton));
+
+        // Placement of the voxels on the memory nodes; only matters on machines with multiple NUMA nodes.
+        const size_t numNumaNodes = util::NumaTopology::instance().numNodes();
+        if (numNumaNodes > 1) {
+            int* pNumaPlacementInt = reinterpret_cast<int*>(&m_numaPlacement);
+            ImGui::Text("NUMA placement (%d nodes):", int(numNumaNodes));
+            ImGui::RadioButton("Default", pNumaPlacementInt, int(util::NumaPlacement::Default));
+            ImGui::SameLine();
+            ImGui::RadioButton("Interleaved", pNumaPlacementInt, int(util::NumaPlacement::Interleaved));
+            ImGui::SameLine();
+            ImGui::RadioButton("Partitioned", pNumaPlacementInt, int(util::NumaPlacement::Partitioned));
+        }
+
         // Create load button
         if (ImGui::Button("Load volume")) {
             // Check if an actual file has been selected
-            if (currentFileName != "FLD File" && m_optLoadVolumeCallback) {
+            if (currentFileName != "FLD File" && !m_loading && m_optLoadVolumeCallback) {
                 (*m_optLoadVolumeCallback)(DATA_PATH / currentFileName);
             }
         }
         ImGui::EndTabItem();
     }
+    if (m_loading) {
+        ImGui::Text("%s", m_loadStage.c_str());
+        ImGui::ProgressBar(m_loadProgress);
+    }
     if (m_volumeLoaded) {ImGui::Text("%s", m_volumeInfo.c_str());}
+    if (m_volumeLoaded && m_sequenceLength > 1) {
+        ImGui::Checkbox("Play", &m_playing);
+        ImGui::SliderInt("Time step", &m_sequenceFrame, 0, m_sequenceLength - 1);
+        ImGui::SliderFloat("Frames per second", &m_playbackFps, 1.0f, 60.0f);
+    }
 }
 
 // This renders the RayCast tab, where the user can set the render mode, interpolation mode and other
@@ -139,14 +234,58 @@ void Menu::showRayCastTab(std::chrono::duration<double> renderTime)
         ImGui::RadioButton("IsoSurface Rendering", pRenderModeInt, int(render::RenderMode::RenderIso));
         ImGui::RadioButton("Compositing", pRenderModeInt, int(render::RenderMode::RenderComposite));
         ImGui::RadioButton("2D Transfer Function", pRenderModeInt, int(render::RenderMode::RenderTF2D));
+        ImGui::RadioButton("IsoSurface Mesh (marching cubes + BVH)", pRenderModeInt, int(render::RenderMode::RenderIsoMesh));
+        ImGui::RadioButton("Compositing (shear-warp)", pRenderModeInt, int(render::RenderMode::RenderShearWarp));
+        ImGui::RadioButton("Multi-planar reformat", pRenderModeInt, int(render::RenderMode::RenderMPR));
 
         ImGui::NewLine();
 
         ImGui::Checkbox("Volume Shading", &m_renderConfig.volumeShading);
 
+        // Compositing from a volume to which the 1D transfer function was applied ahead of time.
+        int* pPreClassificationInt = reinterpret_cast<int*>(&m_renderConfig.preClassification);
+        ImGui::Text("Pre-classification (compositing):");
+        ImGui::RadioButton("Off", pPreClassificationInt, int(render::PreClassification::Off));
+        ImGui::SameLine();
+        ImGui::RadioButton("Auto", pPreClassificationInt, int(render::PreClassification::Auto));
+        ImGui::SameLine();
+        ImGui::RadioButton("On", pPreClassificationInt, int(render::PreClassification::On));
+
+        ImGui::NewLine();
+
+        // Plane and slab of the multi-planar reformat mode.
+        int* pSliceOrientationInt = reinterpret_cast<int*>(&m_renderConfig.sliceOrientation);
+        ImGui::Text("Slice (multi-planar reformat):");
+        ImGui::RadioButton("Camera", pSliceOrientationInt, int(render::SliceOrientation::Camera));
+        ImGui::SameLine();
+        ImGui::RadioButton("Axial", pSliceOrientationInt, int(render::SliceOrientation::Axial));
+        ImGui::SameLine();
+        ImGui::RadioButton("Coronal", pSliceOrientationInt, int(render::SliceOrientation::Coronal));
+        ImGui::SameLine();
+        ImGui::RadioButton("Sagittal", pSliceOrientationInt, int(render::SliceOrientation::Sagittal));
+        ImGui::SliderFloat("Slice position", &m_renderConfig.slicePosition, 0.0f, 1.0f);
+        ImGui::DragFloat("Slab thickness", &m_renderConfig.slabThickness, 0.1f, 0.0f, 256.0f);
+        int* pSlabModeInt = reinterpret_cast<int*>(&m_renderConfig.slabMode);
+        ImGui::RadioButton("Slab MIP", pSlabModeInt, int(render::SlabMode::MIP));
+        ImGui::SameLine();
+        ImGui::RadioButton("Slab average", pSlabModeInt, int(render::SlabMode::Average));
+
         ImGui::NewLine();
 
         ImGui::DragFloat("Iso Value", &m_renderConfig.isoValue, 0.1f, 0.0f, float(m_volumeMax));
+        // Extract the iso surface with marching cubes and write it to disk.
+        const auto exportButton = [&](const char* label, const std::filesystem::path& exportPath) {
+            if (ImGui::Button(label) && m_optExportIsoSurfaceCallback) {
+                m_exportInfo = (*m_optExportIsoSurfaceCallback)(exportPath)
+                    ? fmt::format("Iso surface written to {}", std::filesystem::absolute(exportPath).string())
+                    : fmt::format("Could not write {}", exportPath.string());
+            }
+        };
+        exportButton("Export PLY", ISO_SURFACE_PLY_PATH);
+        ImGui::SameLine();
+        exportButton("Export OBJ", ISO_SURFACE_OBJ_PATH);
+        if (!m_exportInfo.empty())
+            ImGui::TextWrapped("%s", m_exportInfo.c_str());
 
         ImGui::NewLine();
 
@@ -161,6 +300,32 @@ void Menu::showRayCastTab(std::chrono::duration<double> renderTime)
         ImGui::RadioButton("Linear", pInterpolationModeInt, int(volume::InterpolationMode::Linear));
         ImGui::RadioButton("TriCubic", pInterpolationModeInt, int(volume::InterpolationMode::Cubic));
 
+        ImGui::NewLine();
+
+        int* pFrameBufferFormatInt = reinterpret_cast<int*>(&m_renderConfig.frameBufferFormat);
+        ImGui::Text("Framebuffer format:");
+        ImGui::RadioButton("RGBA8", pFrameBufferFormatInt, int(render::FrameBufferFormat::RGBA8));
+        ImGui::SameLine();
+        ImGui::RadioButton("RGBA16F", pFrameBufferFormatInt, int(render::FrameBufferFormat::RGBA16F));
+        ImGui::SameLine();
+        ImGui::RadioButton("RGBA32F", pFrameBufferFormatInt, int(render::FrameBufferFormat::RGBA32F));
+
+        ImGui::NewLine();
+
+        // Record a Chrome trace (chrome://tracing or ui.perfetto.dev) of loading, rendering and uploading.
+        bool tracing = util::isTracingEnabled();
+        if (ImGui::Checkbox("Record trace", &tracing))
+            util::setTracingEnabled(tracing);
+        ImGui::SameLine();
+        if (ImGui::Button("Save trace")) {
+            m_traceInfo = util::writeChromeTrace(TRACE_PATH)
+                ? fmt::format("Trace written to {}", std::filesystem::absolute(TRACE_PATH).string())
+                : fmt::format("Could not write {}", TRACE_PATH.string());
+            util::clearTrace();
+        }
+        if (!m_traceInfo.empty())
+            ImGui::TextWrapped("%s", m_traceInfo.c_str());
+
         ImGui::EndTabItem();
     }
 }
@@ -179,8 +344,12 @@ void Menu::showTransFuncTab()
 void Menu::show2DTransFuncTab()
 {
     if (ImGui::BeginTabItem("2D transfer function")) {
-        m_tf2DWidget->draw();
-        m_tf2DWidget->updateRenderConfig(m_renderConfig);
+        if (m_tf2DWidget) {
+            m_tf2DWidget->draw();
+            m_tf2DWidget->updateRenderConfig(m_renderConfig);
+        } else {
+            ImGui::Text("Waiting for the gradients to be computed...");
+        }
         ImGui::EndTabItem();
     }
 }
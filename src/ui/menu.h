@@ -10,6 +10,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 
 namespace render {
 class Renderer;
@@ -26,12 +27,28 @@ public:
     void setRenderConfigChangedCallback(RenderConfigChangedCallback&& callback);
     using InterpolationModeChangedCallback = std::function<void(volume::InterpolationMode)>;
     void setInterpolationModeChangedCallback(InterpolationModeChangedCallback&& callback);
+    // Export the iso surface at the current iso value as a mesh (PLY or OBJ, by extension); returns whether it succeeded.
+    using ExportIsoSurfaceCallback = std::function<bool(const std::filesystem::path&)>;
+    void setExportIsoSurfaceCallback(ExportIsoSurfaceCallback&& callback);
 
-    render::RenderConfig renderConfig() const;
+    const render::RenderConfig& renderConfig() const;
     volume::InterpolationMode interpolationMode() const;
+    volume::VoxelLayout voxelLayout() const;
+    util::NumaPlacement numaPlacement() const;
 
     void setBaseRenderResolution(const glm::ivec2& baseRenderResolution);
-    void setLoadedVolume(const volume::Volume& volume, const volume::GradientVolume& gradientVolume);
+    void setLoadedVolume(const volume::Volume& volume);
+    void setLoadedGradientVolume(const volume::Volume& volume, const volume::GradientVolume& gradientVolume);
+    // Show the progress of a volume that is being loaded in the background; new loads are ignored meanwhile.
+    void setLoadProgress(std::string_view stage, float progress);
+    void clearLoadProgress();
+
+    // Playback controls of a volume sequence (time series); hidden if the length is 0.
+    void setSequenceLength(size_t numFrames);
+    void setSequenceFrame(int frame);
+    int sequenceFrame() const;
+    bool isPlaying() const;
+    float playbackFps() const;
 
     void drawMenu(const glm::ivec2& pos, const glm::ivec2& size, std::chrono::duration<double> renderTime);
 
@@ -46,7 +63,16 @@ private:
 
 private:
     bool m_volumeLoaded = false;
+    bool m_loading = false;
+    std::string m_loadStage;
+    float m_loadProgress { 0.0f };
     std::string m_volumeInfo;
+    int m_sequenceLength { 0 };
+    int m_sequenceFrame { 0 };
+    bool m_playing { false };
+    float m_playbackFps { 15.0f };
+    std::string m_traceInfo;
+    std::string m_exportInfo;
     int m_volumeMax;
 
     std::optional<TransferFunctionWidget> m_tfWidget;
@@ -56,10 +82,13 @@ private:
     float m_resolutionScale { 1.0f };
     render::RenderConfig m_renderConfig {};
     volume::InterpolationMode m_interpolationMode { volume::InterpolationMode::NearestNeighbour };
+    volume::VoxelLayout m_voxelLayout { volume::VoxelLayout::Linear };
+    util::NumaPlacement m_numaPlacement { util::NumaPlacement::Default };
 
     std::optional<LoadVolumeCallback> m_optLoadVolumeCallback;
     std::optional<RenderConfigChangedCallback> m_optRenderConfigChangedCallback;
     std::optional<InterpolationModeChangedCallback> m_optInterpolationModeChangedCallback;
+    std::optional<ExportIsoSurfaceCallback> m_optExportIsoSurfaceCallback;
 };
 
 }
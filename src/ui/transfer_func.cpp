@@ -1,24 +1,42 @@
 ﻿#include "ui/transfer_func.h"
+#include "ui/histogram_image.h"
+#include "util/trace.h"
 #include <algorithm>
-#include <cassert>
+#include <array>
+#include <atomic>
+#include <cstring> // memcpy
 #include <filesystem>
 #include <glm/common.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
-#include <gsl/span>
 #include <imgui.h>
 #include <iostream>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 static GLuint createTexture();
-static std::vector<glm::vec4> createHistogramImage(gsl::span<const int> data, float opacity);
 static ImVec2 glmToIm(const glm::vec2& v);
 static glm::vec2 ImToGlm(const ImVec2& v);
 
 // Radius of the points in the histogram image.
 static constexpr float pointRadius = 8.0f;
 static constexpr glm::ivec2 widgetSize { 475, 300 };
+static constexpr glm::ivec2 canvasResolution { widgetSize.x, widgetSize.y - 20 };
 static constexpr float histogramOpacity = 0.3f;
 static constexpr size_t sentinel = static_cast<size_t>(-1);
+// Selectable resolutions of the color map. 65536 entries give every 16-bit value its own entry.
+static constexpr std::array<size_t, 5> colorMapResolutions { 256, 1024, 4096, 16384, 65536 };
+static constexpr std::array<const char*, 5> colorMapResolutionNames { "256", "1024", "4096", "16384", "65536" };
+// Maximum width of the color map texture (a larger color map is subsampled for display).
+static constexpr size_t maxColorMapImageWidth = 1024;
+
+// Color map versions are unique across all widgets so that a new widget (after loading another volume) never
+// reuses the version of a color map that is still stored in the menu's render config.
+static uint64_t nextColorMapVersion()
+{
+    static std::atomic<uint64_t> version { 0 };
+    return ++version;
+}
 
 namespace ui {
 
@@ -35,11 +53,11 @@ TransferFunctionWidget::TransferFunctionWidget(const volume::Volume& volume)
     m_tfPoints.push_back(TFPoint { glm::vec2(0.7f, 0.03f), glm::vec3(0.7f) });
     m_tfPoints.push_back(TFPoint { glm::vec2(1.0f), glm::vec3(1.0f) });
 
-    const auto histogram = volume.histogram();
-    const auto imgData = createHistogramImage(histogram, histogramOpacity);
+    // The image has the resolution of the canvas and covers the same value range as the color map.
+    const auto imgData = createHistogramImage(volume.histogram(), m_maxValue, canvasResolution, histogramOpacity);
 
     glBindTexture(GL_TEXTURE_2D, m_histogramImg);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, GLsizei(histogram.size()), GLsizei(widgetSize.y), 0, GL_RGBA, GL_FLOAT, imgData.data());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, canvasResolution.x, canvasResolution.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, imgData.data());
     glBindTexture(GL_TEXTURE_2D, 0);
 
     updateColormap();
@@ -47,8 +65,11 @@ TransferFunctionWidget::TransferFunctionWidget(const volume::Volume& volume)
 
 void TransferFunctionWidget::updateRenderConfig(render::RenderConfig& renderConfig) const
 {
-    assert(m_colorMap.size() == renderConfig.tfColorMap.size());
-    std::copy(std::begin(m_colorMap), std::end(m_colorMap), std::begin(renderConfig.tfColorMap));
+    // This is called every UI frame; only copy the color map when it was actually modified.
+    if (renderConfig.tfColorMapVersion != m_colorMapVersion) {
+        renderConfig.tfColorMap = m_colorMap;
+        renderConfig.tfColorMapVersion = m_colorMapVersion;
+    }
     // Color map ranges from 0 to volume.maximum(). See volume.histogram() for details...
     renderConfig.tfColorMapIndexStart = 0;
     renderConfig.tfColorMapIndexRange = m_maxValue;
@@ -63,7 +84,7 @@ void TransferFunctionWidget::draw()
     ImGui::TextWrapped("Left click to add a point, right click remove. Left click + drag to move points.");
 
     // Histogram image is positioned to the right of the content region.
-    const glm::vec2 canvasSize { widgetSize.x, widgetSize.y - 20 };
+    const glm::vec2 canvasSize { canvasResolution };
     glm::vec2 canvasPos = ImToGlm(ImGui::GetCursorScreenPos()); // this is the imgui draw cursor, not mouse cursor
     const float xOffset = (ImToGlm(ImGui::GetContentRegionAvail()).x - canvasSize.x);
     canvasPos.x += xOffset; // center widget
@@ -192,6 +213,15 @@ void TransferFunctionWidget::draw()
     ImGui::SetCursorPosX(ImGui::GetCursorPosX() + xOffset + canvasSize.x / 2 - 40);
     ImGui::Text("Voxel Value");
 
+    ImGui::SetCursorPosX(ImGui::GetCursorPosX() + xOffset);
+    ImGui::PushItemWidth(canvasSize.x / 3);
+    int resolutionIndex = static_cast<int>(std::distance(std::begin(colorMapResolutions), std::find(std::begin(colorMapResolutions), std::end(colorMapResolutions), m_colorMap.size())));
+    if (ImGui::Combo("Resolution", &resolutionIndex, colorMapResolutionNames.data(), static_cast<int>(colorMapResolutionNames.size()))) {
+        m_colorMap.resize(colorMapResolutions[static_cast<size_t>(resolutionIndex)]);
+        updateColormap();
+    }
+    ImGui::PopItemWidth();
+
     if (m_selectedPoint != sentinel) {
         ImGui::NewLine();
         ImGui::SetCursorPosX(ImGui::GetCursorPosX() + xOffset / 2);
@@ -205,21 +235,27 @@ void TransferFunctionWidget::draw()
 // (Re)compute the colormap color array
 void TransferFunctionWidget::updateColormap()
 {
-    // Update the color map texture.
-    auto left = std::begin(m_tfPoints);
-    auto right = ++std::begin(m_tfPoints);
-    for (size_t x = 0; x < m_colorMap.size(); x++) {
-        if (static_cast<float>(x) > right->pos.x * static_cast<float>(m_colorMap.size())) {
-            ++left;
-            ++right;
+    TRACE_SCOPE("TransferFunctionWidget::updateColormap");
+    // Every entry interpolates between the two points around it. The points are sorted, so the right point is
+    // found with a binary search which allows computing the entries in parallel.
+    const float size = static_cast<float>(m_colorMap.size());
+    const auto lastPoint = std::prev(std::end(m_tfPoints));
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, m_colorMap.size(), 1024), [&](const tbb::blocked_range<size_t>& range) {
+        for (size_t x = range.begin(); x != range.end(); x++) {
+            const auto right = std::partition_point(std::next(std::begin(m_tfPoints)), lastPoint, [&](const TFPoint& point) { return static_cast<float>(x) > point.pos.x * size; });
+            const auto left = std::prev(right);
+            m_colorMap[x] = glm::mix(TFPtoRGBA(*left), TFPtoRGBA(*right), (static_cast<float>(x) / size - left->pos.x) / (right->pos.x - left->pos.x));
         }
-
-        m_colorMap[x] = glm::mix(TFPtoRGBA(*left), TFPtoRGBA(*right), (static_cast<float>(x) / static_cast<float>(m_colorMap.size()) - left->pos.x) / (right->pos.x - left->pos.x));
-    }
-
-    // Upload it to the GPU.
+    });
+    m_colorMapVersion = nextColorMapVersion();
+
+    // Upload it to the GPU (subsampled if it is wider than the widget can show).
+    const size_t stride = (m_colorMap.size() + maxColorMapImageWidth - 1) / maxColorMapImageWidth;
+    std::vector<glm::vec4> image;
+    for (size_t x = 0; x < m_colorMap.size(); x += stride)
+        image.push_back(m_colorMap[x]);
     glBindTexture(GL_TEXTURE_2D, m_colorMapImg);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, GLsizei(m_colorMap.size()), 1, 0, GL_RGBA, GL_FLOAT, m_colorMap.data());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, GLsizei(image.size()), 1, 0, GL_RGBA, GL_FLOAT, image.data());
 }
 
 void TransferFunctionWidget::insertTFPoint(const glm::vec2& pos)
@@ -255,23 +291,6 @@ GLuint createTexture()
     return tex;
 }
 
-// Compute a histogram texture from the histogram vector
-static std::vector<glm::vec4> createHistogramImage(gsl::span<const int> data, float opacity)
-{
-    const int maxVal = *std::max_element(std::begin(data), std::end(data));
-    const glm::uvec2 res { data.size(), widgetSize.y };
-
-    const float scale = float(widgetSize.y) / (float(maxVal) * 1.1f);
-    std::vector<glm::vec4> imgData(static_cast<size_t>(res.x * res.y));
-    for (unsigned x = 0; x < res.x; x++) {
-        for (unsigned y = 0; y < res.y; y++) {
-            const size_t index = static_cast<size_t>(x + y * res.x);
-            imgData[index] = (static_cast<float>(res.y - y) < static_cast<float>(data[x]) * scale) ? glm::vec4(1.f, 1.f, 1.f, opacity) : glm::vec4(0.f);
-        }
-    }
-    return imgData;
-}
-
 // Vector conversion functions for glm - Imgui interaction
 static ImVec2 glmToIm(const glm::vec2& v)
 {
@@ -30,6 +30,7 @@ private:
 
     std::vector<TFPoint> m_tfPoints;
     std::vector<glm::vec4> m_colorMap;
+    uint64_t m_colorMapVersion { 0 };
     float m_minValue, m_maxValue;
 
     size_t m_interactingPoint; // Point currently being dragged around.
@@ -1,6 +1,9 @@
 #include "transfer_func_2d.h"
+#include "ui/histogram_image.h"
+#include "util/trace.h"
 #include <algorithm>
 #include <array>
+#include <cstring> // memcpy
 #include <filesystem>
 #include <glm/common.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -11,14 +14,13 @@
 
 static ImVec2 glmToIm(const glm::vec2& v);
 static glm::vec2 ImToGlm(const ImVec2& v);
-static std::vector<glm::vec4> createHistogramImage(
-    const volume::Volume& volume, const volume::GradientVolume& gradient, const glm::ivec2& res);
 
 namespace ui {
 
 // Radius of the three points in the histogram image.
 static constexpr float pointRadius = 8.0f;
 static constexpr glm::ivec2 widgetSize { 475, 300 };
+static constexpr glm::ivec2 canvasResolution { widgetSize.x, widgetSize.y - 20 };
 
 TransferFunction2DWidget::TransferFunction2DWidget(const volume::Volume& volume, const volume::GradientVolume& gradient)
     : m_intensity(68.0f)
@@ -28,8 +30,9 @@ TransferFunction2DWidget::TransferFunction2DWidget(const volume::Volume& volume,
     , m_interactingPoint(-1)
     , m_histogramImg(0)
 {
-    const glm::ivec2 res = glm::ivec2(volume.maximum(), gradient.maxMagnitude() + 1);
-    const auto imgData = createHistogramImage(volume, gradient, res);
+    // The joint histogram is computed (in parallel) together with the gradient volume; the image re-bins it to
+    // the resolution of the canvas.
+    const auto imgData = createHistogramImage(gradient.histogram2D(), canvasResolution);
 
     glGenTextures(1, &m_histogramImg);
     glBindTexture(GL_TEXTURE_2D, m_histogramImg);
@@ -38,7 +41,7 @@ TransferFunction2DWidget::TransferFunction2DWidget(const volume::Volume& volume,
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glBindTexture(GL_TEXTURE_2D, m_histogramImg);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, res.x, res.y, 0, GL_RGBA, GL_FLOAT, imgData.data());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, canvasResolution.x, canvasResolution.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, imgData.data());
 }
 
 // Draw the widget and handle interactions
@@ -50,7 +53,7 @@ void TransferFunction2DWidget::draw()
     ImGui::Text("Click and drag points to alter the m_radius or m_intensity");
 
     // Histogram image is positioned to the right of the content region.
-    const glm::vec2 canvasSize { widgetSize.x, widgetSize.y - 20 };
+    const glm::vec2 canvasSize { canvasResolution };
     glm::vec2 canvasPos = ImToGlm(ImGui::GetCursorScreenPos()); // this is the imgui draw cursor, not mouse cursor
     const float xOffset = (ImToGlm(ImGui::GetContentRegionAvail()).x - canvasSize.x);
     canvasPos.x += xOffset; // center widget
@@ -191,6 +194,39 @@ void TransferFunction2DWidget::draw()
     ImGui::SetCursorPosX(ImGui::GetCursorPosX() + xOffset / 2);
     ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth() * 0.4f);
     ImGui::ColorPicker4("Color", glm::value_ptr(m_color));
+
+    drawPrimitives();
+}
+
+// Controls of the additional primitives: center and half size are in (value, normalized gradient magnitude).
+void TransferFunction2DWidget::drawPrimitives()
+{
+    ImGui::NewLine();
+    ImGui::Text("Additional primitives");
+    const auto addPrimitive = [&](render::TF2DShape shape) {
+        m_primitives.push_back(render::TF2DPrimitive { shape, glm::vec2(0.5f * m_maxIntensity, 0.5f), glm::vec2(0.1f * m_maxIntensity, 0.25f), m_color });
+    };
+    if (ImGui::Button("Add box"))
+        addPrimitive(render::TF2DShape::Box);
+    ImGui::SameLine();
+    if (ImGui::Button("Add Gaussian"))
+        addPrimitive(render::TF2DShape::Gaussian);
+
+    for (size_t i = 0; i < m_primitives.size(); i++) {
+        render::TF2DPrimitive& primitive = m_primitives[i];
+        ImGui::PushID(static_cast<int>(i));
+        ImGui::Separator();
+        ImGui::Text(primitive.shape == render::TF2DShape::Box ? "Box" : "Gaussian");
+        ImGui::DragFloat2("Center", glm::value_ptr(primitive.center), 0.01f * m_maxIntensity);
+        ImGui::DragFloat2("Half size", glm::value_ptr(primitive.halfSize), 0.01f * m_maxIntensity, 0.0f);
+        ImGui::ColorEdit4("Color", glm::value_ptr(primitive.color));
+        const bool remove = ImGui::Button("Remove");
+        ImGui::PopID();
+        if (remove) {
+            m_primitives.erase(std::begin(m_primitives) + static_cast<ptrdiff_t>(i));
+            break;
+        }
+    }
 }
 
 void TransferFunction2DWidget::updateRenderConfig(render::RenderConfig& renderConfig)
@@ -198,6 +234,8 @@ void TransferFunction2DWidget::updateRenderConfig(render::RenderConfig& renderCo
     renderConfig.TF2DIntensity = m_intensity;
     renderConfig.TF2DRadius = m_radius;
     renderConfig.TF2DColor = m_color;
+    // The renderer rasterizes all primitives into its lookup table when any of them changed.
+    renderConfig.TF2DPrimitives = m_primitives;
 }
 }
 
@@ -210,31 +248,3 @@ static glm::vec2 ImToGlm(const ImVec2& v)
 {
     return glm::vec2(v.x, v.y);
 }
-
-// Compute a histogram texture from the volume and gradient data
-static std::vector<glm::vec4> createHistogramImage(
-    const volume::Volume& volume, const volume::GradientVolume& gradient, const glm::ivec2& res)
-{
-    const size_t numPixels = static_cast<size_t>(res.x * res.y);
-    std::vector<int> bins(numPixels, 0);
-    for (int z = 0; z < volume.dims().z; z++) {
-        for (int y = 0; y < volume.dims().y; y++) {
-            for (int x = 0; x < volume.dims().x; x++) {
-                const size_t imgX = static_cast<size_t>(volume.getVoxel(x, y, z));
-                const size_t imgY = static_cast<size_t>(res.y - 1) - static_cast<size_t>(gradient.getGradient(x, y, z).magnitude);
-                const size_t index = imgX + imgY * static_cast<size_t>(res.x);
-                bins[index]++;
-            }
-        }
-    }
-
-    const int maxCount = *std::max_element(std::begin(bins), std::end(bins));
-    const float factor = 1.0f / std::log(float(maxCount));
-
-    std::vector<glm::vec4> imageData(numPixels, glm::vec4(0.0f));
-    std::transform(std::begin(bins), std::end(bins), std::begin(imageData),
-        [&](int count) {
-            return glm::vec4(1.0f, 1.0f, 1.0f, std::log(float(count)) * factor);
-        });
-    return imageData;
-}
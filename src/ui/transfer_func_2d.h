@@ -5,6 +5,7 @@
 #include <GL/glew.h> // Include before glfw3
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
+#include <vector>
 
 namespace ui {
 
@@ -15,10 +16,15 @@ public:
     void draw();
     void updateRenderConfig(render::RenderConfig& renderConfig);
 
+private:
+    void drawPrimitives();
+
 private:
     float m_intensity, m_maxIntensity;
     float m_radius;
     glm::vec4 m_color;
+    // Boxes and Gaussians on top of the triangle; edited with the controls below the histogram.
+    std::vector<render::TF2DPrimitive> m_primitives;
 
     int m_interactingPoint;
     GLuint m_histogramImg;
@@ -0,0 +1,60 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace util {
+
+Arena::Arena(size_t initialBlockSize)
+{
+    addBlock(initialBlockSize);
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    const auto alignedOffset = [&](const Block& block) {
+        const auto address = reinterpret_cast<uintptr_t>(block.memory.get()) + m_offset;
+        return m_offset + (alignment - address % alignment) % alignment;
+    };
+
+    size_t offset = alignedOffset(m_blocks.back());
+    if (offset + size > m_blocks.back().size) {
+        // Grow geometrically; the blocks are merged into one on the next reset.
+        addBlock(std::max(2 * m_blocks.back().size, size + alignment));
+        offset = alignedOffset(m_blocks.back());
+    }
+    m_used += offset + size - m_offset;
+    m_offset = offset + size;
+    return m_blocks.back().memory.get() + offset;
+}
+
+void Arena::reset()
+{
+    if (m_blocks.size() > 1) {
+        const size_t totalSize = capacity();
+        m_blocks.clear();
+        addBlock(totalSize);
+    }
+    m_offset = 0;
+    m_used = 0;
+}
+
+size_t Arena::used() const
+{
+    return m_used;
+}
+
+size_t Arena::capacity() const
+{
+    size_t totalSize = 0;
+    for (const Block& block : m_blocks)
+        totalSize += block.size;
+    return totalSize;
+}
+
+void Arena::addBlock(size_t size)
+{
+    m_blocks.push_back(Block { std::unique_ptr<std::byte[]>(new std::byte[size]), size });
+    m_offset = 0;
+}
+
+}
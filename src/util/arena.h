@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <gsl/span>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace util {
+
+// Bump allocator for short lived (per frame) scratch memory. Allocations are carved out of large blocks and are
+// all released at once by reset(); individual deallocations are no-ops. When reset() finds that more than one
+// block was needed, it replaces them by a single block of their combined size, such that once the arena has
+// seen its peak usage it no longer touches the heap.
+//
+// Only for trivially destructible types: destructors are not called.
+class Arena {
+public:
+    explicit Arena(size_t initialBlockSize = 64 * 1024);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+    // Uninitialized array of count elements.
+    template <typename T>
+    gsl::span<T> allocateArray(size_t count);
+
+    // Release all allocations.
+    void reset();
+
+    // Bytes handed out since the last reset (including alignment padding) and bytes reserved from the heap.
+    size_t used() const;
+    size_t capacity() const;
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> memory;
+        size_t size;
+    };
+    void addBlock(size_t size);
+
+    std::vector<Block> m_blocks; // Allocations are made from the last block.
+    size_t m_offset { 0 }; // Into the last block.
+    size_t m_used { 0 };
+};
+
+// STL allocator that allocates from an arena, e.g. for per frame std::vectors. The arena must outlive the
+// containers and the containers must not be used after the arena has been reset.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena) noexcept
+        : m_pArena(&arena)
+    {
+    }
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+        : m_pArena(other.arena())
+    {
+    }
+
+    T* allocate(size_t count) { return static_cast<T*>(m_pArena->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) noexcept { }
+
+    Arena* arena() const noexcept { return m_pArena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return m_pArena == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return m_pArena != other.arena(); }
+
+private:
+    Arena* m_pArena;
+};
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename T>
+gsl::span<T> Arena::allocateArray(size_t count)
+{
+    static_assert(std::is_trivially_destructible_v<T>, "Arena allocations are never destructed");
+    return gsl::span<T>(static_cast<T*>(allocate(count * sizeof(T), alignof(T))), count);
+}
+
+}
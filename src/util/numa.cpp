@@ -0,0 +1,31 @@
+#include "numa.h"
+#include <tbb/info.h>
+
+namespace util {
+
+const NumaTopology& NumaTopology::instance()
+{
+    static const NumaTopology topology;
+    return topology;
+}
+
+NumaTopology::NumaTopology()
+{
+    // Returns a single node with id -1 (no constraint) if the topology is not available.
+    for (const tbb::numa_node_id node : tbb::info::numa_nodes())
+        m_arenas.push_back(std::make_unique<tbb::task_arena>(tbb::task_arena::constraints(node)));
+    if (m_arenas.empty())
+        m_arenas.push_back(std::make_unique<tbb::task_arena>());
+}
+
+size_t NumaTopology::numNodes() const
+{
+    return m_arenas.size();
+}
+
+size_t NumaTopology::partitionNode(size_t i, size_t size) const
+{
+    return size == 0 ? 0 : std::min(i * m_arenas.size() / size, m_arenas.size() - 1);
+}
+
+}
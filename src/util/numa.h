@@ -0,0 +1,148 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// NUMA aware placement of large buffers (volumes, gradient volumes) on machines with multiple memory nodes
+// (e.g. dual socket servers). Placement relies on the first touch policy of the operating system: a page is
+// allocated on the memory node of the thread that first writes it. Buffers are therefore allocated without
+// initializing their elements and then written by threads that run in task arenas which are constrained to the
+// cores of the node that should own the pages.
+//
+// The NUMA topology comes from TBB, which needs its TBBBind library (and hwloc) at run time. Without it, or on
+// a machine with a single node, everything runs as a regular TBB parallel loop.
+
+namespace util {
+
+// How the pages of a buffer are spread over the NUMA nodes.
+enum class NumaPlacement {
+    // Written by regular parallel loops; the pages end up wherever the TBB workers happen to run.
+    Default = 0,
+    // Round robin over the nodes in chunks of numaChunkBytes. Spreads the memory bandwidth over all nodes.
+    Interleaved,
+    // Node i owns the i-th contiguous part of the buffer: a slab of z slices in the linear voxel layout or a
+    // compact block of the volume in the Morton layout. The renderer then renders every tile on the node that
+    // owns most of the voxels that it samples.
+    Partitioned
+};
+
+// Multiple of the page size (4KB) and of the element sizes used.
+inline constexpr size_t numaChunkBytes = 64 * 1024;
+
+// Allocator that default initializes new elements, i.e. leaves trivial types uninitialized, such that the pages
+// of a new buffer are not touched until they are written.
+template <typename T>
+class FirstTouchAllocator : public std::allocator<T> {
+public:
+    using value_type = T;
+    template <typename U>
+    struct rebind {
+        using other = FirstTouchAllocator<U>;
+    };
+
+    FirstTouchAllocator() = default;
+    template <typename U>
+    FirstTouchAllocator(const FirstTouchAllocator<U>&) noexcept { }
+
+    template <typename U>
+    void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>)
+    {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args)
+    {
+        ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+};
+template <typename T>
+using NumaVector = std::vector<T, FirstTouchAllocator<T>>;
+
+class NumaTopology {
+public:
+    static const NumaTopology& instance();
+
+    // At least 1.
+    size_t numNodes() const;
+    // Node that owns element i of a buffer of the given size with Partitioned placement.
+    size_t partitionNode(size_t i, size_t size) const;
+
+    // Run f(node) for every node, each in a task arena constrained to the cores of the node, and wait until all
+    // have finished. Parallel loops inside f only use the threads of that node.
+    template <typename F>
+    void forEachNode(F&& f) const;
+
+private:
+    NumaTopology();
+
+private:
+    std::vector<std::unique_ptr<tbb::task_arena>> m_arenas;
+};
+
+// Resize the (empty) buffer to the given size and value initialize the elements such that the pages are placed
+// on the NUMA nodes according to the placement.
+template <typename T>
+void placeBuffer(NumaVector<T>& buffer, size_t size, NumaPlacement placement);
+
+template <typename F>
+void NumaTopology::forEachNode(F&& f) const
+{
+    if (m_arenas.size() == 1) {
+        f(size_t(0));
+        return;
+    }
+    std::vector<tbb::task_group> taskGroups(m_arenas.size());
+    for (size_t node = 0; node < m_arenas.size(); node++)
+        m_arenas[node]->execute([&, node]() { taskGroups[node].run([&, node]() { f(node); }); });
+    for (size_t node = 0; node < m_arenas.size(); node++)
+        m_arenas[node]->execute([&, node]() { taskGroups[node].wait(); });
+}
+
+template <typename T>
+void placeBuffer(NumaVector<T>& buffer, size_t size, NumaPlacement placement)
+{
+    buffer.resize(size);
+    const NumaTopology& topology = NumaTopology::instance();
+    const size_t numNodes = topology.numNodes();
+    const size_t chunkSize = std::max(numaChunkBytes / sizeof(T), size_t(1));
+    const size_t numChunks = (size + chunkSize - 1) / chunkSize;
+    const auto initializeChunk = [&](size_t chunk) {
+        std::fill(std::begin(buffer) + std::ptrdiff_t(chunk * chunkSize), std::begin(buffer) + std::ptrdiff_t(std::min((chunk + 1) * chunkSize, size)), T {});
+    };
+
+    if (placement == NumaPlacement::Default || numNodes == 1) {
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, numChunks), [&](const tbb::blocked_range<size_t>& range) {
+            for (size_t chunk = range.begin(); chunk != range.end(); chunk++)
+                initializeChunk(chunk);
+        });
+    } else if (placement == NumaPlacement::Interleaved) {
+        topology.forEachNode([&](size_t node) {
+            const size_t numNodeChunks = numChunks > node ? (numChunks - node + numNodes - 1) / numNodes : 0;
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, numNodeChunks), [&](const tbb::blocked_range<size_t>& range) {
+                for (size_t i = range.begin(); i != range.end(); i++)
+                    initializeChunk(i * numNodes + node);
+            });
+        });
+    } else {
+        // Chunk c holds elements [c * chunkSize, (c + 1) * chunkSize), all owned by the node of its first element
+        // (the partitions are not chunk aligned; a chunk that straddles a boundary goes to the lower node).
+        topology.forEachNode([&](size_t node) {
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, numChunks), [&](const tbb::blocked_range<size_t>& range) {
+                for (size_t chunk = range.begin(); chunk != range.end(); chunk++) {
+                    if (topology.partitionNode(chunk * chunkSize, size) == node)
+                        initializeChunk(chunk);
+                }
+            });
+        });
+    }
+}
+
+}
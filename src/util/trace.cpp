@@ -0,0 +1,147 @@
+#include "trace.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fmt/format.h>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace util {
+
+// Number of events that each thread keeps; older events are overwritten.
+static constexpr size_t eventsPerThread = 1 << 16;
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start, end; // Nanoseconds since the tracer epoch.
+};
+// The fields are atomic because writeChromeTrace may read a slot while the owning thread overwrites it.
+struct TraceSlot {
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> start, end;
+};
+
+// Single producer (the owning thread), single consumer (writeChromeTrace) ring buffer. Event i is stored in slot
+// i % eventsPerThread; only the owning thread modifies started and head, which never go back.
+struct ThreadTraceBuffer {
+    uint32_t threadIndex;
+    // Number of events whose write has started; event i overwrites event i - eventsPerThread.
+    std::atomic<size_t> started { 0 };
+    // Number of events that have been written completely.
+    std::atomic<size_t> head { 0 };
+    // Events before tail were discarded by clearTrace(). Protected by registryMutex.
+    size_t tail { 0 };
+    std::array<TraceSlot, eventsPerThread> events;
+};
+
+// Buffers are registered once per thread and are never freed so that the events of threads that have
+// exited can still be written.
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<ThreadTraceBuffer>> threadBuffers;
+static const auto epoch = std::chrono::steady_clock::now();
+
+static ThreadTraceBuffer* registerThread()
+{
+    std::lock_guard lock { registryMutex };
+    auto pBuffer = std::make_unique<ThreadTraceBuffer>();
+    pBuffer->threadIndex = static_cast<uint32_t>(threadBuffers.size());
+    threadBuffers.push_back(std::move(pBuffer));
+    return threadBuffers.back().get();
+}
+
+namespace detail {
+    uint64_t traceTimestamp()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    void recordTraceEvent(const char* name, uint64_t start, uint64_t end)
+    {
+        thread_local ThreadTraceBuffer* pBuffer = registerThread();
+
+        // Announce the write before touching the slot (the write side of a seqlock), see writeChromeTrace().
+        const size_t head = pBuffer->head.load(std::memory_order_relaxed);
+        pBuffer->started.store(head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        TraceSlot& slot = pBuffer->events[head % eventsPerThread];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        pBuffer->head.store(head + 1, std::memory_order_release);
+    }
+}
+
+void setTracingEnabled(bool enabled)
+{
+    detail::tracingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool isTracingEnabled()
+{
+    return detail::tracingEnabled.load(std::memory_order_relaxed);
+}
+
+// The owning threads keep appending; the events recorded so far are skipped by moving the tail.
+void clearTrace()
+{
+    std::lock_guard lock { registryMutex };
+    for (auto& pBuffer : threadBuffers)
+        pBuffer->tail = pBuffer->head.load(std::memory_order_acquire);
+}
+
+static std::string escapeJson(std::string_view str)
+{
+    std::string out;
+    out.reserve(str.size());
+    for (const char c : str) {
+        if (c == '"' || c == '\\')
+            out.push_back('\\');
+        out.push_back(c);
+    }
+    return out;
+}
+
+bool writeChromeTrace(const std::filesystem::path& filePath)
+{
+    std::ofstream file { filePath };
+    if (!file.is_open())
+        return false;
+
+    std::lock_guard lock { registryMutex };
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& pBuffer : threadBuffers) {
+        const size_t head = pBuffer->head.load(std::memory_order_acquire);
+        const size_t begin = std::max(pBuffer->tail, head - std::min(head, eventsPerThread));
+        std::vector<TraceEvent> events;
+        events.reserve(head - begin);
+        for (size_t i = begin; i < head; i++) {
+            const TraceSlot& slot = pBuffer->events[i % eventsPerThread];
+            events.push_back(TraceEvent { slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed) });
+        }
+
+        // Drop the events that the owning thread may have overwritten while we were copying (the read side of a
+        // seqlock): if a copied slot holds (part of) a newer event, the fence guarantees that started includes it.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const size_t started = pBuffer->started.load(std::memory_order_relaxed);
+        const size_t firstValid = started > eventsPerThread ? started - eventsPerThread : 0;
+        const size_t skip = std::min(std::max(firstValid, begin) - begin, head - begin);
+
+        const std::string separator = first ? "" : ",\n";
+        file << separator << fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"thread {}\"}}}}",
+            pBuffer->threadIndex, pBuffer->threadIndex);
+        first = false;
+        for (size_t i = skip; i < events.size(); i++) {
+            const TraceEvent& event = events[i];
+            // Chrome trace timestamps are in microseconds.
+            file << fmt::format(",\n{{\"name\":\"{}\",\"cat\":\"volvis\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                escapeJson(event.name), pBuffer->threadIndex, double(event.start) / 1000.0, double(event.end - event.start) / 1000.0);
+        }
+    }
+    file << "\n]}\n";
+    return file.good();
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+// Lightweight scoped-zone tracer. Each thread records (name, start, end) events into its own fixed-size
+// ring buffer without taking any locks; the buffers are merged and written as a Chrome trace JSON file
+// (open with chrome://tracing or https://ui.perfetto.dev) when writeChromeTrace() is called.
+//
+// Usage:
+//   TRACE_SCOPE("Renderer::render");
+//
+// Zone names MUST be string literals (or otherwise outlive the trace) because only the pointer is stored.
+// When tracing is disabled at runtime a zone costs a single relaxed atomic load. Define VOLVIS_DISABLE_TRACING
+// to compile the zones out completely.
+
+namespace util {
+
+namespace detail {
+    inline std::atomic<bool> tracingEnabled { false };
+
+    uint64_t traceTimestamp();
+    void recordTraceEvent(const char* name, uint64_t start, uint64_t end);
+}
+
+void setTracingEnabled(bool enabled);
+bool isTracingEnabled();
+
+// Discard all recorded events.
+void clearTrace();
+// Write all recorded events to a Chrome trace (JSON) file. Returns false if the file could not be written.
+// Other threads may keep recording; events that they overwrite while the trace is written are dropped.
+bool writeChromeTrace(const std::filesystem::path& filePath);
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : m_name(detail::tracingEnabled.load(std::memory_order_relaxed) ? name : nullptr)
+        , m_start(m_name ? detail::traceTimestamp() : 0)
+    {
+    }
+    ~TraceScope()
+    {
+        if (m_name)
+            detail::recordTraceEvent(m_name, m_start, detail::traceTimestamp());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_start;
+};
+
+}
+
+#define VOLVIS_TRACE_CONCAT_IMPL(a, b) a##b
+#define VOLVIS_TRACE_CONCAT(a, b) VOLVIS_TRACE_CONCAT_IMPL(a, b)
+#ifdef VOLVIS_DISABLE_TRACING
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE(name) const util::TraceScope VOLVIS_TRACE_CONCAT(traceScope, __LINE__) { name }
+#endif
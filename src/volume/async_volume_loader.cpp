@@ -0,0 +1,93 @@
+#include "async_volume_loader.h"
+#include "util/trace.h"
+#include <exception>
+#include <fmt/format.h>
+#include <stdexcept>
+
+namespace volume {
+
+AsyncVolumeLoader::AsyncVolumeLoader(const std::filesystem::path& file, VoxelLayout layout, util::NumaPlacement placement)
+{
+    m_thread = std::thread([this, file, layout, placement]() { load(file, layout, placement); });
+}
+
+AsyncVolumeLoader::~AsyncVolumeLoader()
+{
+    m_thread.join();
+}
+
+// Runs on the background thread. The stage is stored (with release semantics) after the data of the previous
+// stage has been written such that the UI thread sees fully constructed objects.
+void AsyncVolumeLoader::load(const std::filesystem::path& file, VoxelLayout layout, util::NumaPlacement placement)
+{
+    TRACE_SCOPE("AsyncVolumeLoader::load");
+    try {
+        if (!std::filesystem::exists(file))
+            throw std::runtime_error(fmt::format("File \"{}\" does not exist", file.string()));
+
+        auto pVolume = std::make_unique<Volume>(file, [this](float progress) {
+            m_progress.store(progress, std::memory_order_relaxed);
+            // Statistics are computed by the Volume constructor after the whole file has been read.
+            if (progress >= 1.0f)
+                m_stage.store(Stage::Statistics, std::memory_order_relaxed);
+        }, layout, placement);
+        m_pVolume = std::move(pVolume);
+        m_progress.store(0.0f, std::memory_order_relaxed);
+        m_stage.store(Stage::Gradients, std::memory_order_release);
+
+        auto pGradientVolume = std::make_unique<GradientVolume>(*m_pVolume, [this](float progress) {
+            m_progress.store(progress, std::memory_order_relaxed);
+        });
+        m_pGradientVolume = std::move(pGradientVolume);
+        m_progress.store(1.0f, std::memory_order_relaxed);
+        m_stage.store(Stage::Done, std::memory_order_release);
+    } catch (const std::exception& e) {
+        m_errorMessage = e.what();
+        m_stage.store(Stage::Failed, std::memory_order_release);
+    }
+}
+
+AsyncVolumeLoader::Stage AsyncVolumeLoader::stage() const
+{
+    return m_stage.load(std::memory_order_acquire);
+}
+
+float AsyncVolumeLoader::progress() const
+{
+    return m_progress.load(std::memory_order_relaxed);
+}
+
+std::string_view AsyncVolumeLoader::errorMessage() const
+{
+    return m_errorMessage;
+}
+
+Volume* AsyncVolumeLoader::volume()
+{
+    const Stage currentStage = stage();
+    return currentStage == Stage::Gradients || currentStage == Stage::Done ? m_pVolume.get() : nullptr;
+}
+
+GradientVolume* AsyncVolumeLoader::gradientVolume()
+{
+    return stage() == Stage::Done ? m_pGradientVolume.get() : nullptr;
+}
+
+std::string_view stageName(AsyncVolumeLoader::Stage stage)
+{
+    switch (stage) {
+    case AsyncVolumeLoader::Stage::Reading:
+        return "Reading file";
+    case AsyncVolumeLoader::Stage::Statistics:
+        return "Computing statistics";
+    case AsyncVolumeLoader::Stage::Gradients:
+        return "Computing gradients";
+    case AsyncVolumeLoader::Stage::Done:
+        return "Done";
+    case AsyncVolumeLoader::Stage::Failed:
+    default:
+        return "Failed";
+    };
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "gradient_volume.h"
+#include "volume.h"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace volume {
+
+// Loads a volume on a background thread so that the UI stays responsive. The volume becomes available as soon
+// as the file has been read and its statistics computed, which is enough to render MIP and slicer views; the
+// gradient volume follows once it has been computed. The statistics and gradients are computed with TBB
+// parallel loops; the loading itself runs on a dedicated thread rather than a TBB task because a task is
+// not guaranteed to start before someone waits for it (e.g. when TBB has no worker threads).
+//
+// The loader owns the loaded volume and gradient volume, so it must outlive any object referring to them.
+// All functions should be called from the same (UI) thread.
+class AsyncVolumeLoader {
+public:
+    enum class Stage {
+        Reading = 0,
+        Statistics,
+        Gradients,
+        Done,
+        Failed
+    };
+
+public:
+    explicit AsyncVolumeLoader(const std::filesystem::path& file, VoxelLayout layout = VoxelLayout::Linear,
+        util::NumaPlacement placement = util::NumaPlacement::Default);
+    // Waits for the background thread to finish.
+    ~AsyncVolumeLoader();
+
+    AsyncVolumeLoader(const AsyncVolumeLoader&) = delete;
+    AsyncVolumeLoader& operator=(const AsyncVolumeLoader&) = delete;
+
+    Stage stage() const;
+    // Progress (0 to 1) of the current stage.
+    float progress() const;
+    std::string_view errorMessage() const; // Only valid if stage() == Stage::Failed.
+
+    // Return nullptr while not yet available.
+    Volume* volume();
+    GradientVolume* gradientVolume();
+
+private:
+    void load(const std::filesystem::path& file, VoxelLayout layout, util::NumaPlacement placement);
+
+private:
+    std::atomic<Stage> m_stage { Stage::Reading };
+    std::atomic<float> m_progress { 0.0f };
+    std::string m_errorMessage;
+
+    // Written by the background thread before m_stage moves past the corresponding stage.
+    std::unique_ptr<Volume> m_pVolume;
+    std::unique_ptr<GradientVolume> m_pGradientVolume;
+
+    std::thread m_thread;
+};
+
+std::string_view stageName(AsyncVolumeLoader::Stage stage);
+
+}
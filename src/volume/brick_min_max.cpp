@@ -0,0 +1,93 @@
+#include "brick_min_max.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <limits>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace volume {
+
+// Compute the range of every brick in parallel; getValue(x, y, z) returns the value of a single voxel.
+template <typename F>
+static std::vector<glm::vec2> computeBrickRanges(const glm::ivec3& volumeDims, const glm::ivec3& brickDims, int brickSize, F&& getValue)
+{
+    TRACE_SCOPE("computeBrickRanges");
+    std::vector<glm::vec2> ranges(static_cast<size_t>(brickDims.x * brickDims.y * brickDims.z));
+    tbb::parallel_for(tbb::blocked_range<int>(0, brickDims.y * brickDims.z), [&](const tbb::blocked_range<int>& range) {
+        for (int yz = range.begin(); yz != range.end(); yz++) {
+            const int by = yz % brickDims.y;
+            const int bz = yz / brickDims.y;
+            for (int bx = 0; bx < brickDims.x; bx++) {
+                const glm::ivec3 begin = glm::ivec3(bx, by, bz) * brickSize;
+                const glm::ivec3 end = glm::min(begin + brickSize, volumeDims - 1); // Inclusive.
+
+                float minimum = std::numeric_limits<float>::max();
+                float maximum = std::numeric_limits<float>::lowest();
+                for (int z = begin.z; z <= end.z; z++) {
+                    for (int y = begin.y; y <= end.y; y++) {
+                        for (int x = begin.x; x <= end.x; x++) {
+                            const float value = getValue(x, y, z);
+                            minimum = std::min(minimum, value);
+                            maximum = std::max(maximum, value);
+                        }
+                    }
+                }
+                ranges[static_cast<size_t>(bx + brickDims.x * yz)] = glm::vec2(minimum, maximum);
+            }
+        }
+    });
+    return ranges;
+}
+
+static glm::ivec3 computeBrickDims(const glm::ivec3& volumeDims, int brickSize)
+{
+    return glm::max((volumeDims + brickSize - 1) / brickSize, glm::ivec3(1));
+}
+
+BrickMinMax::BrickMinMax(const Volume& volume, int brickSize)
+    : m_brickSize(brickSize)
+    , m_dims(computeBrickDims(volume.dims(), brickSize))
+    , m_ranges(volume.visit([&](const auto& voxels) {
+        return computeBrickRanges(volume.dims(), m_dims, brickSize, [&](int x, int y, int z) { return voxels.voxel(x, y, z); });
+    }))
+{
+}
+
+BrickMinMax::BrickMinMax(const GradientVolume& gradientVolume, int brickSize)
+    : m_brickSize(brickSize)
+    , m_dims(computeBrickDims(gradientVolume.dims(), brickSize))
+    , m_ranges(computeBrickRanges(gradientVolume.dims(), m_dims, brickSize, [&](int x, int y, int z) { return gradientVolume.getGradient(x, y, z).magnitude; }))
+{
+}
+
+int BrickMinMax::brickSize() const
+{
+    return m_brickSize;
+}
+
+glm::ivec3 BrickMinMax::dims() const
+{
+    return m_dims;
+}
+
+glm::ivec3 BrickMinMax::brickAt(const glm::vec3& position) const
+{
+    return glm::min(glm::ivec3(position) / m_brickSize, m_dims - 1);
+}
+
+size_t BrickMinMax::brickIndex(const glm::ivec3& brick) const
+{
+    return static_cast<size_t>(brick.x + m_dims.x * (brick.y + m_dims.y * brick.z));
+}
+
+glm::vec2 BrickMinMax::range(size_t brickIndex) const
+{
+    return m_ranges[brickIndex];
+}
+
+gsl::span<const glm::vec2> BrickMinMax::ranges() const
+{
+    return m_ranges;
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "gradient_volume.h"
+#include "volume.h"
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <gsl/span>
+#include <vector>
+
+namespace volume {
+
+// Value range (minimum, maximum) of every brick of brickSize^3 voxels of a volume (or of the gradient magnitude).
+// Brick b covers the positions [b * brickSize, (b + 1) * brickSize) but its range includes the voxels up to and
+// including (b + 1) * brickSize, such that every nearest neighbour or trilinearly interpolated sample at a
+// position inside the brick lies within the range.
+class BrickMinMax {
+public:
+    BrickMinMax(const Volume& volume, int brickSize = 8);
+    BrickMinMax(const GradientVolume& gradientVolume, int brickSize = 8);
+
+    int brickSize() const;
+    glm::ivec3 dims() const; // Number of bricks along each axis.
+
+    // Returns the brick that contains the (in bounds) position.
+    glm::ivec3 brickAt(const glm::vec3& position) const;
+    size_t brickIndex(const glm::ivec3& brick) const;
+    glm::vec2 range(size_t brickIndex) const;
+    gsl::span<const glm::vec2> ranges() const;
+
+private:
+    int m_brickSize;
+    glm::ivec3 m_dims;
+    std::vector<glm::vec2> m_ranges;
+};
+
+}
@@ -1,64 +1,122 @@
 #include "gradient_volume.h"
+#include "util/trace.h"
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <exception>
+#include <functional>
+#include <glm/common.hpp>
 #include <glm/geometric.hpp>
 #include <glm/vector_relational.hpp>
 #include <gsl/span>
+#include <limits>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 
 namespace volume {
 
-// Compute the maximum magnitude from all gradient voxels
-static float computeMaxMagnitude(gsl::span<const GradientVoxel> data)
-{
-    return std::max_element(
-        std::begin(data),
-        std::end(data),
-        [](const GradientVoxel& lhs, const GradientVoxel& rhs) {
-            return lhs.magnitude < rhs.magnitude;
-        })
-        ->magnitude;
-}
+// Maximum number of bins along each axis of the 2D (value, gradient magnitude) histogram.
+static constexpr int maxHistogram2DBins = 256;
 
-// Compute the minimum magnitude from all gradient voxels
-static float computeMinMagnitude(gsl::span<const GradientVoxel> data)
+// Compute the minimum (x) and maximum (y) magnitude from all gradient voxels in a single parallel pass.
+static glm::vec2 computeMagnitudeRange(gsl::span<const GradientVoxel> data)
 {
-    return std::min_element(
-        std::begin(data),
-        std::end(data),
-        [](const GradientVoxel& lhs, const GradientVoxel& rhs) {
-            return lhs.magnitude < rhs.magnitude;
-        })
-        ->magnitude;
+    return tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, data.size(), 1 << 16),
+        glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()),
+        [&](const tbb::blocked_range<size_t>& range, glm::vec2 magnitudeRange) {
+            for (size_t i = range.begin(); i != range.end(); i++) {
+                magnitudeRange.x = std::min(magnitudeRange.x, data[i].magnitude);
+                magnitudeRange.y = std::max(magnitudeRange.y, data[i].magnitude);
+            }
+            return magnitudeRange;
+        },
+        [](const glm::vec2& lhs, const glm::vec2& rhs) {
+            return glm::vec2(std::min(lhs.x, rhs.x), std::max(lhs.y, rhs.y));
+        });
 }
 
-// Compute a gradient volume from a volume
-static std::vector<GradientVoxel> computeGradientVolume(const Volume& volume)
+// Compute a gradient volume from a volume. Slices along the z-axis are processed in parallel.
+static util::NumaVector<GradientVoxel> computeGradientVolume(const Volume& volume, const ProgressCallback& progress)
 {
+    TRACE_SCOPE("computeGradientVolume");
     const auto dim = volume.dims();
 
-    std::vector<GradientVoxel> out(static_cast<size_t>(dim.x * dim.y * dim.z));
-    for (int z = 1; z < dim.z - 1; z++) {
-        for (int y = 1; y < dim.y - 1; y++) {
-            for (int x = 1; x < dim.x - 1; x++) {
-                const float gx = (volume.getVoxel(x + 1, y, z) - volume.getVoxel(x - 1, y, z)) / 2.0f;
-                const float gy = (volume.getVoxel(x, y + 1, z) - volume.getVoxel(x, y - 1, z)) / 2.0f;
-                const float gz = (volume.getVoxel(x, y, z + 1) - volume.getVoxel(x, y, z - 1)) / 2.0f;
-
-                const glm::vec3 v { gx, gy, gz };
-                const size_t index = static_cast<size_t>(x + dim.x * (y + dim.y * z));
-                out[index] = GradientVoxel { v, glm::length(v) };
+    const VoxelIndexer& indexer = volume.indexer();
+    util::NumaVector<GradientVoxel> out;
+    util::placeBuffer(out, indexer.size(), volume.placement());
+    const int numSlices = std::max(dim.z - 2, 0);
+    std::atomic_int slicesDone { 0 };
+    volume.visit([&](const auto& voxels) {
+        tbb::parallel_for(tbb::blocked_range<int>(1, numSlices + 1), [&](const tbb::blocked_range<int>& range) {
+            for (int z = range.begin(); z != range.end(); z++) {
+                for (int y = 1; y < dim.y - 1; y++) {
+                    for (int x = 1; x < dim.x - 1; x++) {
+                        const float gx = (voxels.voxel(x + 1, y, z) - voxels.voxel(x - 1, y, z)) / 2.0f;
+                        const float gy = (voxels.voxel(x, y + 1, z) - voxels.voxel(x, y - 1, z)) / 2.0f;
+                        const float gz = (voxels.voxel(x, y, z + 1) - voxels.voxel(x, y, z - 1)) / 2.0f;
+
+                        const glm::vec3 v { gx, gy, gz };
+                        out[indexer(x, y, z)] = GradientVoxel { v, glm::length(v) };
+                    }
+                }
             }
-        }
-    }
+            if (progress)
+                progress(float(slicesDone.fetch_add(int(range.size())) + int(range.size())) / float(numSlices));
+        });
+    });
     return out;
 }
 
-GradientVolume::GradientVolume(const Volume& volume)
+// Compute the joint (value, gradient magnitude) histogram in parallel using per-thread histograms which are
+// merged at the end. The number of bins is bounded so the cost of building (and drawing) it does not depend
+// on the value range of the data set. The voxels and gradients are stored in the same layout so they are
+// traversed in storage order.
+static Histogram2D computeHistogram2D(const Volume& volume, gsl::span<const GradientVoxel> gradients, float maxMagnitude)
+{
+    TRACE_SCOPE("computeHistogram2D");
+    Histogram2D histogram;
+    histogram.resolution = glm::ivec2(
+        std::min(static_cast<int>(volume.maximum()) + 1, maxHistogram2DBins),
+        std::min(static_cast<int>(std::floor(maxMagnitude)) + 1, maxHistogram2DBins));
+    histogram.valueBinWidth = (volume.maximum() + 1.0f) / float(histogram.resolution.x);
+    histogram.magnitudeBinWidth = (std::floor(maxMagnitude) + 1.0f) / float(histogram.resolution.y);
+
+    const size_t numBins = static_cast<size_t>(histogram.resolution.x * histogram.resolution.y);
+    tbb::enumerable_thread_specific<std::vector<int>> localHistograms([=]() { return std::vector<int>(numBins, 0); });
+    volume.visit([&](const auto& voxels) {
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, voxels.size(), 1 << 16), [&](const tbb::blocked_range<size_t>& range) {
+            auto& localHistogram = localHistograms.local();
+            const float invValueBinWidth = 1.0f / histogram.valueBinWidth;
+            const float invMagnitudeBinWidth = 1.0f / histogram.magnitudeBinWidth;
+            for (size_t i = range.begin(); i != range.end(); i++) {
+                const int x = std::clamp(static_cast<int>(voxels[i] * invValueBinWidth), 0, histogram.resolution.x - 1);
+                const int y = std::min(static_cast<int>(gradients[i].magnitude * invMagnitudeBinWidth), histogram.resolution.y - 1);
+                localHistogram[static_cast<size_t>(x + y * histogram.resolution.x)]++;
+            }
+        });
+    });
+
+    histogram.bins.resize(numBins, 0);
+    for (const auto& localHistogram : localHistograms)
+        std::transform(std::begin(localHistogram), std::end(localHistogram), std::begin(histogram.bins), std::begin(histogram.bins), std::plus<int>());
+    // The padding of the Morton layout (zero value and zero gradient) was counted in the first bin.
+    const glm::ivec3 dim = volume.dims();
+    histogram.bins[0] -= static_cast<int>(volume.storageSize() - static_cast<size_t>(dim.x * dim.y * dim.z));
+    return histogram;
+}
+
+GradientVolume::GradientVolume(const Volume& volume, const ProgressCallback& progress)
     : m_dim(volume.dims())
-    , m_data(computeGradientVolume(volume))
-    , m_minMagnitude(computeMinMagnitude(m_data))
-    , m_maxMagnitude(computeMaxMagnitude(m_data))
+    , m_indexer(volume.indexer())
+    , m_data(computeGradientVolume(volume, progress))
 {
+    const glm::vec2 magnitudeRange = computeMagnitudeRange(m_data);
+    m_minMagnitude = magnitudeRange.x;
+    m_maxMagnitude = magnitudeRange.y;
+    m_histogram2D = computeHistogram2D(volume, m_data, m_maxMagnitude);
 }
 
 float GradientVolume::maxMagnitude() const
@@ -76,6 +134,11 @@ glm::ivec3 GradientVolume::dims() const
     return m_dim;
 }
 
+const Histogram2D& GradientVolume::histogram2D() const
+{
+    return m_histogram2D;
+}
+
 // This function returns a gradientVoxel at coord based on the current interpolation mode.
 GradientVoxel GradientVolume::getGradientInterpolate(const glm::vec3& coord) const
 {
@@ -161,7 +224,7 @@ GradientVoxel GradientVolume::linearInterpolate(const GradientVoxel& g0, const G
 // This function returns a gradientVoxel without using interpolation
 GradientVoxel GradientVolume::getGradient(int x, int y, int z) const
 {
-    const size_t i = static_cast<size_t>(x + m_dim.x * (y + m_dim.y * z));
+    const size_t i = m_indexer(x, y, z);
     return m_data[i];
 }
 }
\ No newline at end of file
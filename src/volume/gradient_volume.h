@@ -1,5 +1,6 @@
 #pragma once
 #include "volume.h"
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <string>
@@ -11,13 +12,21 @@ struct GradientVoxel {
     float magnitude;
 };
 
+// Joint histogram of voxel value (x axis) and gradient magnitude (y axis). Bin (x, y) counts the voxels with a
+// value in [x, x + 1) * valueBinWidth and a gradient magnitude in [y, y + 1) * magnitudeBinWidth.
+struct Histogram2D {
+    glm::ivec2 resolution;
+    float valueBinWidth, magnitudeBinWidth;
+    std::vector<int> bins; // Stored as bins[x + y * resolution.x].
+};
+
 class GradientVolume {
 public:
     // DO NOT REMOVE
     InterpolationMode interpolationMode { InterpolationMode::NearestNeighbour };
 
 public:
-    GradientVolume(const Volume& volume);
+    GradientVolume(const Volume& volume, const ProgressCallback& progress = {});
 
     GradientVoxel getGradientInterpolate(const glm::vec3& coord) const;
     GradientVoxel getGradient(int x, int y, int z) const;
@@ -25,6 +34,7 @@ public:
     float minMagnitude() const;
     float maxMagnitude() const;
     glm::ivec3 dims() const;
+    const Histogram2D& histogram2D() const;
 
 protected:
     GradientVoxel getGradientNearestNeighbor(const glm::vec3& coord) const;
@@ -34,7 +44,9 @@ protected:
 
 protected:
     const glm::ivec3 m_dim;
-    const std::vector<GradientVoxel> m_data;
-    const float m_minMagnitude, m_maxMagnitude;
+    const VoxelIndexer m_indexer; // Same layout as the volume.
+    const util::NumaVector<GradientVoxel> m_data; // Placed on the NUMA nodes like the voxels of the volume.
+    float m_minMagnitude, m_maxMagnitude;
+    Histogram2D m_histogram2D;
 };
 }
@@ -0,0 +1,68 @@
+#include "min_max_octree.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <glm/common.hpp>
+#include <glm/gtx/component_wise.hpp>
+#include <limits>
+
+namespace volume {
+
+MinMaxOctree::MinMaxOctree(const BrickMinMax& bricks)
+    : m_brickSize(bricks.brickSize())
+{
+    TRACE_SCOPE("MinMaxOctree::MinMaxOctree");
+    const auto brickRanges = bricks.ranges();
+    m_levels.push_back({ bricks.dims(), std::vector<glm::vec2>(std::begin(brickRanges), std::end(brickRanges)) });
+
+    // Merge 2x2x2 nodes until a single node remains. The upper levels are small (1/8th of the level below) so
+    // they are built sequentially.
+    while (glm::compMax(m_levels.back().dims) > 1) {
+        const Level& child = m_levels.back();
+        Level parent { (child.dims + 1) / 2, {} };
+        parent.ranges.resize(static_cast<size_t>(parent.dims.x * parent.dims.y * parent.dims.z),
+            glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()));
+        for (int z = 0; z < child.dims.z; z++) {
+            for (int y = 0; y < child.dims.y; y++) {
+                for (int x = 0; x < child.dims.x; x++) {
+                    const glm::vec2 childRange = child.ranges[static_cast<size_t>(x + child.dims.x * (y + child.dims.y * z))];
+                    glm::vec2& parentRange = parent.ranges[static_cast<size_t>(x / 2 + parent.dims.x * (y / 2 + parent.dims.y * (z / 2)))];
+                    parentRange = glm::vec2(std::min(parentRange.x, childRange.x), std::max(parentRange.y, childRange.y));
+                }
+            }
+        }
+        m_levels.push_back(std::move(parent));
+    }
+}
+
+int MinMaxOctree::numLevels() const
+{
+    return static_cast<int>(m_levels.size());
+}
+
+int MinMaxOctree::brickSize() const
+{
+    return m_brickSize;
+}
+
+glm::ivec3 MinMaxOctree::levelDims(int level) const
+{
+    return m_levels[static_cast<size_t>(level)].dims;
+}
+
+glm::vec2 MinMaxOctree::range(int level, const glm::ivec3& node) const
+{
+    const Level& l = m_levels[static_cast<size_t>(level)];
+    return l.ranges[static_cast<size_t>(node.x + l.dims.x * (node.y + l.dims.y * node.z))];
+}
+
+glm::vec3 MinMaxOctree::nodeLower(int level, const glm::ivec3& node) const
+{
+    return glm::vec3(node * (m_brickSize << level));
+}
+
+glm::vec3 MinMaxOctree::nodeUpper(int level, const glm::ivec3& node) const
+{
+    return glm::vec3((node + 1) * (m_brickSize << level));
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "brick_min_max.h"
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+
+namespace volume {
+
+// Hierarchy of value ranges built on top of the brick ranges. Level 0 contains the bricks themselves and every
+// node at level l + 1 covers (up to) 2x2x2 nodes of level l, so a node at level l covers a block of
+// (brickSize << l)^3 voxels. The top level consists of a single node covering the whole volume.
+class MinMaxOctree {
+public:
+    explicit MinMaxOctree(const BrickMinMax& bricks);
+
+    int numLevels() const;
+    int brickSize() const;
+    // Number of nodes along each axis at the given level.
+    glm::ivec3 levelDims(int level) const;
+    glm::vec2 range(int level, const glm::ivec3& node) const;
+
+    // Region of the node in voxel coordinates (not clamped to the volume). As with the bricks, the range of a
+    // node includes the voxels on its upper boundary.
+    glm::vec3 nodeLower(int level, const glm::ivec3& node) const;
+    glm::vec3 nodeUpper(int level, const glm::ivec3& node) const;
+
+private:
+    struct Level {
+        glm::ivec3 dims;
+        std::vector<glm::vec2> ranges;
+    };
+
+    int m_brickSize;
+    std::vector<Level> m_levels;
+};
+
+}
@@ -0,0 +1,240 @@
+#include "synthetic_volume.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+#include <numeric>
+#include <random>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <type_traits>
+
+namespace volume {
+
+static constexpr float pi = 3.14159265358979f;
+
+// Uniform random number in [0, 1].
+static float uniform(std::mt19937& rng)
+{
+    return float(rng() - std::mt19937::min()) / float(std::mt19937::max() - std::mt19937::min());
+}
+
+SyntheticVolume::SyntheticVolume(const SyntheticVolumeSettings& settings)
+    : m_settings(settings)
+{
+    TRACE_SCOPE("SyntheticVolume::SyntheticVolume");
+    // Fisher-Yates shuffle by hand because std::shuffle is implementation defined.
+    std::mt19937 rng { m_settings.seed };
+    std::array<uint8_t, 256> permutation;
+    std::iota(std::begin(permutation), std::end(permutation), uint8_t(0));
+    for (size_t i = permutation.size() - 1; i > 0; i--)
+        std::swap(permutation[i], permutation[rng() % (i + 1)]);
+    for (size_t i = 0; i < m_permutation.size(); i++)
+        m_permutation[i] = permutation[i % permutation.size()];
+
+    if (m_settings.field == SyntheticField::SparseBlobs)
+        placeBlobs();
+}
+
+// Blob centers are uniformly distributed over the volume extended by the blob radius on every side, such that
+// every voxel (also near the faces) is outside of all blobs with the same probability exp(-n * blobVolume /
+// extendedVolume). Solving for n gives the number of blobs for the requested empty fraction.
+void SyntheticVolume::placeBlobs()
+{
+    const float radius = std::max(m_settings.blobRadius, 0.5f);
+    const float emptyFraction = std::clamp(m_settings.emptyFraction, 0.01f, 1.0f);
+    const glm::vec3 lower { -radius }, extent = glm::vec3(m_settings.dim - 1) + 2.0f * radius;
+    const float blobVolume = 4.0f / 3.0f * pi * radius * radius * radius;
+    const auto numBlobs = size_t(-std::log(emptyFraction) * extent.x * extent.y * extent.z / blobVolume);
+
+    std::mt19937 rng { m_settings.seed };
+    m_blobs.resize(numBlobs);
+    for (glm::vec4& blob : m_blobs)
+        blob = glm::vec4(lower + extent * glm::vec3(uniform(rng), uniform(rng), uniform(rng)), radius);
+
+    // Bucket the blobs by the cells that they overlap (counting sort).
+    m_cellSize = int(std::ceil(2.0f * radius));
+    m_gridDims = (m_settings.dim + m_cellSize - 1) / m_cellSize;
+    const auto cellRange = [&](const glm::vec4& blob) {
+        const glm::ivec3 first = glm::clamp(glm::ivec3(glm::floor((glm::vec3(blob) - blob.w) / float(m_cellSize))), glm::ivec3(0), m_gridDims - 1);
+        const glm::ivec3 last = glm::clamp(glm::ivec3(glm::floor((glm::vec3(blob) + blob.w) / float(m_cellSize))), glm::ivec3(0), m_gridDims - 1);
+        return std::pair { first, last };
+    };
+    const auto forEachCell = [&](const glm::vec4& blob, auto&& f) {
+        const auto [first, last] = cellRange(blob);
+        for (int z = first.z; z <= last.z; z++) {
+            for (int y = first.y; y <= last.y; y++) {
+                for (int x = first.x; x <= last.x; x++)
+                    f(size_t(x + m_gridDims.x * (y + m_gridDims.y * z)));
+            }
+        }
+    };
+    m_cellOffsets.assign(size_t(m_gridDims.x * m_gridDims.y * m_gridDims.z) + 1, 0);
+    for (const glm::vec4& blob : m_blobs)
+        forEachCell(blob, [&](size_t cell) { m_cellOffsets[cell + 1]++; });
+    std::partial_sum(std::begin(m_cellOffsets), std::end(m_cellOffsets), std::begin(m_cellOffsets));
+    m_cellBlobs.resize(m_cellOffsets.back());
+    std::vector<uint32_t> cellFill(std::begin(m_cellOffsets), std::end(m_cellOffsets) - 1);
+    for (size_t i = 0; i < m_blobs.size(); i++)
+        forEachCell(m_blobs[i], [&](size_t cell) { m_cellBlobs[cellFill[cell]++] = uint32_t(i); });
+}
+
+glm::ivec3 SyntheticVolume::dims() const
+{
+    return m_settings.dim;
+}
+
+uint16_t SyntheticVolume::voxel(int x, int y, int z) const
+{
+    const float value = evaluate(glm::vec3(x, y, z));
+    return uint16_t(std::lround(std::clamp(value, 0.0f, 1.0f) * float(m_settings.maxValue)));
+}
+
+void SyntheticVolume::generateSlices(int zBegin, int zEnd, gsl::span<uint16_t> output) const
+{
+    TRACE_SCOPE("SyntheticVolume::generateSlices");
+    const glm::ivec3 dim = m_settings.dim;
+    assert(output.size() >= size_t(zEnd - zBegin) * size_t(dim.x) * size_t(dim.y));
+    tbb::parallel_for(tbb::blocked_range<int>(0, (zEnd - zBegin) * dim.y), [&](const tbb::blocked_range<int>& range) {
+        for (int yz = range.begin(); yz != range.end(); yz++) {
+            const int y = yz % dim.y;
+            const int z = zBegin + yz / dim.y;
+            for (int x = 0; x < dim.x; x++)
+                output[size_t(yz) * size_t(dim.x) + size_t(x)] = voxel(x, y, z);
+        }
+    });
+}
+
+// Convert the generated 16-bit values to another voxel type in parallel, into a buffer with the given placement.
+template <typename T>
+static util::NumaVector<T> convertVoxels(const util::NumaVector<uint16_t>& data, util::NumaPlacement placement)
+{
+    util::NumaVector<T> out;
+    util::placeBuffer(out, data.size(), placement);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, data.size(), 1 << 16), [&](const tbb::blocked_range<size_t>& range) {
+        for (size_t i = range.begin(); i != range.end(); i++) {
+            if constexpr (std::is_same_v<T, uint8_t>)
+                out[i] = uint8_t(std::min(data[i], uint16_t(255)));
+            else if constexpr (std::is_same_v<T, Half>)
+                out[i] = Half { glm::packHalf1x16(float(data[i])) };
+            else
+                out[i] = float(data[i]);
+        }
+    });
+    return out;
+}
+
+// The voxels are generated straight into placed buffers that the volume takes over, so (for 16-bit voxels) the
+// volume is never copied.
+Volume SyntheticVolume::generate(VoxelLayout layout, util::NumaPlacement placement) const
+{
+    TRACE_SCOPE("SyntheticVolume::generate");
+    const glm::ivec3 dim = m_settings.dim;
+    util::NumaVector<uint16_t> data;
+    util::placeBuffer(data, size_t(dim.x) * size_t(dim.y) * size_t(dim.z), placement);
+    generateSlices(0, dim.z, data);
+    switch (m_settings.voxelType) {
+    case VoxelType::UInt8:
+        return Volume(convertVoxels<uint8_t>(data, placement), dim, layout, placement);
+    case VoxelType::Half:
+        return Volume(convertVoxels<Half>(data, placement), dim, layout, placement);
+    case VoxelType::Float:
+        return Volume(convertVoxels<float>(data, placement), dim, layout, placement);
+    case VoxelType::UInt16:
+    default:
+        return Volume(std::move(data), dim, layout, placement);
+    }
+}
+
+float SyntheticVolume::evaluate(const glm::vec3& position) const
+{
+    // Position in [0, 1]^3.
+    const glm::vec3 normalized = position / glm::vec3(glm::max(m_settings.dim - 1, glm::ivec3(1)));
+    switch (m_settings.field) {
+    case SyntheticField::Sphere:
+        return 1.0f - 2.0f * glm::length(normalized - 0.5f);
+    case SyntheticField::Gradient:
+        return (normalized.x + normalized.y + normalized.z) / 3.0f;
+    case SyntheticField::Noise: {
+        float value = 0.0f, amplitude = 1.0f, totalAmplitude = 0.0f, frequency = m_settings.noiseFrequency;
+        for (int octave = 0; octave < std::max(m_settings.noiseOctaves, 1); octave++) {
+            value += amplitude * perlinNoise(normalized * frequency);
+            totalAmplitude += amplitude;
+            amplitude *= 0.5f;
+            frequency *= 2.0f;
+        }
+        return 0.5f + 0.5f * value / totalAmplitude;
+    }
+    case SyntheticField::SparseBlobs:
+        return sparseBlobs(position);
+    case SyntheticField::MarschnerLobb: {
+        // Marschner and Lobb, "An Evaluation of Reconstruction Filters for Volume Rendering" (1994).
+        constexpr float alpha = 0.25f, frequency = 6.0f;
+        const glm::vec3 p = 2.0f * normalized - 1.0f;
+        const float radial = std::cos(2.0f * pi * frequency * std::cos(pi * std::sqrt(p.x * p.x + p.y * p.y) / 2.0f));
+        return (1.0f - std::sin(pi * p.z / 2.0f) + alpha * (1.0f + radial)) / (2.0f * (1.0f + alpha));
+    }
+    }
+    return 0.0f;
+}
+
+static float fade(float t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// Dot product of the offset with one of the 12 edge directions of a cube selected by the hash.
+static float gradientDot(uint8_t hash, const glm::vec3& offset)
+{
+    const int h = hash & 15;
+    const float u = h < 8 ? offset.x : offset.y;
+    const float v = h < 4 ? offset.y : (h == 12 || h == 14 ? offset.x : offset.z);
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+// Improved Perlin noise (Perlin, "Improving Noise", 2002) in [-1, 1], repeating every 256 units.
+float SyntheticVolume::perlinNoise(const glm::vec3& position) const
+{
+    const glm::vec3 floored = glm::floor(position);
+    const glm::vec3 fraction = position - floored;
+    const int x = int(floored.x) & 255, y = int(floored.y) & 255, z = int(floored.z) & 255;
+    const auto hash = [&](int dx, int dy, int dz) {
+        return m_permutation[size_t(m_permutation[size_t(m_permutation[size_t(x + dx)] + y + dy)] + z + dz)];
+    };
+
+    float value = 0.0f;
+    for (int corner = 0; corner < 8; corner++) {
+        const glm::ivec3 offset { corner & 1, (corner >> 1) & 1, (corner >> 2) & 1 };
+        float weight = 1.0f;
+        for (int axis = 0; axis < 3; axis++)
+            weight *= offset[axis] ? fade(fraction[axis]) : 1.0f - fade(fraction[axis]);
+        value += weight * gradientDot(hash(offset.x, offset.y, offset.z), fraction - glm::vec3(offset));
+    }
+    return std::clamp(value, -1.0f, 1.0f);
+}
+
+// Maximum of smooth bumps (1 - d^2 / r^2) over the blobs that contain the position, mapped such that every voxel
+// inside a blob is at least 1 after quantization (the empty fraction is the fraction of exact zeros).
+float SyntheticVolume::sparseBlobs(const glm::vec3& position) const
+{
+    if (m_blobs.empty())
+        return 0.0f;
+    const glm::ivec3 cell = glm::min(glm::ivec3(position) / m_cellSize, m_gridDims - 1);
+    const size_t cellIndex = size_t(cell.x + m_gridDims.x * (cell.y + m_gridDims.y * cell.z));
+
+    float bump = -1.0f;
+    for (uint32_t i = m_cellOffsets[cellIndex]; i < m_cellOffsets[cellIndex + 1]; i++) {
+        const glm::vec4& blob = m_blobs[m_cellBlobs[i]];
+        const glm::vec3 offset = position - glm::vec3(blob);
+        bump = std::max(bump, 1.0f - glm::dot(offset, offset) / (blob.w * blob.w));
+    }
+    if (bump <= 0.0f)
+        return 0.0f;
+    const float maxValue = float(std::max(m_settings.maxValue, uint16_t(1)));
+    return (1.0f + bump * (maxValue - 1.0f)) / maxValue;
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "volume.h"
+#include "voxel_layout.h"
+#include <array>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <gsl/span>
+#include <vector>
+
+namespace volume {
+
+enum class SyntheticField {
+    Sphere, // 1 at the center, falling off linearly to 0 at the faces of the volume.
+    Gradient, // Linear ramp along the diagonal.
+    Noise, // Fractal (fBm) Perlin noise.
+    SparseBlobs, // Randomly placed round blobs in empty space.
+    MarschnerLobb // The Marschner-Lobb test signal (high frequency rings, hard to reconstruct).
+};
+
+struct SyntheticVolumeSettings {
+    SyntheticField field { SyntheticField::Sphere };
+    glm::ivec3 dim { 64 };
+    // Field values in [0, 1] are scaled to [0, maxValue] and rounded.
+    uint16_t maxValue { 255 };
+    // Voxel type of the generated Volume; UInt8 clamps the values to 255.
+    VoxelType voxelType { VoxelType::UInt16 };
+    uint32_t seed { 1 };
+
+    // Noise: number of lattice cells across the volume for the first octave, and the number of octaves.
+    float noiseFrequency { 4.0f };
+    int noiseOctaves { 4 };
+
+    // Sparse blobs: expected fraction of voxels that are zero (clamped to [0.01, 1]) and the blob radius in voxels.
+    // Voxels inside a blob are at least 1.
+    float emptyFraction { 0.9f };
+    float blobRadius { 6.0f };
+};
+
+// Procedural volumes for tests and scaling studies. Any voxel can be evaluated on its own (lazily, e.g. to stream
+// a volume that does not fit in memory slab by slab) and whole volumes are generated in parallel. The output only
+// depends on the settings: the random numbers are derived from the raw std::mt19937 output and not from the
+// (implementation defined) standard distributions.
+class SyntheticVolume {
+public:
+    explicit SyntheticVolume(const SyntheticVolumeSettings& settings);
+
+    glm::ivec3 dims() const;
+    uint16_t voxel(int x, int y, int z) const;
+    // Fill the slices [zBegin, zEnd) in linear order (x varying fastest) in parallel. The output must hold
+    // (zEnd - zBegin) * dim.x * dim.y voxels.
+    void generateSlices(int zBegin, int zEnd, gsl::span<uint16_t> output) const;
+    // Generate the whole volume in parallel. A 2048^3 volume takes 16GB (twice that while it is being copied
+    // into the Volume).
+    Volume generate(VoxelLayout layout = VoxelLayout::Linear, util::NumaPlacement placement = util::NumaPlacement::Default) const;
+
+private:
+    // Field value in [0, 1] at a voxel position.
+    float evaluate(const glm::vec3& position) const;
+    float perlinNoise(const glm::vec3& position) const;
+    float sparseBlobs(const glm::vec3& position) const;
+    void placeBlobs();
+
+private:
+    SyntheticVolumeSettings m_settings;
+
+    // Permutation table of the Perlin noise (repeated once such that lookups do not have to wrap).
+    std::array<uint8_t, 512> m_permutation;
+
+    // Blobs (center, radius) bucketed in a uniform grid of cells that are at least one blob diameter wide.
+    // The blobs that overlap cell i are m_cellBlobs[m_cellOffsets[i], m_cellOffsets[i + 1]).
+    std::vector<glm::vec4> m_blobs;
+    int m_cellSize { 1 };
+    glm::ivec3 m_gridDims { 0 };
+    std::vector<uint32_t> m_cellOffsets;
+    std::vector<uint32_t> m_cellBlobs;
+};
+
+}
@@ -1,52 +1,137 @@
 #include "volume.h"
+#include "util/trace.h"
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cctype> // isspace
 #include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <glm/glm.hpp>
 #include <gsl/span>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <string>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tuple>
+#include <type_traits>
+#include <variant>
 
 struct Header {
     glm::ivec3 dim;
-    size_t elementSize;
+    volume::VoxelType voxelType;
 };
 static Header readHeader(std::ifstream& ifs);
-static float computeMinimum(gsl::span<const uint16_t> data);
-static float computeMaximum(gsl::span<const uint16_t> data);
-static std::vector<int> computeHistogram(gsl::span<const uint16_t> data);
+template <typename T>
+static std::tuple<std::vector<int>, float, float> computeHistogram(const util::NumaVector<T>& data);
 
 namespace volume {
 
-Volume::Volume(const std::filesystem::path& file)
+Volume::Volume(const std::filesystem::path& file, const ProgressCallback& progress, VoxelLayout layout, util::NumaPlacement placement)
     : m_fileName(file.string())
+    , m_placement(placement)
 {
     using clock = std::chrono::high_resolution_clock;
     auto start = clock::now();
-    loadFile(file);
+    loadFile(file, progress);
     auto end = clock::now();
     std::cout << "Time to load: " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
 
-    if (m_data.size() > 0) {
-        m_minimum = computeMinimum(m_data);
-        m_maximum = computeMaximum(m_data);
-        m_histogram = computeHistogram(m_data);
-    }
+    if (storageSize() > 0)
+        computeStatistics();
+    applyLayout(layout);
+}
+
+Volume::Volume(std::vector<uint8_t> data, const glm::ivec3& dim, VoxelLayout layout, util::NumaPlacement placement)
+    : Volume(placeVoxels(std::move(data), placement), dim, layout, placement)
+{
+}
+
+Volume::Volume(std::vector<uint16_t> data, const glm::ivec3& dim, VoxelLayout layout, util::NumaPlacement placement)
+    : Volume(placeVoxels(std::move(data), placement), dim, layout, placement)
+{
+}
+
+Volume::Volume(std::vector<Half> data, const glm::ivec3& dim, VoxelLayout layout, util::NumaPlacement placement)
+    : Volume(placeVoxels(std::move(data), placement), dim, layout, placement)
+{
 }
 
-Volume::Volume(std::vector<uint16_t> data, const glm::ivec3& dim)
+Volume::Volume(std::vector<float> data, const glm::ivec3& dim, VoxelLayout layout, util::NumaPlacement placement)
+    : Volume(placeVoxels(std::move(data), placement), dim, layout, placement)
+{
+}
+
+template <typename T>
+Volume::Volume(util::NumaVector<T> data, const glm::ivec3& dim, VoxelLayout layout, util::NumaPlacement placement)
     : m_fileName()
-    , m_elementSize(2)
     , m_dim(dim)
+    , m_placement(placement)
     , m_data(std::move(data))
-    , m_minimum(computeMinimum(m_data))
-    , m_maximum(computeMaximum(m_data))
-    , m_histogram(computeHistogram(m_data))
 {
+    computeStatistics();
+    applyLayout(layout);
+}
+
+template Volume::Volume(util::NumaVector<uint8_t>, const glm::ivec3&, VoxelLayout, util::NumaPlacement);
+template Volume::Volume(util::NumaVector<uint16_t>, const glm::ivec3&, VoxelLayout, util::NumaPlacement);
+template Volume::Volume(util::NumaVector<Half>, const glm::ivec3&, VoxelLayout, util::NumaPlacement);
+template Volume::Volume(util::NumaVector<float>, const glm::ivec3&, VoxelLayout, util::NumaPlacement);
+
+// Copy the data into a buffer whose pages are placed on the NUMA nodes (the allocators differ so the buffer cannot
+// be moved). The data is released right away such that the layout is applied with only one copy in memory.
+template <typename T>
+util::NumaVector<T> Volume::placeVoxels(std::vector<T> data, util::NumaPlacement placement)
+{
+    util::NumaVector<T> placed;
+    util::placeBuffer(placed, data.size(), placement);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, data.size(), 1 << 16), [&](const tbb::blocked_range<size_t>& range) {
+        std::copy(std::begin(data) + std::ptrdiff_t(range.begin()), std::begin(data) + std::ptrdiff_t(range.end()), std::begin(placed) + std::ptrdiff_t(range.begin()));
+    });
+    std::vector<T>().swap(data);
+    return placed;
+}
+
+// Reorder the (linearly ordered) voxels into the given layout. Statistics must be computed before this
+// because the Morton layout contains padding.
+void Volume::applyLayout(VoxelLayout layout)
+{
+    m_indexer = VoxelIndexer(m_dim, layout);
+    if (layout == VoxelLayout::Linear)
+        return;
+
+    TRACE_SCOPE("Volume::applyLayout");
+    std::visit([&](auto& data) {
+        std::decay_t<decltype(data)> reordered;
+        util::placeBuffer(reordered, m_indexer.size(), m_placement);
+        tbb::parallel_for(tbb::blocked_range<int>(0, m_dim.z), [&](const tbb::blocked_range<int>& range) {
+            for (int z = range.begin(); z != range.end(); z++) {
+                for (int y = 0; y < m_dim.y; y++) {
+                    for (int x = 0; x < m_dim.x; x++)
+                        reordered[m_indexer(x, y, z)] = data[size_t(x + m_dim.x * (y + m_dim.y * z))];
+                }
+            }
+        });
+        data = std::move(reordered);
+    },
+        m_data);
+}
+
+// Compute the histogram, minimum and maximum in a single parallel pass and derive the cumulative histogram
+// (for percentiles) from the histogram instead of making separate passes over the data.
+void Volume::computeStatistics()
+{
+    TRACE_SCOPE("Volume::computeStatistics");
+    std::tie(m_histogram, m_minimum, m_maximum) = std::visit([](const auto& data) { return computeHistogram(data); }, m_data);
+
+    m_cumulativeHistogram.resize(m_histogram.size());
+    std::transform_inclusive_scan(std::begin(m_histogram), std::end(m_histogram), std::begin(m_cumulativeHistogram),
+        std::plus<size_t>(), [](int count) { return static_cast<size_t>(count); });
 }
 
 float Volume::minimum() const
@@ -59,16 +144,55 @@ float Volume::maximum() const
     return m_maximum;
 }
 
-std::vector<int> Volume::histogram() const
+// Histogram of the voxel values with a bin for every integer value from 0 up to and including maximum().
+const std::vector<int>& Volume::histogram() const
 {
     return m_histogram;
 }
 
+// Returns the smallest voxel value such that at least the given fraction (0 to 1) of the voxels is less than
+// or equal to it. For example percentile(0.5f) is the median and percentile(0.99f) is the 99th percentile.
+float Volume::percentile(float fraction) const
+{
+    if (m_cumulativeHistogram.empty())
+        return 0.0f;
+
+    const size_t total = m_cumulativeHistogram.back();
+    const auto threshold = static_cast<size_t>(std::ceil(double(std::clamp(fraction, 0.0f, 1.0f)) * double(total)));
+    const auto it = std::lower_bound(std::begin(m_cumulativeHistogram), std::end(m_cumulativeHistogram), std::max(threshold, size_t(1)));
+    return float(std::distance(std::begin(m_cumulativeHistogram), it));
+}
+
 glm::ivec3 Volume::dims() const
 {
     return m_dim;
 }
 
+VoxelType Volume::voxelType() const
+{
+    return VoxelType(m_data.index());
+}
+
+size_t Volume::storageSize() const
+{
+    return std::visit([](const auto& data) { return data.size(); }, m_data);
+}
+
+VoxelLayout Volume::layout() const
+{
+    return m_indexer.layout();
+}
+
+util::NumaPlacement Volume::placement() const
+{
+    return m_placement;
+}
+
+const VoxelIndexer& Volume::indexer() const
+{
+    return m_indexer;
+}
+
 std::string_view Volume::fileName() const
 {
     return m_fileName;
@@ -76,8 +200,7 @@ std::string_view Volume::fileName() const
 
 float Volume::getVoxel(int x, int y, int z) const
 {
-    const size_t i = size_t(x + m_dim.x * (y + m_dim.y * z));
-    return static_cast<float>(m_data[i]);
+    return visit([&](const auto& voxels) { return voxels.voxel(x, y, z); });
 }
 
 // This function returns a value based on the current interpolation mode
@@ -103,67 +226,27 @@ float Volume::getSampleInterpolate(const glm::vec3& coord) const
 // Notice that in this framework we assume that the distance between neighbouring voxels is 1 in all directions
 float Volume::getSampleNearestNeighbourInterpolation(const glm::vec3& coord) const
 {
-    // check if the coordinate is within volume boundaries, since we only look at direct neighbours we only need to check within 0.5
-    if (glm::any(glm::lessThan(coord + 0.5f, glm::vec3(0))) || glm::any(glm::greaterThanEqual(coord + 0.5f, glm::vec3(m_dim))))
-        return 0.0f;
-
-    // nearest neighbour simply rounds to the closest voxel positions
-    auto roundToPositiveInt = [](float f) {
-        // rounding is equal to adding 0.5 and cutting off the fractional part
-        return static_cast<int>(f + 0.5f);
-    };
-
-    return getVoxel(roundToPositiveInt(coord.x), roundToPositiveInt(coord.y), roundToPositiveInt(coord.z));
+    return visit([&](const auto& voxels) { return voxels.sampleNearestNeighbour(coord); });
 }
 
-// ======= TODO : IMPLEMENT the functions below for tri-linear interpolation ========
-// ======= Consider using the linearInterpolate and biLinearInterpolate functions ===
 // This function returns the trilinear interpolated value at the continuous 3D position given by coord.
-float Volume::getSampleTriLinearInterpolation(const glm::vec3& coord) const {
-    // Check if the given coord lies within the volume's bounds
-    if (glm::any(glm::lessThan(coord,           glm::vec3(0.0f))) ||
-        glm::any(glm::greaterThanEqual(coord,   glm::vec3(m_dim)))) { return 0.0f; }
-
-    float depthInterpFactor = coord.z - glm::floor(coord.z);
-    float nearPlaneInterp   = biLinearInterpolate({coord.x, coord.y}, static_cast<int>(glm::floor(coord.z)));
-    float farPlaneInterp    = biLinearInterpolate({coord.x, coord.y}, static_cast<int>(glm::ceil(coord.z)));
-    return linearInterpolate(nearPlaneInterp, farPlaneInterp, depthInterpFactor);
+float Volume::getSampleTriLinearInterpolation(const glm::vec3& coord) const
+{
+    return visit([&](const auto& voxels) { return voxels.sampleTriLinear(coord); });
 }
 
 // This function linearly interpolates the value at X using incoming values g0 and g1 given a factor (equal to the positon of x in 1D)
-//
-// g0--X--------g1
-//   factor
-float Volume::linearInterpolate(float g0, float g1, float factor) { return (g1 * factor) + (g0 * (1.0f - factor)); }
+float Volume::linearInterpolate(float g0, float g1, float factor)
+{
+    return volume::linearInterpolate(g0, g1, factor);
+}
 
 // This function bi-linearly interpolates the value at the given continuous 2D XY coordinate for a fixed integer z coordinate.
-float Volume::biLinearInterpolate(const glm::vec2& xyCoord, int z) const {
-    // Precompute floor calls
-    int xFloor = static_cast<int>(glm::floor(xyCoord.x));
-    int yFloor = static_cast<int>(glm::floor(xyCoord.y));
-
-    // Clamp outputs of ceil calls since they might result in an out of bounds number
-    int xCeilClamp  = static_cast<int>(glm::ceil(xyCoord.x));
-    xCeilClamp      = xCeilClamp >= m_dim.x ? m_dim.x - 1 : xCeilClamp;
-    int yCeilClamp  = static_cast<int>(glm::ceil(xyCoord.y));
-    yCeilClamp      = yCeilClamp >= m_dim.y ? m_dim.y - 1 : yCeilClamp;
-    int zClamp      = z >= m_dim.z ? m_dim.z - 1 : z;
-
-    // Get 4 nearest neighbours
-    float bottomLeft    = getVoxel(xFloor, yFloor, zClamp);
-    float bottomRight   = getVoxel(xCeilClamp, yFloor, zClamp);
-    float topLeft       = getVoxel(xFloor, yCeilClamp, zClamp);
-    float topRight      = getVoxel(xCeilClamp, yCeilClamp, zClamp);
-
-    // Interpolate horizontally, then interpolate result vertically
-    float horizontalInterpFactor    = xyCoord.x - static_cast<float>(xFloor);
-    float verticalInterpFactor      = xyCoord.y - static_cast<float>(yFloor);
-    float bottomInterp  = linearInterpolate(bottomLeft, bottomRight, horizontalInterpFactor);
-    float topInterp     = linearInterpolate(topLeft, topRight, horizontalInterpFactor);
-    return linearInterpolate(bottomInterp, topInterp, verticalInterpFactor);
+float Volume::biLinearInterpolate(const glm::vec2& xyCoord, int z) const
+{
+    return visit([&](const auto& voxels) { return voxels.biLinearInterpolate(xyCoord, z); });
 }
 
-
 // ======= OPTIONAL : This functions can be used to implement cubic interpolation ========
 // This function represents the h(x) function, which returns the weight of the cubic interpolation kernel for a given position x
 float Volume::weight(float x)
@@ -193,40 +276,59 @@ float Volume::getSampleTriCubicInterpolation(const glm::vec3& coord) const
 }
 
 // Load an fld volume data file
-// First read and parse the header, then the volume data can be directly converted from bytes to uint16_ts
-void Volume::loadFile(const std::filesystem::path& file)
+// First read and parse the header, then the voxels are read straight into storage of the type given in the header.
+void Volume::loadFile(const std::filesystem::path& file, const ProgressCallback& progress)
 {
+    TRACE_SCOPE("Volume::loadFile");
     assert(std::filesystem::exists(file));
     std::ifstream ifs(file, std::ios::binary);
     assert(ifs.is_open());
 
     const auto header = readHeader(ifs);
     m_dim = header.dim;
-    m_elementSize = header.elementSize;
-
-    const size_t voxelCount = static_cast<size_t>(header.dim.x * header.dim.y * header.dim.z);
-    const size_t byteCount = voxelCount * header.elementSize;
-    std::vector<char> buffer(byteCount);
     // Data section is separated from header by two /f characters.
     ifs.seekg(2, std::ios::cur);
-    ifs.read(buffer.data(), std::streamsize(byteCount));
 
-    m_data.resize(voxelCount);
-    if (header.elementSize == 1) { // Bytes.
-        for (size_t i = 0; i < byteCount; i++) {
-            m_data[i] = static_cast<uint16_t>(buffer[i] & 0xFF);
+    const size_t voxelCount = static_cast<size_t>(header.dim.x * header.dim.y * header.dim.z);
+    const auto read = [&](auto data) {
+        using T = typename decltype(data)::value_type;
+        util::placeBuffer(data, voxelCount, m_placement);
+        // Read in chunks so that progress can be reported while loading large files.
+        char* pBytes = reinterpret_cast<char*>(data.data());
+        const size_t byteCount = voxelCount * sizeof(T);
+        constexpr size_t chunkSize = 16 * 1024 * 1024;
+        for (size_t offset = 0; offset < byteCount; offset += chunkSize) {
+            ifs.read(pBytes + offset, std::streamsize(std::min(chunkSize, byteCount - offset)));
+            if (progress)
+                progress(float(std::min(offset + chunkSize, byteCount)) / float(byteCount));
         }
-    } else if (header.elementSize == 2) { // uint16_ts.
-        for (size_t i = 0; i < byteCount; i += 2) {
-            m_data[i / 2] = static_cast<uint16_t>((buffer[i] & 0xFF) + (buffer[i + 1] & 0xFF) * 256);
+        // The data section is little endian.
+        if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1) {
+            for (size_t i = 0; i < byteCount; i += sizeof(T))
+                std::reverse(pBytes + i, pBytes + i + sizeof(T));
         }
+        m_data = std::move(data);
+    };
+    switch (header.voxelType) {
+    case VoxelType::UInt8:
+        read(util::NumaVector<uint8_t>());
+        break;
+    case VoxelType::UInt16:
+        read(util::NumaVector<uint16_t>());
+        break;
+    case VoxelType::Half:
+        read(util::NumaVector<Half>());
+        break;
+    case VoxelType::Float:
+        read(util::NumaVector<float>());
+        break;
     }
 }
 }
 
 static Header readHeader(std::ifstream& ifs)
 {
-    Header out {};
+    Header out { glm::ivec3(0), volume::VoxelType::UInt16 };
 
     // Read input until the data section starts.
     std::string line;
@@ -260,9 +362,11 @@ static Header readHeader(std::ifstream& ifs)
                 std::cerr << "Only scalar m_data are supported" << std::endl;
         } else if (key == "data") {
             if (value == "byte") {
-                out.elementSize = 1;
+                out.voxelType = volume::VoxelType::UInt8;
             } else if (value == "short") {
-                out.elementSize = 2;
+                out.voxelType = volume::VoxelType::UInt16;
+            } else if (value == "float") {
+                out.voxelType = volume::VoxelType::Float;
             } else {
                 std::cerr << "Data type " << value << " not recognized" << std::endl;
             }
@@ -278,20 +382,58 @@ static Header readHeader(std::ifstream& ifs)
     return out;
 }
 
-static float computeMinimum(gsl::span<const uint16_t> data)
-{
-    return float(*std::min_element(std::begin(data), std::end(data)));
-}
-
-static float computeMaximum(gsl::span<const uint16_t> data)
+// Compute the histogram in parallel. Every thread counts into its own histogram (covering the full 8- or 16-bit
+// range) and the per-thread histograms are merged at the end. The result is trimmed to the maximum value.
+// Floating point voxels are counted in the bin of their integer part (clamped to the 16-bit range) and their
+// exact minimum and maximum are tracked separately. Returns the histogram, the minimum and the maximum.
+template <typename T>
+static std::tuple<std::vector<int>, float, float> computeHistogram(const util::NumaVector<T>& data)
 {
-    return float(*std::max_element(std::begin(data), std::end(data)));
-}
+    constexpr bool integral = std::is_integral_v<T>;
+    constexpr size_t numBins = std::is_same_v<T, uint8_t> ? 256 : size_t(std::numeric_limits<uint16_t>::max()) + 1;
+    struct LocalHistogram {
+        std::vector<int> histogram;
+        float minimum, maximum;
+    };
+    tbb::enumerable_thread_specific<LocalHistogram> localHistograms([]() {
+        return LocalHistogram { std::vector<int>(numBins, 0), std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+    });
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, data.size(), 1 << 16), [&](const tbb::blocked_range<size_t>& range) {
+        auto& local = localHistograms.local();
+        for (size_t i = range.begin(); i != range.end(); i++) {
+            if constexpr (integral) {
+                local.histogram[data[i]]++;
+            } else {
+                const float value = volume::voxelToFloat(data[i]);
+                local.minimum = std::min(local.minimum, value);
+                local.maximum = std::max(local.maximum, value);
+                // Also puts NaNs in the first bin.
+                local.histogram[size_t(value > 0.0f ? std::min(value, float(numBins - 1)) : 0.0f)]++;
+            }
+        }
+    });
 
-static std::vector<int> computeHistogram(gsl::span<const uint16_t> data)
-{
-    std::vector<int> histogram(size_t(*std::max_element(std::begin(data), std::end(data)) + 1), 0);
-    for (const auto v : data)
-        histogram[v]++;
-    return histogram;
+    std::vector<int> histogram(numBins, 0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, numBins), [&](const tbb::blocked_range<size_t>& range) {
+        for (const auto& local : localHistograms) {
+            for (size_t i = range.begin(); i != range.end(); i++)
+                histogram[i] += local.histogram[i];
+        }
+    });
+
+    const auto lastNonEmpty = std::find_if(std::rbegin(histogram), std::rend(histogram), [](int count) { return count > 0; });
+    histogram.resize(std::max(size_t(std::distance(lastNonEmpty, std::rend(histogram))), size_t(1)));
+
+    float minimum = std::numeric_limits<float>::max(), maximum = std::numeric_limits<float>::lowest();
+    if constexpr (integral) {
+        const auto firstNonEmpty = std::find_if(std::begin(histogram), std::end(histogram), [](int count) { return count > 0; });
+        minimum = float(std::distance(std::begin(histogram), firstNonEmpty));
+        maximum = float(histogram.size() - 1);
+    } else {
+        for (const auto& local : localHistograms) {
+            minimum = std::min(minimum, local.minimum);
+            maximum = std::max(maximum, local.maximum);
+        }
+    }
+    return { std::move(histogram), minimum, maximum };
 }
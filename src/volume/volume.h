@@ -1,8 +1,16 @@
 #pragma once
+#include "util/numa.h"
+#include "voxel_grid.h"
+#include "voxel_layout.h"
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <gsl/span>
 #include <string>
+#include <type_traits>
+#include <variant>
 #include <vector>
 
 namespace volume {
@@ -13,20 +21,54 @@ enum class InterpolationMode {
     Cubic
 };
 
+// Called with the fraction (0 to 1) of the work that has been completed. May be called from any thread.
+using ProgressCallback = std::function<void(float)>;
+
 class Volume {
 public:
     // DO NOT REMOVE
     InterpolationMode interpolationMode { InterpolationMode::NearestNeighbour };
 
 public:
-    Volume(const std::filesystem::path& file);
-    Volume(std::vector<uint16_t> data, const glm::ivec3& dim);
+    // The progress callback reports the progress of reading the file; statistics are computed afterwards.
+    Volume(const std::filesystem::path& file, const ProgressCallback& progress = {}, VoxelLayout layout = VoxelLayout::Linear,
+        util::NumaPlacement placement = util::NumaPlacement::Default);
+    // The data is given in linear order (x varying fastest) and stored in the requested layout. The voxel type
+    // follows from the element type of the data.
+    Volume(std::vector<uint8_t> data, const glm::ivec3& dim, VoxelLayout layout = VoxelLayout::Linear,
+        util::NumaPlacement placement = util::NumaPlacement::Default);
+    Volume(std::vector<uint16_t> data, const glm::ivec3& dim, VoxelLayout layout = VoxelLayout::Linear,
+        util::NumaPlacement placement = util::NumaPlacement::Default);
+    Volume(std::vector<Half> data, const glm::ivec3& dim, VoxelLayout layout = VoxelLayout::Linear,
+        util::NumaPlacement placement = util::NumaPlacement::Default);
+    Volume(std::vector<float> data, const glm::ivec3& dim, VoxelLayout layout = VoxelLayout::Linear,
+        util::NumaPlacement placement = util::NumaPlacement::Default);
+    // Takes over a buffer that was already placed with util::placeBuffer (using the same placement) without copying
+    // it. The std::vector constructors have to copy the data into such a buffer.
+    template <typename T>
+    Volume(util::NumaVector<T> data, const glm::ivec3& dim, VoxelLayout layout = VoxelLayout::Linear,
+        util::NumaPlacement placement = util::NumaPlacement::Default);
 
     float minimum() const;
     float maximum() const;
-    std::vector<int> histogram() const;
+    const std::vector<int>& histogram() const;
+    float percentile(float fraction) const;
     glm::ivec3 dims() const;
     std::string_view fileName() const;
+    VoxelType voxelType() const;
+    // Raw voxel values in storage order (see layout()); includes the padding of the Morton layout. T must match
+    // voxelType() (throws std::bad_variant_access otherwise).
+    template <typename T>
+    gsl::span<const T> voxels() const;
+    // Number of stored voxels (including the padding of the Morton layout).
+    size_t storageSize() const;
+    // Call f with the typed voxels (a VoxelGrid<T> for the voxel type of this volume) and return its result.
+    template <typename F>
+    decltype(auto) visit(F&& f) const;
+    VoxelLayout layout() const;
+    // How the voxels (and the gradients computed from them) are placed on the NUMA nodes.
+    util::NumaPlacement placement() const;
+    const VoxelIndexer& indexer() const;
 
     float getSampleInterpolate(const glm::vec3& coord) const;
     float getVoxel(int x, int y, int z) const;
@@ -44,16 +86,41 @@ protected:
     static float weight(float x);
 
 private:
-    void loadFile(const std::filesystem::path& file);
+    using VoxelStorage = std::variant<util::NumaVector<uint8_t>, util::NumaVector<uint16_t>, util::NumaVector<Half>, util::NumaVector<float>>;
+    template <typename T>
+    static util::NumaVector<T> placeVoxels(std::vector<T> data, util::NumaPlacement placement);
+
+    void loadFile(const std::filesystem::path& file, const ProgressCallback& progress);
+    void computeStatistics();
+    void applyLayout(VoxelLayout layout);
 
 protected:
     const std::string m_fileName;
-    size_t m_elementSize;
     glm::ivec3 m_dim;
 
-    std::vector<uint16_t> m_data;
+    util::NumaPlacement m_placement;
+    VoxelStorage m_data;
+    VoxelIndexer m_indexer { glm::ivec3(0), VoxelLayout::Linear };
 
+    // Statistics are computed once (in a single parallel pass) when the volume is created.
     float m_minimum, m_maximum;
     std::vector<int> m_histogram;
+    std::vector<size_t> m_cumulativeHistogram;
 };
+
+template <typename T>
+gsl::span<const T> Volume::voxels() const
+{
+    return std::get<util::NumaVector<T>>(m_data);
+}
+
+template <typename F>
+decltype(auto) Volume::visit(F&& f) const
+{
+    return std::visit([&](const auto& data) -> decltype(auto) {
+        using T = typename std::decay_t<decltype(data)>::value_type;
+        return f(VoxelGrid<T>(data, m_indexer, m_dim));
+    },
+        m_data);
+}
 }
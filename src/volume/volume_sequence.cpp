@@ -0,0 +1,371 @@
+#include "volume_sequence.h"
+#include "util/trace.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace volume {
+
+static VolumeSequenceSettings validateSettings(VolumeSequenceSettings settings);
+static void widenVoxels(const Volume& volume, std::vector<uint16_t>& data);
+
+VolumeSequence::VolumeSequence(std::vector<std::filesystem::path> frameFiles, const VolumeSequenceSettings& settings)
+    : m_frameFiles(std::move(frameFiles))
+    , m_settings(validateSettings(settings))
+    , m_compressedFrames(m_frameFiles.size())
+{
+    // Frame indices are taken modulo the number of frames.
+    if (m_frameFiles.empty())
+        throw std::runtime_error("A volume sequence needs at least one frame");
+    m_prefetchThread = std::thread([this]() { prefetchLoop(); });
+}
+
+VolumeSequence::~VolumeSequence()
+{
+    {
+        std::scoped_lock lock { m_mutex };
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    if (m_prefetchThread.joinable())
+        m_prefetchThread.join();
+}
+
+std::vector<std::filesystem::path> VolumeSequence::findFrameFiles(const std::filesystem::path& directory)
+{
+    std::vector<std::filesystem::path> out;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".fld")
+            out.push_back(entry.path());
+    }
+    std::sort(std::begin(out), std::end(out));
+    return out;
+}
+
+size_t VolumeSequence::numFrames() const
+{
+    return m_frameFiles.size();
+}
+
+void VolumeSequence::setPlayhead(size_t index)
+{
+    {
+        std::scoped_lock lock { m_mutex };
+        m_playhead = index % numFrames();
+    }
+    m_condition.notify_all();
+}
+
+std::shared_ptr<Volume> VolumeSequence::frame(size_t index)
+{
+    index %= numFrames();
+    std::unique_lock lock { m_mutex };
+    while (true) {
+        if (auto iter = m_cache.find(index); iter != std::end(m_cache)) {
+            iter->second.lastUse = ++m_useCounter;
+            return iter->second.pVolume;
+        }
+        if (!m_inFlight.contains(index))
+            break;
+        // The prefetcher is already loading this frame.
+        m_condition.wait(lock);
+    }
+
+    m_inFlight.insert(index);
+    lock.unlock();
+    auto pVolume = loadFrame(index);
+    lock.lock();
+    m_inFlight.erase(index);
+    insertFrame(index, pVolume);
+    lock.unlock();
+    m_condition.notify_all();
+    return pVolume;
+}
+
+std::shared_ptr<Volume> VolumeSequence::tryFrame(size_t index)
+{
+    std::scoped_lock lock { m_mutex };
+    if (auto iter = m_cache.find(index % numFrames()); iter != std::end(m_cache)) {
+        iter->second.lastUse = ++m_useCounter;
+        return iter->second.pVolume;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<GradientVolume> VolumeSequence::gradientVolume(size_t index)
+{
+    index %= numFrames();
+    const auto pVolume = frame(index);
+
+    std::unique_lock lock { m_mutex };
+    while (true) {
+        if (auto iter = m_cache.find(index); iter != std::end(m_cache) && iter->second.pGradientVolume)
+            return iter->second.pGradientVolume;
+        if (!m_inFlight.contains(index))
+            break;
+        m_condition.wait(lock);
+    }
+
+    m_inFlight.insert(index);
+    lock.unlock();
+    auto pGradientVolume = std::make_shared<GradientVolume>(*pVolume);
+    lock.lock();
+    m_inFlight.erase(index);
+    // The frame may have been evicted in the mean time; the caller still gets its gradients.
+    if (auto iter = m_cache.find(index); iter != std::end(m_cache) && iter->second.pVolume == pVolume)
+        iter->second.pGradientVolume = pGradientVolume;
+    lock.unlock();
+    m_condition.notify_all();
+    return pGradientVolume;
+}
+
+std::shared_ptr<GradientVolume> VolumeSequence::tryGradientVolume(size_t index)
+{
+    std::scoped_lock lock { m_mutex };
+    if (auto iter = m_cache.find(index % numFrames()); iter != std::end(m_cache))
+        return iter->second.pGradientVolume;
+    return nullptr;
+}
+
+void VolumeSequence::setPrefetchGradients(bool prefetchGradients)
+{
+    {
+        std::scoped_lock lock { m_mutex };
+        m_prefetchGradients = prefetchGradients;
+    }
+    m_condition.notify_all();
+}
+
+size_t VolumeSequence::compressedBytes() const
+{
+    std::scoped_lock lock { m_compressedMutex };
+    return m_compressedBytes;
+}
+
+// Background thread: load the frames in the prefetch window (closest to the playhead first) and, if
+// requested, compute their gradients. Sleeps until the playhead moves when there is nothing left to do.
+void VolumeSequence::prefetchLoop()
+{
+    std::unique_lock lock { m_mutex };
+    while (!m_stop) {
+        std::optional<size_t> optIndex;
+        bool computeGradients = false;
+        for (size_t i = 0; i <= m_settings.prefetchCount && !optIndex; i++) {
+            const size_t index = (m_playhead + i) % numFrames();
+            if (m_inFlight.contains(index))
+                continue;
+            if (auto iter = m_cache.find(index); iter == std::end(m_cache)) {
+                optIndex = index;
+            } else if (m_prefetchGradients && !iter->second.pGradientVolume) {
+                optIndex = index;
+                computeGradients = true;
+            }
+        }
+        if (!optIndex) {
+            m_condition.wait(lock);
+            continue;
+        }
+
+        const size_t index = *optIndex;
+        m_inFlight.insert(index);
+        if (computeGradients) {
+            const auto pVolume = m_cache[index].pVolume;
+            lock.unlock();
+            auto pGradientVolume = std::make_shared<GradientVolume>(*pVolume);
+            lock.lock();
+            if (auto iter = m_cache.find(index); iter != std::end(m_cache) && iter->second.pVolume == pVolume)
+                iter->second.pGradientVolume = std::move(pGradientVolume);
+        } else {
+            lock.unlock();
+            auto pVolume = loadFrame(index);
+            lock.lock();
+            insertFrame(index, std::move(pVolume));
+        }
+        m_inFlight.erase(index);
+        m_condition.notify_all();
+    }
+}
+
+// Load a frame from the compressed frames if possible and from disk otherwise. Frames use the linear voxel
+// layout so the stored data of a frame can be passed straight back to the Volume constructor.
+std::shared_ptr<Volume> VolumeSequence::loadFrame(size_t index)
+{
+    TRACE_SCOPE("VolumeSequence::loadFrame");
+    if (m_settings.deltaCompression) {
+        std::vector<uint16_t> data;
+        glm::ivec3 dim;
+        VoxelType voxelType;
+        if (decompressFrame(index, data, dim, voxelType)) {
+            if (voxelType == VoxelType::UInt8) {
+                std::vector<uint8_t> narrowed(data.size());
+                std::transform(std::begin(data), std::end(data), std::begin(narrowed), [](uint16_t value) { return static_cast<uint8_t>(value); });
+                return std::make_shared<Volume>(std::move(narrowed), dim);
+            }
+            return std::make_shared<Volume>(std::move(data), dim);
+        }
+    }
+
+    auto pVolume = std::make_shared<Volume>(m_frameFiles[index]);
+    // Floating point frames are not compressed: the delta coding works on 16-bit integers.
+    if (m_settings.deltaCompression && (pVolume->voxelType() == VoxelType::UInt8 || pVolume->voxelType() == VoxelType::UInt16))
+        compressFrame(index, *pVolume);
+    return pVolume;
+}
+
+std::shared_ptr<Volume> VolumeSequence::cachedFrame(size_t index) const
+{
+    std::scoped_lock lock { m_mutex };
+    if (auto iter = m_cache.find(index); iter != std::end(m_cache))
+        return iter->second.pVolume;
+    return nullptr;
+}
+
+bool VolumeSequence::isInPrefetchWindow(size_t index) const
+{
+    const size_t distance = (index + numFrames() - m_playhead) % numFrames();
+    return distance <= m_settings.prefetchCount;
+}
+
+// Insert a frame into the cache and evict the least recently used frames outside of the prefetch window
+// (or, if all frames are in the window, the least recently used frame other than the new one).
+void VolumeSequence::insertFrame(size_t index, std::shared_ptr<Volume> pVolume)
+{
+    m_cache[index] = CachedFrame { std::move(pVolume), nullptr, ++m_useCounter };
+
+    while (m_cache.size() > m_settings.cacheCapacity) {
+        auto victim = std::end(m_cache);
+        bool victimInWindow = true;
+        for (auto iter = std::begin(m_cache); iter != std::end(m_cache); iter++) {
+            if (iter->first == index)
+                continue;
+            const bool inWindow = isInPrefetchWindow(iter->first);
+            if (victim == std::end(m_cache) || (victimInWindow && !inWindow) || (inWindow == victimInWindow && iter->second.lastUse < victim->second.lastUse)) {
+                victim = iter;
+                victimInWindow = inWindow;
+            }
+        }
+        if (victim == std::end(m_cache))
+            break;
+        m_cache.erase(victim);
+    }
+}
+
+// Store the frame as the delta to the previous time step (or as a key frame if the previous time step is
+// not stored, has different dimensions or the chain of deltas would become too long).
+void VolumeSequence::compressFrame(size_t index, const Volume& volume)
+{
+    TRACE_SCOPE("VolumeSequence::compressFrame");
+    std::scoped_lock lock { m_compressedMutex };
+    if (m_compressedFrames[index])
+        return;
+
+    std::vector<uint16_t> reference;
+    size_t chainLength = 0;
+    if (index > 0 && m_compressedFrames[index - 1] && m_compressedFrames[index - 1]->voxelType == volume.voxelType()
+        && m_compressedFrames[index - 1]->chainLength + 1 < m_settings.keyFrameInterval) {
+        glm::ivec3 referenceDim;
+        if (decompressFrameLocked(index - 1, reference, referenceDim) && referenceDim == volume.dims())
+            chainLength = m_compressedFrames[index - 1]->chainLength + 1;
+        else
+            reference.clear();
+    }
+
+    std::vector<uint16_t> data;
+    widenVoxels(volume, data);
+    CompressedFrame compressedFrame { chainLength == 0, chainLength, volume.dims(), volume.voxelType(), encodeDelta(data, reference) };
+    const size_t numBytes = compressedFrame.runs.size() * sizeof(uint16_t);
+    if (m_compressedBytes + numBytes > m_settings.compressedBudgetBytes)
+        return;
+    m_compressedBytes += numBytes;
+    m_compressedFrames[index] = std::move(compressedFrame);
+}
+
+bool VolumeSequence::decompressFrame(size_t index, std::vector<uint16_t>& data, glm::ivec3& dim, VoxelType& voxelType) const
+{
+    TRACE_SCOPE("VolumeSequence::decompressFrame");
+    std::scoped_lock lock { m_compressedMutex };
+    if (!decompressFrameLocked(index, data, dim))
+        return false;
+    voxelType = m_compressedFrames[index]->voxelType;
+    return true;
+}
+
+bool VolumeSequence::decompressFrameLocked(size_t index, std::vector<uint16_t>& data, glm::ivec3& dim) const
+{
+    const auto& optCompressedFrame = m_compressedFrames[index];
+    if (!optCompressedFrame)
+        return false;
+
+    const size_t numVoxels = static_cast<size_t>(optCompressedFrame->dim.x * optCompressedFrame->dim.y * optCompressedFrame->dim.z);
+    if (optCompressedFrame->keyFrame) {
+        data.assign(numVoxels, 0);
+    } else {
+        // Start from the previous time step; use the decoded frame if it is still cached.
+        if (const auto pPrevious = cachedFrame(index - 1); pPrevious && pPrevious->dims() == optCompressedFrame->dim && pPrevious->voxelType() == optCompressedFrame->voxelType)
+            widenVoxels(*pPrevious, data);
+        else if (!decompressFrameLocked(index - 1, data, dim))
+            return false;
+    }
+    applyDelta(optCompressedFrame->runs, data);
+    dim = optCompressedFrame->dim;
+    return true;
+}
+
+static VolumeSequenceSettings validateSettings(VolumeSequenceSettings settings)
+{
+    // The cache must be able to hold the playhead and all prefetched frames.
+    settings.cacheCapacity = std::max(settings.cacheCapacity, settings.prefetchCount + 1);
+    settings.keyFrameInterval = std::max(settings.keyFrameInterval, size_t(1));
+    return settings;
+}
+
+// Copy the voxels of a frame (which has the linear layout and 8- or 16-bit voxels) as 16-bit values.
+static void widenVoxels(const Volume& volume, std::vector<uint16_t>& data)
+{
+    if (volume.voxelType() == VoxelType::UInt8) {
+        const gsl::span<const uint8_t> voxels = volume.voxels<uint8_t>();
+        data.resize(voxels.size());
+        std::copy(std::begin(voxels), std::end(voxels), std::begin(data));
+    } else {
+        const gsl::span<const uint16_t> voxels = volume.voxels<uint16_t>();
+        data.assign(std::begin(voxels), std::end(voxels));
+    }
+}
+
+// Both counts are limited to 65535; consecutive time steps are mostly identical so the XOR is mostly zero.
+std::vector<uint16_t> encodeDelta(gsl::span<const uint16_t> data, gsl::span<const uint16_t> reference)
+{
+    constexpr size_t maxRun = std::numeric_limits<uint16_t>::max();
+    auto delta = [&](size_t i) { return reference.empty() ? data[i] : uint16_t(data[i] ^ reference[i]); };
+
+    std::vector<uint16_t> runs;
+    size_t i = 0;
+    while (i < data.size()) {
+        const size_t zerosStart = i;
+        while (i < data.size() && i - zerosStart < maxRun && delta(i) == 0)
+            i++;
+        runs.push_back(static_cast<uint16_t>(i - zerosStart));
+
+        const size_t countIndex = runs.size();
+        runs.push_back(0);
+        const size_t literalsStart = i;
+        while (i < data.size() && i - literalsStart < maxRun && delta(i) != 0)
+            runs.push_back(delta(i++));
+        runs[countIndex] = static_cast<uint16_t>(i - literalsStart);
+    }
+    runs.shrink_to_fit();
+    return runs;
+}
+
+void applyDelta(gsl::span<const uint16_t> runs, gsl::span<uint16_t> data)
+{
+    size_t i = 0;
+    for (size_t r = 0; r < runs.size();) {
+        i += runs[r++];
+        const size_t numLiterals = runs[r++];
+        for (size_t l = 0; l < numLiterals; l++)
+            data[i++] ^= runs[r++];
+    }
+}
+
+}
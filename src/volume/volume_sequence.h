@@ -0,0 +1,126 @@
+#pragma once
+#include "gradient_volume.h"
+#include "volume.h"
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <glm/vec3.hpp>
+#include <gsl/span>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace volume {
+
+struct VolumeSequenceSettings {
+    // Maximum number of decoded frames kept in memory (including the prefetched frames).
+    size_t cacheCapacity { 8 };
+    // Number of frames after the playhead that are loaded in the background.
+    size_t prefetchCount { 4 };
+
+    // Keep a compressed copy of every frame that was read: the XOR with the previous frame (consecutive time
+    // steps are mostly identical) followed by run-length encoding of the zeros. Frames are then decoded from
+    // memory instead of being read from disk again when playback loops.
+    bool deltaCompression { false };
+    // Memory budget of the compressed frames. Frames that do not fit are read from disk.
+    size_t compressedBudgetBytes { size_t(1) << 30 };
+    // Maximum number of deltas between two key frames (which are stored without delta) to bound decode time.
+    size_t keyFrameInterval { 16 };
+};
+
+// A time series of volumes (one FLD file per time step) that is played back without keeping the whole
+// sequence in memory. A background thread prefetches the frames following the playhead into a bounded
+// cache. Gradient volumes are only computed on request (or prefetched when enabled with setPrefetchGradients).
+//
+// Frames are returned as shared pointers so a frame that is evicted from the cache stays valid while the
+// caller (e.g. the renderer) still uses it.
+class VolumeSequence {
+public:
+    // Throws std::runtime_error if there are no frame files.
+    VolumeSequence(std::vector<std::filesystem::path> frameFiles, const VolumeSequenceSettings& settings = {});
+    ~VolumeSequence();
+
+    VolumeSequence(const VolumeSequence&) = delete;
+    VolumeSequence& operator=(const VolumeSequence&) = delete;
+
+    // All FLD files in the directory, sorted by file name.
+    static std::vector<std::filesystem::path> findFrameFiles(const std::filesystem::path& directory);
+
+    size_t numFrames() const;
+
+    // Move the playhead; the prefetcher loads the frames following it. Frames wrap around (playback loops).
+    void setPlayhead(size_t index);
+    // Return the frame, loading it on the calling thread if it is not cached yet.
+    std::shared_ptr<Volume> frame(size_t index);
+    // Return the frame or nullptr if it has not been loaded yet (does not block).
+    std::shared_ptr<Volume> tryFrame(size_t index);
+
+    // Return the gradient volume of the frame, computing it on the calling thread if needed.
+    std::shared_ptr<GradientVolume> gradientVolume(size_t index);
+    // Return the gradient volume or nullptr if it has not been computed yet (does not block).
+    std::shared_ptr<GradientVolume> tryGradientVolume(size_t index);
+    // Whether the prefetcher should also compute the gradient volumes of the upcoming frames.
+    void setPrefetchGradients(bool prefetchGradients);
+
+    // Memory used by the delta compressed frames.
+    size_t compressedBytes() const;
+
+private:
+    struct CachedFrame {
+        std::shared_ptr<Volume> pVolume;
+        std::shared_ptr<GradientVolume> pGradientVolume;
+        uint64_t lastUse;
+    };
+    struct CompressedFrame {
+        bool keyFrame;
+        size_t chainLength; // Number of deltas since the last key frame.
+        glm::ivec3 dim;
+        VoxelType voxelType; // UInt8 or UInt16; 8-bit voxels are widened to 16 bits for the delta coding.
+        std::vector<uint16_t> runs;
+    };
+
+    void prefetchLoop();
+    std::shared_ptr<Volume> loadFrame(size_t index);
+    std::shared_ptr<Volume> cachedFrame(size_t index) const;
+    // Must be called while holding m_mutex.
+    bool isInPrefetchWindow(size_t index) const;
+    void insertFrame(size_t index, std::shared_ptr<Volume> pVolume);
+
+    void compressFrame(size_t index, const Volume& volume);
+    bool decompressFrame(size_t index, std::vector<uint16_t>& data, glm::ivec3& dim, VoxelType& voxelType) const;
+    // Must be called while holding m_compressedMutex.
+    bool decompressFrameLocked(size_t index, std::vector<uint16_t>& data, glm::ivec3& dim) const;
+
+private:
+    const std::vector<std::filesystem::path> m_frameFiles;
+    const VolumeSequenceSettings m_settings;
+
+    // Protects the decoded frame cache, the in flight set and the prefetcher state.
+    mutable std::mutex m_mutex;
+    // Signaled when the playhead moves, when a frame finished loading and on destruction.
+    std::condition_variable m_condition;
+    std::unordered_map<size_t, CachedFrame> m_cache;
+    std::unordered_set<size_t> m_inFlight;
+    size_t m_playhead { 0 };
+    uint64_t m_useCounter { 0 };
+    bool m_prefetchGradients { false };
+    bool m_stop { false };
+
+    mutable std::mutex m_compressedMutex;
+    std::vector<std::optional<CompressedFrame>> m_compressedFrames;
+    size_t m_compressedBytes { 0 };
+
+    std::thread m_prefetchThread;
+};
+
+// Delta coding of the compressed frames. Encodes data XOR reference (or data itself if reference is empty) as a
+// sequence of blocks: [number of zeros] [number of literals] [literals...]
+std::vector<uint16_t> encodeDelta(gsl::span<const uint16_t> data, gsl::span<const uint16_t> reference);
+// XOR the encoded delta into data.
+void applyDelta(gsl::span<const uint16_t> runs, gsl::span<uint16_t> data);
+
+}
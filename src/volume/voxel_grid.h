@@ -0,0 +1,157 @@
+#pragma once
+#include "voxel_layout.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/common.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <gsl/span>
+// MSVC does not define __F16C__; every CPU that supports AVX2 also supports F16C.
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define VOLVIS_HAS_F16C 1
+#include <immintrin.h>
+#endif
+
+namespace volume {
+
+// Element type of the stored voxels. Volumes keep the width of the file they were read from; 8-bit data takes
+// half the memory (and memory bandwidth) of 16-bit data. All types are converted to float when sampled.
+enum class VoxelType {
+    UInt8 = 0,
+    UInt16,
+    Half,
+    Float
+};
+
+// IEEE 754 half precision float. Only used for storage.
+struct Half {
+    uint16_t bits;
+};
+
+inline float voxelToFloat(uint8_t value)
+{
+    return static_cast<float>(value);
+}
+inline float voxelToFloat(uint16_t value)
+{
+    return static_cast<float>(value);
+}
+inline float voxelToFloat(Half value)
+{
+#ifdef VOLVIS_HAS_F16C
+    return _cvtsh_ss(value.bits);
+#else
+    return glm::unpackHalf1x16(value.bits);
+#endif
+}
+inline float voxelToFloat(float value)
+{
+    return value;
+}
+
+// This function linearly interpolates the value at X using incoming values g0 and g1 given a factor (equal to the positon of x in 1D)
+//
+// g0--X--------g1
+//   factor
+inline float linearInterpolate(float g0, float g1, float factor)
+{
+    return (g1 * factor) + (g0 * (1.0f - factor));
+}
+
+// Typed view of the voxels of a Volume (see Volume::visit). The voxel access and the sampling functions are
+// instantiated for every voxel type so that loops which take many samples only dispatch on the type once
+// instead of for every voxel.
+template <typename T>
+class VoxelGrid {
+public:
+    using value_type = T;
+
+    VoxelGrid(gsl::span<const T> voxels, const VoxelIndexer& indexer, const glm::ivec3& dim)
+        : m_voxels(voxels)
+        , m_pIndexer(&indexer)
+        , m_dim(dim)
+    {
+    }
+
+    glm::ivec3 dims() const { return m_dim; }
+    // Number of stored voxels and access in storage order (includes the padding of the Morton layout).
+    size_t size() const { return m_voxels.size(); }
+    float operator[](size_t i) const { return voxelToFloat(m_voxels[i]); }
+
+    float voxel(int x, int y, int z) const { return voxelToFloat(m_voxels[(*m_pIndexer)(x, y, z)]); }
+
+    float sampleNearestNeighbour(const glm::vec3& coord) const;
+    float sampleTriLinear(const glm::vec3& coord) const;
+    float biLinearInterpolate(const glm::vec2& xyCoord, int z) const;
+
+private:
+    gsl::span<const T> m_voxels;
+    const VoxelIndexer* m_pIndexer;
+    glm::ivec3 m_dim;
+};
+
+// This function returns the nearest neighbour value at the continuous 3D position given by coord.
+// Notice that in this framework we assume that the distance between neighbouring voxels is 1 in all directions
+template <typename T>
+float VoxelGrid<T>::sampleNearestNeighbour(const glm::vec3& coord) const
+{
+    // check if the coordinate is within volume boundaries, since we only look at direct neighbours we only need to check within 0.5
+    // (scalar comparisons: this check runs for every sample of a ray)
+    const glm::vec3 shifted = coord + 0.5f;
+    if (shifted.x < 0.0f || shifted.y < 0.0f || shifted.z < 0.0f || shifted.x >= static_cast<float>(m_dim.x) || shifted.y >= static_cast<float>(m_dim.y) || shifted.z >= static_cast<float>(m_dim.z))
+        return 0.0f;
+
+    // nearest neighbour simply rounds to the closest voxel positions
+    auto roundToPositiveInt = [](float f) {
+        // rounding is equal to adding 0.5 and cutting off the fractional part
+        return static_cast<int>(f + 0.5f);
+    };
+
+    return voxel(roundToPositiveInt(coord.x), roundToPositiveInt(coord.y), roundToPositiveInt(coord.z));
+}
+
+// This function returns the trilinear interpolated value at the continuous 3D position given by coord.
+template <typename T>
+float VoxelGrid<T>::sampleTriLinear(const glm::vec3& coord) const
+{
+    // Check if the given coord lies within the volume's bounds
+    if (coord.x < 0.0f || coord.y < 0.0f || coord.z < 0.0f || coord.x >= static_cast<float>(m_dim.x) || coord.y >= static_cast<float>(m_dim.y) || coord.z >= static_cast<float>(m_dim.z))
+        return 0.0f;
+
+    float depthInterpFactor = coord.z - glm::floor(coord.z);
+    float nearPlaneInterp = biLinearInterpolate({ coord.x, coord.y }, static_cast<int>(glm::floor(coord.z)));
+    float farPlaneInterp = biLinearInterpolate({ coord.x, coord.y }, static_cast<int>(glm::ceil(coord.z)));
+    return linearInterpolate(nearPlaneInterp, farPlaneInterp, depthInterpFactor);
+}
+
+// This function bi-linearly interpolates the value at the given continuous 2D XY coordinate for a fixed integer z coordinate.
+template <typename T>
+float VoxelGrid<T>::biLinearInterpolate(const glm::vec2& xyCoord, int z) const
+{
+    // Precompute floor calls
+    int xFloor = static_cast<int>(glm::floor(xyCoord.x));
+    int yFloor = static_cast<int>(glm::floor(xyCoord.y));
+
+    // Clamp outputs of ceil calls since they might result in an out of bounds number
+    int xCeilClamp = static_cast<int>(glm::ceil(xyCoord.x));
+    xCeilClamp = xCeilClamp >= m_dim.x ? m_dim.x - 1 : xCeilClamp;
+    int yCeilClamp = static_cast<int>(glm::ceil(xyCoord.y));
+    yCeilClamp = yCeilClamp >= m_dim.y ? m_dim.y - 1 : yCeilClamp;
+    int zClamp = z >= m_dim.z ? m_dim.z - 1 : z;
+
+    // Get 4 nearest neighbours
+    float bottomLeft = voxel(xFloor, yFloor, zClamp);
+    float bottomRight = voxel(xCeilClamp, yFloor, zClamp);
+    float topLeft = voxel(xFloor, yCeilClamp, zClamp);
+    float topRight = voxel(xCeilClamp, yCeilClamp, zClamp);
+
+    // Interpolate horizontally, then interpolate result vertically
+    float horizontalInterpFactor = xyCoord.x - static_cast<float>(xFloor);
+    float verticalInterpFactor = xyCoord.y - static_cast<float>(yFloor);
+    float bottomInterp = linearInterpolate(bottomLeft, bottomRight, horizontalInterpFactor);
+    float topInterp = linearInterpolate(topLeft, topRight, horizontalInterpFactor);
+    return linearInterpolate(bottomInterp, topInterp, verticalInterpFactor);
+}
+
+}
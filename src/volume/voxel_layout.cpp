@@ -0,0 +1,58 @@
+#include "voxel_layout.h"
+#include <algorithm>
+
+namespace volume {
+
+// Number of bits needed to store the coordinates 0 to dim - 1.
+static int numBits(int dim)
+{
+    int bits = 0;
+    while ((1 << bits) < dim)
+        bits++;
+    return bits;
+}
+
+// Software version of pdep: deposit the low bits of value into the set bits of mask.
+static uint64_t depositBits(uint64_t value, uint64_t mask)
+{
+    uint64_t out = 0;
+    for (uint64_t bit = 1; mask != 0; bit <<= 1) {
+        const uint64_t lowestMaskBit = mask & (~mask + 1);
+        if (value & bit)
+            out |= lowestMaskBit;
+        mask &= mask - 1;
+    }
+    return out;
+}
+
+VoxelIndexer::VoxelIndexer(const glm::ivec3& dim, VoxelLayout layout)
+    : m_dim(dim)
+    , m_layout(layout)
+    , m_size(size_t(dim.x) * size_t(dim.y) * size_t(dim.z))
+    , m_strides { 1, size_t(dim.x), size_t(dim.x) * size_t(dim.y) }
+    , m_masks { 0, 0, 0 }
+{
+    if (layout != VoxelLayout::Morton)
+        return;
+
+    // Assign the index bits to the axes in turns (x, y, z, x, y, z, ...) skipping axes without bits left.
+    std::array<int, 3> bitsLeft { numBits(dim.x), numBits(dim.y), numBits(dim.z) };
+    int outBit = 0;
+    while (std::any_of(std::begin(bitsLeft), std::end(bitsLeft), [](int bits) { return bits > 0; })) {
+        for (size_t axis = 0; axis < 3; axis++) {
+            if (bitsLeft[axis] > 0) {
+                m_masks[axis] |= uint64_t(1) << outBit++;
+                bitsLeft[axis]--;
+            }
+        }
+    }
+    m_size = size_t(1) << outBit;
+
+    for (size_t axis = 0; axis < 3; axis++) {
+        m_tables[axis].resize(size_t(dim[int(axis)]));
+        for (size_t i = 0; i < m_tables[axis].size(); i++)
+            m_tables[axis][i] = depositBits(i, m_masks[axis]);
+    }
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <vector>
+// MSVC does not define __BMI2__; every CPU that supports AVX2 also supports BMI2.
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define VOLVIS_HAS_BMI2 1
+#include <immintrin.h>
+#endif
+
+namespace volume {
+
+// Order in which the voxels of a volume are stored in memory.
+//  Linear: x + dim.x * (y + dim.y * z), neighbours along y and z are far apart in memory.
+//  Morton: Z-order curve, the bits of x, y and z are interleaved so that small 3D neighbourhoods (such as the
+//          2x2x2 voxels of a trilinear sample) are mostly close together in memory. Every axis is padded to
+//          the next power of two, which costs memory for dimensions just above a power of two.
+enum class VoxelLayout {
+    Linear = 0,
+    Morton
+};
+
+// Maps voxel coordinates to the index in the voxel array of a given layout. For Morton order every axis gets
+// a bit mask of the index bits that it occupies: the axes take turns for the low bits and once the smaller
+// axes run out of bits the remaining (high) bits belong to the larger axes. The coordinate bits are scattered
+// into those masks with BMI2 pdep when available and through per-axis lookup tables otherwise.
+class VoxelIndexer {
+public:
+    VoxelIndexer(const glm::ivec3& dim, VoxelLayout layout);
+
+    VoxelLayout layout() const { return m_layout; }
+    // Number of elements to allocate (includes the padding of the Morton layout).
+    size_t size() const { return m_size; }
+
+    size_t operator()(int x, int y, int z) const
+    {
+        if (m_layout == VoxelLayout::Linear)
+            return size_t(x + m_dim.x * (y + m_dim.y * z));
+#ifdef VOLVIS_HAS_BMI2
+        using u64 = unsigned long long; // Type used by the intrinsic.
+        return size_t(_pdep_u64(u64(x), m_masks[0]) | _pdep_u64(u64(y), m_masks[1]) | _pdep_u64(u64(z), m_masks[2]));
+#else
+        return m_tables[0][size_t(x)] | m_tables[1][size_t(y)] | m_tables[2][size_t(z)];
+#endif
+    }
+
+    // Index of the neighbour of the voxel at the given index, one step (direction +1 or -1) along the axis. For
+    // Morton order the coordinate bits of the axis are incremented (decremented) in place: the carry (borrow)
+    // ripples through the bits of the other axes once those are set (they are zero in the masked index).
+    size_t step(size_t index, int axis, int direction) const
+    {
+        if (m_layout == VoxelLayout::Linear)
+            return direction > 0 ? index + m_strides[size_t(axis)] : index - m_strides[size_t(axis)];
+        const uint64_t mask = m_masks[size_t(axis)];
+        const uint64_t bits = index & mask;
+        const uint64_t stepped = (direction > 0 ? (bits | ~mask) + 1 : bits - 1) & mask;
+        return (index & ~mask) | stepped;
+    }
+
+private:
+    glm::ivec3 m_dim;
+    VoxelLayout m_layout;
+    size_t m_size;
+    std::array<size_t, 3> m_strides; // Linear layout.
+    std::array<uint64_t, 3> m_masks;
+    std::array<std::vector<size_t>, 3> m_tables;
+};
+
+}